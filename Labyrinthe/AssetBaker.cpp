@@ -0,0 +1,173 @@
+#include "AssetBaker.h"
+#include "ObjWGroupsLoader.h"
+#include "MazeVisibility.h"
+#include "MeshChunker.h"
+#include "DdsTexture.h"
+#include "MazePhysics.h"
+#include "ConvexDecomposition.h"
+#include <SOIL2/SOIL2.h>
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <glm/gtc/matrix_transform.hpp>
+
+int bakeMazeVisibility(const std::string& colliderPath, const std::string& outputPath, float cellSize) {
+    ObjWGroupsLoader objLoaderWGroups = ObjWGroupsLoader();
+    objLoaderWGroups.loadObj(colliderPath);
+    if (objLoaderWGroups.Meshes.empty()) {
+        std::cerr << "Error: Failed to load OBJ file " << colliderPath << std::endl;
+        return -1;
+    }
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    MazeVisibility visibility;
+    visibility.Bake(objLoaderWGroups.Meshes, cellSize);
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    if (!visibility.IsLoaded() || !visibility.Save(outputPath)) {
+        return -1;
+    }
+
+    // average number of cells seen from a cell, to judge the cell size
+    long long visibleCells = 0;
+    for (int cell = 0; cell < visibility.GetCellCount(); ++cell) {
+        visibleCells += visibility.GetVisibleCellCount(cell);
+    }
+    std::cout << "Baked " << visibility.GetCellCount() << " cells (" << cellSize << " units) in " << seconds << " s, "
+        << (double)visibleCells / visibility.GetCellCount() << " cells visible on average -> " << outputPath << std::endl;
+    return 0;
+}
+
+int bakeCompressedTextures(const std::vector<std::string>& sourcePaths) {
+    int failures = 0;
+    for (const std::string& sourcePath : sourcePaths) {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+        // always RGBA, compress() picks BC1 when the alpha channel is unused
+        int width, height, channels;
+        unsigned char* pixels = SOIL_load_image(sourcePath.c_str(), &width, &height, &channels, SOIL_LOAD_RGBA);
+        if (!pixels) {
+            std::cerr << "Error: Failed to load texture " << sourcePath << std::endl;
+            failures++;
+            continue;
+        }
+
+        DdsImage image;
+        bool compressed = DdsTexture::compress(pixels, width, height, 4, image);
+        SOIL_free_image_data(pixels);
+
+        std::string outputPath = DdsTexture::getCompressedPath(sourcePath);
+        if (!compressed || !DdsTexture::save(outputPath, image)) {
+            std::cerr << "Error: Failed to compress " << sourcePath << std::endl;
+            failures++;
+            continue;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "Baked " << sourcePath << " (" << width << "x" << height << ", "
+            << (image.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? "BC3" : "BC1") << ", " << image.levels.size() << " levels, "
+            << image.data.size() / 1024 << " KB) in " << seconds << " s -> " << outputPath << std::endl;
+    }
+    return failures == 0 ? 0 : -1;
+}
+
+int bakeMazePhysics(const std::string& colliderPath, const std::string& outputPath) {
+    ObjWGroupsLoader objLoaderWGroups = ObjWGroupsLoader();
+    objLoaderWGroups.loadObj(colliderPath);
+    if (objLoaderWGroups.Meshes.empty()) {
+        std::cerr << "Error: Failed to load OBJ file " << colliderPath << std::endl;
+        return -1;
+    }
+
+    // in world space, where the app draws the maze
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    MazePhysics maze;
+    if (!maze.Build(objLoaderWGroups.Meshes, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.0f, -10.0f)))) {
+        return -1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    if (!maze.Save(outputPath, colliderPath)) {
+        return -1;
+    }
+    std::cout << "Baked " << maze.GetWallCount() << " walls, " << maze.GetMazeObject()->getCollisionShape()->getName()
+        << " built in " << seconds << " s -> " << outputPath << std::endl;
+    return 0;
+}
+
+int bakeConvexHulls(const std::vector<std::string>& objPaths, const ConvexDecompositionConfig& config) {
+    // ObjLoader isn't thread safe, the meshes load here and only the decompositions run in parallel
+    std::vector<ConvexDecomposition> decompositions(objPaths.size());
+    std::vector<ConvexDecomposition*> pending;
+    for (size_t i = 0; i < objPaths.size(); ++i) {
+        if (decompositions[i].LoadMesh(objPaths[i])) {
+            pending.push_back(&decompositions[i]);
+        }
+    }
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    ConvexDecomposition::BakeAll(pending, config);
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    int failures = (int)(objPaths.size() - pending.size());
+    for (size_t i = 0; i < objPaths.size(); ++i) {
+        std::string outputPath = ConvexDecomposition::GetCachePath(objPaths[i]);
+        if (decompositions[i].GetHullCount() == 0 || !decompositions[i].Save(outputPath)) {
+            std::cerr << "Error: Failed to decompose " << objPaths[i] << std::endl;
+            failures++;
+            continue;
+        }
+        std::cout << "Baked " << objPaths[i] << " (" << decompositions[i].GetHullCount() << " hulls, "
+            << decompositions[i].GetVertexCount() << " vertices) -> " << outputPath << std::endl;
+    }
+    std::cout << objPaths.size() << " meshes decomposed in " << seconds << " s" << std::endl;
+    return failures == 0 ? 0 : -1;
+}
+
+int runAssetBaker(int argc, char* argv[]) {
+    std::string name = argc > 2 ? argv[2] : "";
+
+    if (name == "pvs") {
+        float cellSize = argc > 3 ? (float)std::atof(argv[3]) : MESH_CHUNK_SIZE;
+        std::string colliderPath = argc > 4 ? argv[4] : "models/mazeY_collider_NoTextures.obj";
+        std::string outputPath = argc > 5 ? argv[5] : "models/mazeY.pvs";
+        return bakeMazeVisibility(colliderPath, outputPath, cellSize > 0.0f ? cellSize : MESH_CHUNK_SIZE);
+    }
+
+    if (name == "physics") {
+        std::string colliderPath = argc > 3 ? argv[3] : "models/mazeY_collider_NoTextures.obj";
+        std::string outputPath = argc > 4 ? argv[4] : "models/mazeY.bullet";
+        return bakeMazePhysics(colliderPath, outputPath);
+    }
+    if (name == "hulls") {
+        std::vector<std::string> objPaths;
+        for (int i = 3; i < argc && std::string(argv[i]).compare(0, 2, "--") != 0; ++i) {
+            objPaths.push_back(argv[i]);
+        }
+        if (objPaths.empty()) {
+            objPaths = { "models/chibi.obj" };
+        }
+        return bakeConvexHulls(objPaths, ConvexDecompositionConfig::FromArgs(argc, argv));
+    }
+    if (name == "textures") {
+        std::vector<std::string> sourcePaths;
+        for (int i = 3; i < argc; ++i) {
+            sourcePaths.push_back(argv[i]);
+        }
+        if (sourcePaths.empty()) {
+            sourcePaths = { "textures/agent.jpg", "textures/ground.jpg", "textures/chibi.png" };
+        }
+        return bakeCompressedTextures(sourcePaths);
+    }
+
+    std::cerr << "Usage: " << argv[0] << " --bake <asset> [options]" << std::endl;
+    std::cerr << "Available bake steps:" << std::endl;
+    std::cerr << "  pvs [cellSize] [colliders.obj] [output.pvs]  maze cell visibility" << std::endl;
+    std::cerr << "  textures [images...]                         BC1/BC3 DDS files with mipmaps, next to the images" << std::endl;
+    std::cerr << "  physics [colliders.obj] [output.bullet]      maze collision mesh, BVH and objects for the importer" << std::endl;
+    std::cerr << "  hulls [models.obj...] [--hulls-max n] [--hulls-vertices n] [--hulls-resolution voxels]" << std::endl;
+    std::cerr << "        [--hulls-concavity x] [--hulls-depth n] [--hulls-threads n]" << std::endl;
+    std::cerr << "                                               VHACD convex hulls, a .hulls file next to each model" << std::endl;
+    return -1;
+}
@@ -0,0 +1,29 @@
+/*
+    Offline asset baking. Precomputes data that is too slow to build at
+    startup and writes it next to the source assets.
+    Run with: Labyrinthe --bake <asset> [options]
+*/
+
+#ifndef ASSETBAKER_H_INCLUDED
+#define ASSETBAKER_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+// runs the bake step named by argv[2], returns the process exit code
+int runAssetBaker(int argc, char* argv[]);
+
+// potentially visible set of the maze cells, from the collider walls
+int bakeMazeVisibility(const std::string& colliderPath, const std::string& outputPath, float cellSize);
+
+// BC1/BC3 compressed DDS copy of every image, with its mip chain
+int bakeCompressedTextures(const std::vector<std::string>& sourcePaths);
+
+// the built maze physics (mesh, BVH, objects and walls) as a .bullet file
+int bakeMazePhysics(const std::string& colliderPath, const std::string& outputPath);
+
+// convex decomposition of each model (.hulls file), several models at once
+struct ConvexDecompositionConfig;
+int bakeConvexHulls(const std::vector<std::string>& objPaths, const ConvexDecompositionConfig& config);
+
+#endif // ASSETBAKER_H_INCLUDED
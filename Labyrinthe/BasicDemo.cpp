@@ -1,46 +1,123 @@
 #include "BasicDemo.h"
+#include "ObjLoader.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <algorithm>
 
+// walk speed of the agent, in units per second
+#define AGENT_SPEED 9.0f
+
+BasicDemo::BasicDemo() :
+	m_pAgent(nullptr),
+	m_pAgentObject(nullptr)
+{
+}
+
+BasicDemo::~BasicDemo() {
+	// the controller is an action of the world, it goes before the world
+	// and its game object do
+	StopPhysicsThread();
+	DestroyAgent();
+}
 
 void BasicDemo::InitializePhysics() {
-	// create the collision configuration
-	m_pCollisionConfiguration = new btDefaultCollisionConfiguration();
-	// create the dispatcher
-	m_pDispatcher = new btCollisionDispatcher(m_pCollisionConfiguration);
-	// create the broadphase
-	m_pBroadphase = new btDbvtBroadphase();
-	// create the constraint solver
-	m_pSolver = new btSequentialImpulseConstraintSolver();
-	// create the world
-	m_pWorld = new btDiscreteDynamicsWorld(m_pDispatcher, m_pBroadphase, m_pSolver, m_pCollisionConfiguration);
+	// create the collision configuration, dispatcher, broadphase, solver
+	// and world. Single threaded unless the physics config asks otherwise,
+	// the config also picks the broadphase (dbvt, sweep and prune or grid)
+	CreatePhysicsWorld();
 
 	// create our scene's physics objects
 	CreateObjects();
 }
 
 void BasicDemo::ShutdownPhysics() {
-	delete m_pWorld;
-	delete m_pSolver;
-	delete m_pBroadphase;
-	delete m_pDispatcher;
-	delete m_pCollisionConfiguration;
+	StopPhysicsThread();
+	DestroyAgent();
+	DestroyPhysicsWorld();
+}
+
+void BasicDemo::UpdateScene(float dt) {
+	if (m_pAgent) {
+		btVector3 walk(0.0f, 0.0f, 0.0f);
+		if (left) walk.setX(walk.x() - AGENT_SPEED);
+		if (right) walk.setX(walk.x() + AGENT_SPEED);
+		if (forward) walk.setZ(walk.z() - AGENT_SPEED);
+		if (backward) walk.setZ(walk.z() + AGENT_SPEED);
+		// only on a key change, the physics thread may be reading it
+		if (walk != m_pAgent->GetWalkVelocity()) {
+			m_pAgent->SetWalkVelocity(walk);
+		}
+	}
+	BulletOpenGLApplication::UpdateScene(dt);
 }
 
 void BasicDemo::CreateObjects() {
+	// the maze and the agent share agent.jpg through the texture array, ground.jpg keeps its own
+	LoadTextureArray({ "textures/agent.jpg" });
+
 	// create a maze 
 	glm::mat4 mazePos = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.0f, -10.0f));
-	CreateGameObject("models/mazeY.obj", "textures/maze.jpg", mazePos, new btBoxShape(btVector3(1, 50, 50)), 0, btVector3(0.2f, 0.6f, 0.6f), btVector3(0.0f, -4.0f, -10.0f));
+	CreateGameObject("models/mazeY.obj", "textures/agent.jpg", mazePos, GetShapes().AcquireBox(btVector3(1, 50, 50)), 0, btVector3(0.2f, 0.6f, 0.6f), btVector3(0.0f, -4.0f, -10.0f));
+	// walls hide most of the maze when the camera is inside of it
+	LoadMazeVisibility("models/mazeY.pvs", mazePos);
 	
 	
-	// create a ground plane
+	// create a ground plane, its 4096x4096 texture is streamed
+	StreamTexture("textures/ground.jpg");
 	glm::mat4 groundPos = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.0f, -10.0f));
-	CreateGameObject("models/groundY.obj", "textures/ground.jpg", groundPos, new btBoxShape(btVector3(1, 50, 50)), 0, btVector3(0.2f, 0.6f, 0.6f), btVector3(0.0f, -4.0f, -10.0f));
+	CreateGameObject("models/groundY.obj", "textures/ground.jpg", groundPos, GetShapes().AcquireBox(btVector3(1, 50, 50)), 0, btVector3(0.2f, 0.6f, 0.6f), btVector3(0.0f, -4.0f, -10.0f));
 
-	// create our original red box
-	glm::mat4 agentPos = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, -10.0f));
-	CreateGameObject("models/agentY.obj", "textures/agent.jpg", agentPos, new btBoxShape(btVector3(1, 1, 1)), 1.0, btVector3(1.0f, 0.2f, 0.2f), btVector3(0.0f, -1.0f, -10.0f));
+	// the agent, the maze stops it and slides it along the walls
+	CreateAgent(glm::vec3(2.0f, -4.0f, -10.0f));
+
+	// a chibi falls in the maze and tumbles on its convex hulls (--bake hulls),
+	// scaled from its 13 units down to about the height of the walls
+	const btScalar chibiScale = 0.1f;
+	btCollisionShape* pChibiShape = AcquireHullShape("models/chibi.obj", chibiScale);
+	if (pChibiShape) {
+		btVector3 chibiStart(-4.0f, 2.0f, -14.0f);
+		glm::mat4 chibiPos = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(chibiStart.x(), chibiStart.y(), chibiStart.z())), glm::vec3(chibiScale));
+		CreateGameObject("models/chibi.obj", "textures/chibi.png", chibiPos, pChibiShape, 1.0f, btVector3(0.8f, 0.6f, 0.2f), chibiStart, btQuaternion::getIdentity());
+	}
+}
+
+void BasicDemo::CreateAgent(const glm::vec3& modelPosition) {
+	// a cylinder around the agent model, the controller moves its center
+	AABB bounds = MeshChunker::computeBounds(ObjLoader::loadModel("models/agentY.obj", true).second);
+	glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+	glm::vec3 extents = (bounds.max - bounds.min) * 0.5f;
+	btScalar radius = std::max(extents.x, extents.z);
+	btCylinderShape* pShape = GetShapes().AcquireCylinder(btVector3(radius, extents.y, radius));
+	glm::vec3 start = modelPosition + center;
+
+	// the body is drawn, never simulated: kinematic, and in the characters'
+	// group with an empty mask so neither the world nor the controller's
+	// sweeps ever collide with it
+	glm::mat4 agentPos = glm::translate(glm::mat4(1.0f), modelPosition);
+	m_pAgentObject = CreateGameObject("models/agentY.obj", "textures/agent.jpg", agentPos, pShape, 0.0f, btVector3(1.0f, 0.2f, 0.2f),
+		btVector3(start.x, start.y, start.z), btQuaternion::getIdentity());
+	btRigidBody* pBody = m_pAgentObject->GetRigidBody();
+	m_pWorld->removeRigidBody(pBody);
+	pBody->setCollisionFlags(pBody->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT | btCollisionObject::CF_NO_CONTACT_RESPONSE);
+	m_pWorld->addRigidBody(pBody, btBroadphaseProxy::CharacterFilter, 0);
+
+	// the shape belongs to the game object, which outlives the controller
+	m_pAgent = new CharacterController(pShape, 0.15f, btVector3(start.x, start.y, start.z));
+	m_pAgent->SetMotionState(m_pAgentObject->GetMotionState());
+	m_pAgent->AddToWorld(m_pWorld);
+	m_pWorld->addAction(m_pAgent);
+}
 
+void BasicDemo::DestroyAgent() {
+	if (!m_pAgent) return;
+	if (m_pWorld) {
+		m_pWorld->removeAction(m_pAgent);
+		m_pAgent->RemoveFromWorld(m_pWorld);
+	}
+	delete m_pAgent;
+	m_pAgent = nullptr;
+	// the game object goes with the others
+	m_pAgentObject = nullptr;
 }
\ No newline at end of file
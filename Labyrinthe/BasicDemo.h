@@ -1,17 +1,31 @@
-
 #ifndef BULLETOPENGL_BASICDEMO_H
 #define BULLETOPENGL_BASICDEMO_H
 
 #include "BulletOpenGLApplication.h"
+#include "CharacterController.h"
 #include <Bullet/btBulletDynamicsCommon.h>
 
 class BasicDemo : public BulletOpenGLApplication {
 public:
+	BasicDemo();
+	~BasicDemo();
+
 	virtual void InitializePhysics() override;
 	virtual void ShutdownPhysics() override;
+	// the keys steer the agent, then the world steps
+	virtual void UpdateScene(float dt) override;
 
 	void CreateObjects();
+
+protected:
+	// the agent walks the maze as a kinematic character, like in main.cpp.
+	// Its game object is a kinematic body that only follows the controller
+	void CreateAgent(const glm::vec3& modelPosition);
+	void DestroyAgent();
+
+	CharacterController* m_pAgent;
+	GameObject* m_pAgentObject;
 };
 
 
-#endif //BULLETOPENGL_BASICDEMO_H
\ No newline at end of file
+#endif //BULLETOPENGL_BASICDEMO_H
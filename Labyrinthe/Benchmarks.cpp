@@ -0,0 +1,1237 @@
+#include "Benchmarks.h"
+#include "ObjLoader.h"
+#include "MeshChunker.h"
+#include "RenderBvh.h"
+#include "Frustum.h"
+#include "MazeVisibility.h"
+#include "ObjWGroupsLoader.h"
+#include "DdsTexture.h"
+#include "HdrTexture.h"
+#include "PhysicsBackend.h"
+#include "MazePhysics.h"
+#include "CharacterController.h"
+#include "GameObject.h"
+#include "ObjectPools.h"
+#include "WorldSnapshot.h"
+#include "ConvexDecomposition.h"
+#include "MazeQueries.h"
+#include <SOIL2/SOIL2.h>
+#include <SOIL2/image_helper.h>
+#include <SOIL2/stb_image.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// the maze and ground are drawn with this model matrix everywhere in the app
+static const glm::vec3 MAZE_OFFSET(0.0f, -4.0f, -10.0f);
+
+typedef std::chrono::high_resolution_clock BenchClock;
+
+static double elapsedMicroseconds(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::micro>(BenchClock::now() - start).count();
+}
+
+/*
+    A scripted camera path: a list of eye/target key frames that are
+    linearly interpolated over the length of the run
+*/
+struct CameraKey {
+    glm::vec3 eye;
+    glm::vec3 target;
+};
+
+struct CameraPath {
+    std::string name;
+    std::vector<CameraKey> keys;
+
+    CameraKey keyAt(float t) const {
+        float position = t * (keys.size() - 1);
+        size_t key = std::min((size_t)position, keys.size() - 2);
+        float blend = position - key;
+        CameraKey result = { glm::mix(keys[key].eye, keys[key + 1].eye, blend), glm::mix(keys[key].target, keys[key + 1].target, blend) };
+        return result;
+    }
+
+    glm::vec3 eyeAt(float t) const { return keyAt(t).eye; }
+
+    glm::mat4 viewAt(float t) const {
+        CameraKey key = keyAt(t);
+        glm::vec3 eye = key.eye;
+        glm::vec3 target = key.target;
+        // the app looks down on the maze, so 'up' is -z like in Camera::GetViewMatrix
+        glm::vec3 up = std::fabs(eye.y - target.y) > std::fabs(eye.z - target.z) ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        return glm::lookAt(eye, target, up);
+    }
+};
+
+static std::vector<CameraPath> scriptedCameraPaths() {
+    std::vector<CameraPath> paths;
+
+    // the default in-game view: camera above the maze following the agent
+    CameraPath follow;
+    follow.name = "follow";
+    const glm::vec3 agentPath[] = {
+        glm::vec3(2.0f, -4.0f, -10.0f), glm::vec3(30.0f, -4.0f, -10.0f),
+        glm::vec3(30.0f, -4.0f, -50.0f), glm::vec3(-35.0f, -4.0f, -50.0f),
+        glm::vec3(-35.0f, -4.0f, 30.0f), glm::vec3(2.0f, -4.0f, -10.0f)
+    };
+    for (const glm::vec3& agent : agentPath) {
+        CameraKey key = { agent + glm::vec3(0.0f, 24.0f, 0.0f), agent };
+        follow.keys.push_back(key);
+    }
+    paths.push_back(follow);
+
+    // a high view of the whole maze, zooming in towards the center
+    CameraPath overview;
+    overview.name = "overview";
+    CameraKey high = { glm::vec3(0.0f, 120.0f, -10.0f), MAZE_OFFSET };
+    CameraKey low = { glm::vec3(0.0f, 15.0f, -10.0f), MAZE_OFFSET };
+    overview.keys.push_back(high);
+    overview.keys.push_back(low);
+    paths.push_back(overview);
+
+    // walking through the corridors at eye level
+    CameraPath ground;
+    ground.name = "ground";
+    CameraKey start = { glm::vec3(-45.0f, -3.0f, -55.0f), glm::vec3(0.0f, -3.0f, -10.0f) };
+    CameraKey middle = { glm::vec3(0.0f, -3.0f, -10.0f), glm::vec3(45.0f, -3.0f, 35.0f) };
+    CameraKey end = { glm::vec3(40.0f, -3.0f, 30.0f), glm::vec3(-40.0f, -3.0f, 30.0f) };
+    ground.keys.push_back(start);
+    ground.keys.push_back(middle);
+    ground.keys.push_back(end);
+    paths.push_back(ground);
+
+    return paths;
+}
+
+int runCullingBenchmark(int frames) {
+    // load and chunk the maze like GameObject::LoadMesh does
+    std::pair<std::vector<uint32_t>, std::vector<float>> mazeModel = ObjLoader::loadModel("models/mazeY.obj", true);
+    std::pair<std::vector<uint32_t>, std::vector<float>> agentModel = ObjLoader::loadModel("models/agentY.obj", true);
+    if (mazeModel.second.empty() || agentModel.second.empty()) {
+        std::cerr << "Error: failed to load models/mazeY.obj or models/agentY.obj" << std::endl;
+        return -1;
+    }
+
+    BenchClock::time_point start = BenchClock::now();
+    std::vector<MeshChunk> chunks = MeshChunker::splitIntoChunks(mazeModel.second, MESH_CHUNK_SIZE);
+    double chunkTime = elapsedMicroseconds(start);
+
+    // the items are the maze chunks, followed by a grid of agents
+    // standing in for dynamic game objects
+    glm::mat4 mazePos = glm::translate(glm::mat4(1.0f), MAZE_OFFSET);
+    std::vector<AABB> itemBounds;
+    for (const MeshChunk& chunk : chunks) {
+        itemBounds.push_back(chunk.bounds.Transformed(mazePos));
+    }
+    AABB agentBounds = MeshChunker::computeBounds(agentModel.second);
+    for (int x = 0; x < 8; ++x) {
+        for (int z = 0; z < 8; ++z) {
+            glm::vec3 position = MAZE_OFFSET + glm::vec3(-42.0f + x * 12.0f, 0.0f, -42.0f + z * 12.0f);
+            itemBounds.push_back(agentBounds.Transformed(glm::translate(glm::mat4(1.0f), position)));
+        }
+    }
+
+    start = BenchClock::now();
+    RenderBvh bvh;
+    bvh.Build(itemBounds);
+    double buildTime = elapsedMicroseconds(start);
+
+    std::cout << "maze chunks: " << chunks.size() << ", agents: " << itemBounds.size() - chunks.size()
+        << ", bvh nodes: " << bvh.GetNodeCount() << std::endl;
+    std::cout << "chunking: " << chunkTime << " us, bvh build: " << buildTime << " us" << std::endl;
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1400.0f / 800.0f, 0.1f, 100.0f);
+    std::vector<int> visibleItems;
+    visibleItems.reserve(itemBounds.size());
+
+    std::cout << "path,frame,visible_chunks,visible_agents,total_items,cull_us" << std::endl;
+    for (const CameraPath& path : scriptedCameraPaths()) {
+        double totalTime = 0.0, maxTime = 0.0;
+        long long totalVisibleChunks = 0;
+
+        for (int frame = 0; frame < frames; ++frame) {
+            glm::mat4 view = path.viewAt(frames > 1 ? (float)frame / (frames - 1) : 0.0f);
+
+            start = BenchClock::now();
+            Frustum frustum;
+            frustum.Extract(projection * view);
+            visibleItems.clear();
+            bvh.Query(frustum, visibleItems);
+            double cullTime = elapsedMicroseconds(start);
+
+            int visibleChunks = 0;
+            for (int item : visibleItems) {
+                if (item < (int)chunks.size()) visibleChunks++;
+            }
+
+            totalTime += cullTime;
+            maxTime = std::max(maxTime, cullTime);
+            totalVisibleChunks += visibleChunks;
+
+            std::cout << path.name << "," << frame << "," << visibleChunks << ","
+                << visibleItems.size() - visibleChunks << "," << itemBounds.size() << "," << cullTime << std::endl;
+        }
+
+        std::cout << "# " << path.name << ": average " << (double)totalVisibleChunks / frames << "/" << chunks.size()
+            << " chunks visible, cull average " << totalTime / frames << " us, max " << maxTime << " us" << std::endl;
+    }
+
+    return 0;
+}
+
+int runVisibilityBenchmark(int frames) {
+    std::pair<std::vector<uint32_t>, std::vector<float>> mazeModel = ObjLoader::loadModel("models/mazeY.obj", true);
+    if (mazeModel.second.empty()) {
+        std::cerr << "Error: failed to load models/mazeY.obj" << std::endl;
+        return -1;
+    }
+    std::vector<MeshChunk> chunks = MeshChunker::splitIntoChunks(mazeModel.second, MESH_CHUNK_SIZE);
+
+    glm::mat4 mazePos = glm::translate(glm::mat4(1.0f), MAZE_OFFSET);
+    std::vector<AABB> chunkBounds;
+    long long totalTriangles = 0;
+    for (const MeshChunk& chunk : chunks) {
+        chunkBounds.push_back(chunk.bounds.Transformed(mazePos));
+        totalTriangles += chunk.count / 3;
+    }
+    RenderBvh bvh;
+    bvh.Build(chunkBounds);
+
+    // use the baked set, or bake it now if it is missing
+    MazeVisibility visibility;
+    if (!visibility.Load("models/mazeY.pvs")) {
+        ObjWGroupsLoader objLoaderWGroups = ObjWGroupsLoader();
+        objLoaderWGroups.loadObj("models/mazeY_collider_NoTextures.obj");
+        BenchClock::time_point start = BenchClock::now();
+        visibility.Bake(objLoaderWGroups.Meshes, MESH_CHUNK_SIZE);
+        std::cout << "baked the visibility in " << elapsedMicroseconds(start) / 1000.0 << " ms" << std::endl;
+        if (!visibility.IsLoaded()) {
+            return -1;
+        }
+    }
+    visibility.SetTransform(mazePos);
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1400.0f / 800.0f, 0.1f, 100.0f);
+    std::vector<int> visibleItems;
+
+    std::cout << "maze chunks: " << chunks.size() << ", pvs cells: " << visibility.GetCellCount() << ", triangles: " << totalTriangles << std::endl;
+    std::cout << "path,frame,camera_cell,full_triangles,frustum_triangles,pvs_triangles,pvs_us" << std::endl;
+    for (const CameraPath& path : scriptedCameraPaths()) {
+        long long frustumTotal = 0, pvsTotal = 0;
+        double lookupTotal = 0.0;
+
+        for (int frame = 0; frame < frames; ++frame) {
+            float t = frames > 1 ? (float)frame / (frames - 1) : 0.0f;
+            Frustum frustum;
+            frustum.Extract(projection * path.viewAt(t));
+            visibleItems.clear();
+            bvh.Query(frustum, visibleItems);
+
+            long long frustumTriangles = 0;
+            for (int item : visibleItems) {
+                frustumTriangles += chunks[item].count / 3;
+            }
+
+            // the PVS pass: camera cell lookup, then a bit test per surviving chunk
+            BenchClock::time_point start = BenchClock::now();
+            int cameraCell = visibility.GetCell(path.eyeAt(t));
+            size_t kept = 0;
+            for (size_t i = 0; i < visibleItems.size(); ++i) {
+                if (visibility.IsVisible(cameraCell, chunkBounds[visibleItems[i]])) {
+                    visibleItems[kept++] = visibleItems[i];
+                }
+            }
+            visibleItems.resize(kept);
+            double lookupTime = elapsedMicroseconds(start);
+
+            long long pvsTriangles = 0;
+            for (int item : visibleItems) {
+                pvsTriangles += chunks[item].count / 3;
+            }
+
+            frustumTotal += frustumTriangles;
+            pvsTotal += pvsTriangles;
+            lookupTotal += lookupTime;
+
+            std::cout << path.name << "," << frame << "," << cameraCell << "," << totalTriangles << ","
+                << frustumTriangles << "," << pvsTriangles << "," << lookupTime << std::endl;
+        }
+
+        std::cout << "# " << path.name << ": average triangles full " << totalTriangles << ", frustum " << frustumTotal / frames
+            << ", frustum+pvs " << pvsTotal / frames << ", pvs pass average " << lookupTotal / frames << " us" << std::endl;
+    }
+
+    return 0;
+}
+
+static long long fileSize(const std::string& path) {
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    return file ? (long long)file.tellg() : -1;
+}
+
+/*
+    Loading cost of the source images (decode to RGBA, then a mip chain built
+    on the CPU as a stand in for glGenerateMipmap) against the baked DDS files
+    (read only). Run --bake textures first
+*/
+int runTextureBenchmark(int iterations) {
+    const char* texturePaths[] = { "textures/agent.jpg", "textures/ground.jpg", "textures/chibi.png" };
+
+    std::cout << "texture,size,source_kb,dds_kb,rgba_vram_kb,dds_vram_kb,decode_ms,mips_ms,dds_load_ms" << std::endl;
+    double sourceTotal = 0.0, ddsTotal = 0.0;
+    long long rgbaVramTotal = 0, ddsVramTotal = 0;
+    for (const char* path : texturePaths) {
+        std::string ddsPath = DdsTexture::getCompressedPath(path);
+        double decodeTime = 0.0, mipTime = 0.0, ddsTime = 0.0;
+        int width = 0, height = 0;
+        long long rgbaVram = 0, ddsVram = 0;
+
+        for (int i = 0; i < iterations; ++i) {
+            BenchClock::time_point start = BenchClock::now();
+            int channels;
+            unsigned char* pixels = SOIL_load_image(path, &width, &height, &channels, SOIL_LOAD_RGBA);
+            decodeTime += elapsedMicroseconds(start);
+            if (!pixels) {
+                std::cerr << "Failed to load texture: " << path << std::endl;
+                return -1;
+            }
+
+            start = BenchClock::now();
+            std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * 4), next;
+            int levelWidth = width, levelHeight = height;
+            rgbaVram = (long long)width * height * 4;
+            while (levelWidth > 1 || levelHeight > 1) {
+                int nextWidth = std::max(1, levelWidth / 2), nextHeight = std::max(1, levelHeight / 2);
+                next.resize((size_t)nextWidth * nextHeight * 4);
+                mipmap_image(&level[0], levelWidth, levelHeight, 4, &next[0], levelWidth > 1 ? 2 : 1, levelHeight > 1 ? 2 : 1);
+                level.swap(next);
+                levelWidth = nextWidth;
+                levelHeight = nextHeight;
+                rgbaVram += (long long)levelWidth * levelHeight * 4;
+            }
+            mipTime += elapsedMicroseconds(start);
+            SOIL_free_image_data(pixels);
+
+            start = BenchClock::now();
+            DdsImage image;
+            if (!DdsTexture::load(ddsPath, image)) {
+                std::cerr << "No baked texture " << ddsPath << ", run --bake textures first" << std::endl;
+                return -1;
+            }
+            ddsTime += elapsedMicroseconds(start);
+            ddsVram = (long long)image.data.size();
+        }
+
+        decodeTime /= iterations * 1000.0;
+        mipTime /= iterations * 1000.0;
+        ddsTime /= iterations * 1000.0;
+        std::cout << path << "," << width << "x" << height << "," << fileSize(path) / 1024 << "," << fileSize(ddsPath) / 1024 << ","
+            << rgbaVram / 1024 << "," << ddsVram / 1024 << "," << decodeTime << "," << mipTime << "," << ddsTime << std::endl;
+
+        sourceTotal += decodeTime + mipTime;
+        ddsTotal += ddsTime;
+        rgbaVramTotal += rgbaVram;
+        ddsVramTotal += ddsVram;
+    }
+
+    std::cout << "# load " << sourceTotal << " ms -> " << ddsTotal << " ms, vram " << rgbaVramTotal / 1024 << " KB -> "
+        << ddsVramTotal / 1024 << " KB" << std::endl;
+    return 0;
+}
+
+/*
+    Decode + convert throughput of the HDR paths for agent.hdr: the 8 bit
+    SOIL load the app used to do, stb floats converted to halves, and the
+    RGBE pixels converted straight to halves, each with the scalar and the
+    SIMD conversion. The halves of every path are checked against stb
+*/
+int runHdrBenchmark(int iterations) {
+    const std::string path = "textures/agent.hdr";
+
+    int width = 0, height = 0, channels;
+    float* pReference = stbi_loadf(path.c_str(), &width, &height, &channels, 3);
+    if (!pReference) {
+        std::cerr << "Failed to load HDR texture: " << path << std::endl;
+        return -1;
+    }
+    size_t pixelCount = (size_t)width * height;
+    std::vector<uint16_t> expected(pixelCount * 3), halves(pixelCount * 3);
+    HdrTexture::floatToHalfScalar(pReference, expected.size(), &expected[0]);
+    stbi_image_free(pReference);
+
+    std::cout << "# " << path << " " << width << "x" << height << ", SIMD: " << HdrTexture::getSimdName() << std::endl;
+    std::cout << "path,decode_ms,convert_ms,total_ms,mpixels_per_s,vram_kb,mismatches" << std::endl;
+    for (int method = 0; method < 5; ++method) {
+        double decodeTime = 0.0, convertTime = 0.0;
+        size_t mismatches = 0;
+        long long vram = (long long)pixelCount * 6;
+        for (int i = 0; i < iterations; ++i) {
+            BenchClock::time_point start = BenchClock::now();
+            if (method == 0) {
+                unsigned char* pixels = SOIL_load_image(path.c_str(), &width, &height, &channels, SOIL_LOAD_RGBA);
+                decodeTime += elapsedMicroseconds(start);
+                SOIL_free_image_data(pixels);
+                vram = (long long)pixelCount * 4;
+                continue;
+            }
+            if (method <= 2) {
+                float* pValues = stbi_loadf(path.c_str(), &width, &height, &channels, 3);
+                decodeTime += elapsedMicroseconds(start);
+                start = BenchClock::now();
+                if (method == 1) HdrTexture::floatToHalfScalar(pValues, halves.size(), &halves[0]);
+                else HdrTexture::floatToHalf(pValues, halves.size(), &halves[0]);
+                convertTime += elapsedMicroseconds(start);
+                stbi_image_free(pValues);
+            }
+            else {
+                std::vector<unsigned char> rgbe;
+                if (!HdrTexture::readRgbe(path, width, height, rgbe)) {
+                    std::cerr << "Unsupported RGBE layout in " << path << std::endl;
+                    return -1;
+                }
+                decodeTime += elapsedMicroseconds(start);
+                start = BenchClock::now();
+                if (method == 3) HdrTexture::rgbeToHalfScalar(&rgbe[0], pixelCount, &halves[0]);
+                else HdrTexture::rgbeToHalf(&rgbe[0], pixelCount, &halves[0]);
+                convertTime += elapsedMicroseconds(start);
+            }
+            mismatches = 0;
+            for (size_t p = 0; p < halves.size(); ++p) {
+                mismatches += halves[p] != expected[p];
+            }
+        }
+
+        static const char* names[] = { "soil_rgba8", "stb_float_scalar", "stb_float_simd", "rgbe_scalar", "rgbe_simd" };
+        decodeTime /= iterations * 1000.0;
+        convertTime /= iterations * 1000.0;
+        double total = decodeTime + convertTime;
+        std::cout << names[method] << "," << decodeTime << "," << convertTime << "," << total << ","
+            << pixelCount / (total * 1000.0) << "," << vram / 1024 << "," << (method == 0 ? std::string("8 bit") : std::to_string(mismatches)) << std::endl;
+    }
+    return 0;
+}
+
+/*
+    Step time of the maze with 'bodies' spheres falling into it, for the
+    single threaded world and the multithreaded one with 1, 2, 4... threads
+    up to what the scheduler offers. Every run starts from the same state
+*/
+int runPhysicsBenchmark(int bodies, int frames, const PhysicsConfig& baseConfig) {
+    ObjWGroupsLoader colliderLoader;
+    colliderLoader.loadObj("models/mazeY_collider_NoTextures.obj");
+    MazePhysics maze;
+    if (!maze.Build(colliderLoader.Meshes, glm::translate(glm::mat4(1.0f), MAZE_OFFSET))) {
+        return -1;
+    }
+
+    // thread counts to try, the first run is the plain btDiscreteDynamicsWorld
+    std::vector<int> threadCounts(1, 0);
+    btITaskScheduler* pScheduler = PhysicsBackend::GetScheduler(baseConfig.scheduler);
+    int maxThreads = pScheduler ? pScheduler->getMaxNumThreads() : 0;
+    if (baseConfig.threadCount > 0) maxThreads = std::min(maxThreads, baseConfig.threadCount);
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    if (maxThreads > 0 && threadCounts.back() != maxThreads) threadCounts.push_back(maxThreads);
+
+    std::cout << "# " << bodies << " bodies, " << maze.GetWallCount() << " walls, " << frames << " frames of 1/60 s, "
+        << PhysicsBackend::GetSchedulerName(baseConfig.scheduler) << " scheduler"
+        << (pScheduler ? "" : " not available (Bullet needs BT_THREADSAFE=1)") << std::endl;
+    std::cout << "world,threads,avg_step_ms,max_step_ms,speedup,active_bodies" << std::endl;
+    double baseline = 0.0;
+    for (size_t run = 0; run < threadCounts.size(); ++run) {
+        PhysicsConfig config = baseConfig;
+        config.multithreaded = threadCounts[run] > 0;
+        config.threadCount = threadCounts[run];
+        PhysicsBackend backend;
+        btDiscreteDynamicsWorld* pWorld = backend.Create(config);
+        maze.AddToWorld(pWorld);
+        maze.AddBodies(pWorld, bodies);
+
+        double total = 0.0, worst = 0.0;
+        for (int frame = 0; frame < frames; ++frame) {
+            BenchClock::time_point start = BenchClock::now();
+            pWorld->stepSimulation(1.0f / 60.0f, 1, 1.0f / 60.0f);
+            double step = elapsedMicroseconds(start) / 1000.0;
+            total += step;
+            worst = std::max(worst, step);
+        }
+        int active = 0;
+        for (btRigidBody* pBody : maze.GetBodies()) {
+            active += pBody->isActive() ? 1 : 0;
+        }
+
+        double average = total / frames;
+        if (run == 0) baseline = average;
+        std::cout << (backend.IsMultithreaded() ? "mt" : "single") << "," << backend.GetThreadCount() << "," << average << ","
+            << worst << "," << baseline / average << "," << active << std::endl;
+
+        maze.RemoveBodies(pWorld);
+        maze.RemoveFromWorld(pWorld);
+    }
+    return 0;
+}
+
+// whether a contact test found anything
+struct TouchingCallback : public btCollisionWorld::ContactResultCallback {
+    bool touching;
+
+    TouchingCallback() : touching(false) {}
+
+    virtual btScalar addSingleResult(btManifoldPoint& point, const btCollisionObjectWrapper* pObject0, int partId0, int index0,
+        const btCollisionObjectWrapper* pObject1, int partId1, int index1) {
+        touching = true;
+        return 0.0f;
+    }
+};
+
+/*
+    'agents' character controllers walking through the maze, each turning
+    to a new random direction when it runs into a wall. The tick time
+    covers the world step and every controller (they are world actions)
+*/
+int runCharacterBenchmark(int agents, int ticks, const PhysicsConfig& config) {
+    ObjWGroupsLoader colliderLoader;
+    colliderLoader.loadObj("models/mazeY_collider_NoTextures.obj");
+    MazePhysics maze;
+    if (!maze.Build(colliderLoader.Meshes, glm::translate(glm::mat4(1.0f), MAZE_OFFSET))) {
+        return -1;
+    }
+    PhysicsBackend backend;
+    btDiscreteDynamicsWorld* pWorld = backend.Create(config);
+    maze.AddToWorld(pWorld);
+
+    // about the size of agentY.obj, all the agents share the shape
+    btCylinderShape agentShape(btVector3(0.37f, 0.21f, 0.37f));
+    const float stepHeight = 0.15f, speed = 3.0f;
+
+    // random spots on the floor of the maze, away from the walls
+    const AABB& bounds = maze.GetBounds();
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> angle(0.0f, 2.0f * SIMD_PI);
+    std::uniform_real_distribution<float> spawnX(bounds.min.x, bounds.max.x), spawnZ(bounds.min.z, bounds.max.z);
+    btCollisionObject probe;
+    probe.setCollisionShape(&agentShape);
+    std::vector<CharacterController*> controllers;
+    for (int i = 0, tries = 0; i < agents && tries < agents * 20; ++tries) {
+        btVector3 position(spawnX(random), maze.GetFloorHeight() + 0.21f + 0.05f, spawnZ(random));
+        probe.setWorldTransform(btTransform(btQuaternion::getIdentity(), position));
+        TouchingCallback touching;
+        pWorld->contactTest(&probe, touching);
+        if (touching.touching) continue;
+        ++i;
+
+        CharacterController* pController = new CharacterController(&agentShape, stepHeight, position);
+        float a = angle(random);
+        pController->SetWalkVelocity(btVector3(std::cos(a), 0.0f, std::sin(a)) * speed);
+        pController->AddToWorld(pWorld);
+        pWorld->addAction(pController);
+        controllers.push_back(pController);
+    }
+
+    agents = (int)controllers.size();
+    std::cout << "# " << agents << " agents, " << maze.GetWallCount() << " walls, " << ticks << " ticks of 1/60 s, "
+        << PhysicsBackend::GetBroadphaseName(config.broadphase) << " broadphase" << std::endl;
+    std::cout << "tick_ms_avg,tick_ms_max,agent_ticks_per_s,sweeps_per_agent,slides_per_tick,recoveries_per_tick,on_ground,below_floor" << std::endl;
+    CharacterController::ResetStats();
+    double total = 0.0, worst = 0.0;
+    for (int tick = 0; tick < ticks; ++tick) {
+        BenchClock::time_point start = BenchClock::now();
+        pWorld->stepSimulation(1.0f / 60.0f, 0, 1.0f / 60.0f);
+        double step = elapsedMicroseconds(start) / 1000.0;
+        total += step;
+        worst = std::max(worst, step);
+
+        // turn away from the walls, outside of the timing
+        for (CharacterController* pController : controllers) {
+            if (pController->HitWall()) {
+                float a = angle(random);
+                pController->SetWalkVelocity(btVector3(std::cos(a), 0.0f, std::sin(a)) * speed);
+            }
+        }
+    }
+
+    // the agents that fell through the floor (or walked off the ground) show up here
+    int onGround = 0, belowFloor = 0;
+    for (CharacterController* pController : controllers) {
+        onGround += pController->IsOnGround() ? 1 : 0;
+        belowFloor += pController->GetPosition().y() < maze.GetFloorHeight() ? 1 : 0;
+    }
+    const CharacterStats& stats = CharacterController::GetStats();
+    double average = total / ticks;
+    std::cout << average << "," << worst << "," << agents / (average / 1000.0) << "," << (double)stats.sweeps / ticks / std::max(1, agents) << ","
+        << (double)stats.slides / ticks << "," << (double)stats.recoveries / ticks << "," << onGround << "," << belowFloor << std::endl;
+
+    for (CharacterController* pController : controllers) {
+        pWorld->removeAction(pController);
+        pController->RemoveFromWorld(pWorld);
+        delete pController;
+    }
+    maze.RemoveFromWorld(pWorld);
+    return 0;
+}
+
+/*
+    Broadphase cost with more and more agents in the maze: every tick each
+    agent moves a step (wrapping around the maze), then the AABB update and
+    pair search are timed, then one ray per agent along its way. The agents
+    are plain collision objects that overlap each other too, so the pair
+    count grows with the crowd, and nothing runs the narrowphase
+*/
+int runBroadphaseBenchmark(int maxAgents, int ticks) {
+    ObjWGroupsLoader colliderLoader;
+    colliderLoader.loadObj("models/mazeY_collider_NoTextures.obj");
+    MazePhysics maze;
+    if (!maze.Build(colliderLoader.Meshes, glm::translate(glm::mat4(1.0f), MAZE_OFFSET))) {
+        return -1;
+    }
+    const AABB& bounds = maze.GetBounds();
+    btCylinderShape agentShape(btVector3(0.37f, 0.21f, 0.37f));
+    const float speed = 3.0f, dt = 1.0f / 60.0f, rayLength = 4.0f;
+    float height = maze.GetFloorHeight() + 0.21f + 0.05f;
+
+    std::vector<int> counts;
+    for (int count = 250; count < maxAgents; count *= 2) {
+        counts.push_back(count);
+    }
+    counts.push_back(maxAgents);
+
+    std::cout << "# " << maze.GetWallCount() << " walls, " << ticks << " ticks of 1/60 s per run, grid cells of "
+        << PhysicsConfig().gridCellSize << std::endl;
+    std::cout << "broadphase,agents,pair_update_ms,pairs,ray_ms,ray_hits" << std::endl;
+    for (size_t run = 0; run < counts.size(); ++run) {
+        for (int broadphase = 0; broadphase < BROADPHASE_COUNT; ++broadphase) {
+            PhysicsConfig config;
+            config.broadphase = (PhysicsBroadphase)broadphase;
+            config.maxProxies = counts[run] + 16;
+            PhysicsBackend backend;
+            btDiscreteDynamicsWorld* pWorld = backend.Create(config);
+            maze.AddToWorld(pWorld);
+
+            // the same agents and directions for every broadphase
+            std::mt19937 random(1);
+            std::uniform_real_distribution<float> angle(0.0f, 2.0f * SIMD_PI);
+            std::uniform_real_distribution<float> spawnX(bounds.min.x, bounds.max.x), spawnZ(bounds.min.z, bounds.max.z);
+            std::vector<btCollisionObject*> agents(counts[run]);
+            std::vector<btVector3> directions(counts[run]);
+            for (size_t i = 0; i < agents.size(); ++i) {
+                agents[i] = new btCollisionObject();
+                agents[i]->setCollisionShape(&agentShape);
+                agents[i]->setWorldTransform(btTransform(btQuaternion::getIdentity(), btVector3(spawnX(random), height, spawnZ(random))));
+                float a = angle(random);
+                directions[i] = btVector3(std::cos(a), 0.0f, std::sin(a));
+                pWorld->addCollisionObject(agents[i], btBroadphaseProxy::CharacterFilter, btBroadphaseProxy::AllFilter);
+            }
+
+            double pairTime = 0.0, rayTime = 0.0;
+            long long rayHits = 0;
+            for (int tick = 0; tick < ticks; ++tick) {
+                for (size_t i = 0; i < agents.size(); ++i) {
+                    btVector3 position = agents[i]->getWorldTransform().getOrigin() + directions[i] * speed * dt;
+                    if (position.x() < bounds.min.x) position.setX(bounds.max.x);
+                    if (position.x() > bounds.max.x) position.setX(bounds.min.x);
+                    if (position.z() < bounds.min.z) position.setZ(bounds.max.z);
+                    if (position.z() > bounds.max.z) position.setZ(bounds.min.z);
+                    agents[i]->getWorldTransform().setOrigin(position);
+                }
+
+                BenchClock::time_point start = BenchClock::now();
+                pWorld->updateAabbs();
+                pWorld->computeOverlappingPairs();
+                pairTime += elapsedMicroseconds(start) / 1000.0;
+
+                start = BenchClock::now();
+                for (size_t i = 0; i < agents.size(); ++i) {
+                    btVector3 from = agents[i]->getWorldTransform().getOrigin(), to = from + directions[i] * rayLength;
+                    btCollisionWorld::ClosestRayResultCallback callback(from, to);
+                    callback.m_collisionFilterGroup = btBroadphaseProxy::CharacterFilter;
+                    callback.m_collisionFilterMask = btBroadphaseProxy::StaticFilter;
+                    pWorld->rayTest(from, to, callback);
+                    rayHits += callback.hasHit() ? 1 : 0;
+                }
+                rayTime += elapsedMicroseconds(start) / 1000.0;
+            }
+            std::cout << PhysicsBackend::GetBroadphaseName(config.broadphase) << "," << agents.size() << "," << pairTime / ticks << ","
+                << backend.GetBroadphase()->getOverlappingPairCache()->getNumOverlappingPairs() << "," << rayTime / ticks << ","
+                << (double)rayHits / ticks << std::endl;
+
+            for (size_t i = 0; i < agents.size(); ++i) {
+                pWorld->removeCollisionObject(agents[i]);
+                delete agents[i];
+            }
+            maze.RemoveFromWorld(pWorld);
+        }
+    }
+    return 0;
+}
+
+// every btAlignedAlloc goes through here while the pool benchmark runs:
+// Bullet's own allocations, the objects using its aligned allocator and the pool slabs
+static unsigned long long s_alignedAllocations = 0;
+
+static void* countingAlloc(size_t size) {
+    ++s_alignedAllocations;
+    return malloc(size);
+}
+
+static void countingFree(void* memory) {
+    free(memory);
+}
+
+// and every global operator new of the program (the containers, strings
+// and objects made with new), only counted while the pool benchmark runs
+static std::atomic<bool> s_countNews(false);
+static std::atomic<unsigned long long> s_newAllocations(0);
+
+void* operator new(size_t size) {
+    if (s_countNews.load(std::memory_order_relaxed)) {
+        s_newAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* memory = malloc(size > 0 ? size : 1);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+static unsigned long long countHeapCalls() {
+    return s_alignedAllocations + s_newAllocations.load(std::memory_order_relaxed);
+}
+
+/*
+    'agents' game objects spawned into the maze and despawned again,
+    'rounds' times. Each has the agent model, a texture path, a body, a
+    motion state and its own cylinder shape, first allocated with new (the
+    model parsed for every object), then from the pools, then from the
+    pools with one cylinder shared through the registry. The mesh is only
+    uploaded on the first draw, so no GL context is needed.
+    The heap calls counted are those of the spawn and despawn only, through
+    btAlignedAlloc and the global operator new: the pools make none once
+    the first round has grown them, what is left is the model parsed again
+    after the last object of a round released it, and the broadphase's
+    (none with the grid, whose proxies are pooled too)
+*/
+int runPoolBenchmark(int agents, int rounds, const PhysicsConfig& config) {
+    ObjWGroupsLoader colliderLoader;
+    colliderLoader.loadObj("models/mazeY_collider_NoTextures.obj");
+    MazePhysics maze;
+    if (!maze.Build(colliderLoader.Meshes, glm::translate(glm::mat4(1.0f), MAZE_OFFSET))) {
+        return -1;
+    }
+    const AABB& bounds = maze.GetBounds();
+    const btVector3 agentHalfExtents(0.37f, 0.21f, 0.37f);
+    const std::string agentModel = "models/agentY.obj";
+    const char* agentTexture = "textures/agent.jpg";
+
+    std::cout << "# " << agents << " agents, " << rounds << " rounds, " << PhysicsBackend::GetBroadphaseName(config.broadphase) << " broadphase" << std::endl;
+    std::cout << "mode,round,spawn_ms,despawn_ms,heap_calls_per_agent,pool_heap_calls,shapes" << std::endl;
+    static const char* modeNames[3] = { "heap", "pool", "shared" };
+    btAlignedAllocSetCustom(countingAlloc, countingFree);
+    s_countNews = true;
+    for (int mode = 0; mode < 3; ++mode) {
+        PhysicsBackend backend;
+        btDiscreteDynamicsWorld* pWorld = backend.Create(config);
+        maze.AddToWorld(pWorld);
+        ObjectPools pools;
+        std::vector<GameObject*> objects(agents);
+
+        for (int round = 0; round < rounds; ++round) {
+            // the same spots every round
+            std::mt19937 random(1);
+            std::uniform_real_distribution<float> spawnX(bounds.min.x, bounds.max.x), spawnZ(bounds.min.z, bounds.max.z);
+            unsigned long long allocations = countHeapCalls(), poolAllocations = pools.GetSlabAllocations();
+
+            BenchClock::time_point start = BenchClock::now();
+            for (int i = 0; i < agents; ++i) {
+                btVector3 position(spawnX(random), maze.GetFloorHeight() + 0.5f, spawnZ(random));
+                if (mode > 0) {
+                    btCollisionShape* pShape = mode == 2 ? pools.GetShapes().AcquireCylinder(agentHalfExtents) : pools.CreateCylinderShape(agentHalfExtents);
+                    objects[i] = pools.GetGameObjects().Create(agentModel, agentTexture, glm::mat4(1.0f), pShape, 1.0f,
+                        btVector3(1.0f, 0.2f, 0.2f), position, btQuaternion::getIdentity(), &pools);
+                }
+                else {
+                    objects[i] = new GameObject(agentModel, agentTexture, glm::mat4(1.0f), new btCylinderShape(agentHalfExtents), 1.0f,
+                        btVector3(1.0f, 0.2f, 0.2f), position, btQuaternion::getIdentity());
+                }
+                pWorld->addRigidBody(objects[i]->GetRigidBody());
+            }
+            double spawn = elapsedMicroseconds(start) / 1000.0;
+            unsigned long long spawnAllocations = countHeapCalls() - allocations;
+            int shapes = mode == 2 ? pools.GetShapes().GetShapeCount() : agents;
+
+            // a step between, outside of the counts: contacts come and go
+            pWorld->stepSimulation(1.0f / 60.0f, 0, 1.0f / 60.0f);
+
+            allocations = countHeapCalls();
+            start = BenchClock::now();
+            for (int i = 0; i < agents; ++i) {
+                pWorld->removeRigidBody(objects[i]->GetRigidBody());
+                if (mode > 0) {
+                    pools.GetGameObjects().Destroy(objects[i]);
+                }
+                else {
+                    delete objects[i];
+                }
+            }
+            double despawn = elapsedMicroseconds(start) / 1000.0;
+            unsigned long long heapCalls = spawnAllocations + countHeapCalls() - allocations;
+
+            std::cout << modeNames[mode] << "," << round << "," << spawn << "," << despawn << ","
+                << (double)heapCalls / std::max(1, agents) << "," << pools.GetSlabAllocations() - poolAllocations << "," << shapes << std::endl;
+        }
+        if (mode > 0) {
+            pools.PrintStats(std::cout);
+        }
+        maze.RemoveFromWorld(pWorld);
+    }
+    s_countNews = false;
+    btAlignedAllocSetCustom(nullptr, nullptr);
+    return 0;
+}
+
+/*
+    Capture and restore time of a snapshot of the maze with 'bodies'
+    spheres, caught mid fall, against resetting the level by removing and
+    adding the bodies again. Then the same 'ticks' are run twice from the
+    snapshot: the bodies must end in the same place both times
+*/
+int runSnapshotBenchmark(int bodies, int iterations, const PhysicsConfig& baseConfig) {
+    ObjWGroupsLoader colliderLoader;
+    colliderLoader.loadObj("models/mazeY_collider_NoTextures.obj");
+    MazePhysics maze;
+    if (!maze.Build(colliderLoader.Meshes, glm::translate(glm::mat4(1.0f), MAZE_OFFSET))) {
+        return -1;
+    }
+    // without it the pairs come in the order of the world's history, not the snapshot's
+    PhysicsConfig config = baseConfig;
+    config.deterministic = true;
+    PhysicsBackend backend;
+    btDiscreteDynamicsWorld* pWorld = backend.Create(config);
+    maze.AddToWorld(pWorld);
+    maze.AddBodies(pWorld, bodies);
+    const float stepSize = 1.0f / 60.0f;
+    for (int tick = 0; tick < 60; ++tick) {
+        pWorld->stepSimulation(stepSize, 0, stepSize);
+    }
+
+    WorldSnapshot snapshot;
+    double capture = 0.0, restore = 0.0;
+    bool restored = true;
+    for (int i = 0; i < iterations; ++i) {
+        BenchClock::time_point start = BenchClock::now();
+        snapshot.Capture(pWorld);
+        capture += elapsedMicroseconds(start);
+        // a step between, so the restore has something to undo
+        pWorld->stepSimulation(stepSize, 0, stepSize);
+        start = BenchClock::now();
+        restored = snapshot.Restore(pWorld) && restored;
+        restore += elapsedMicroseconds(start);
+    }
+
+    // the reset without snapshot: new bodies at their spawn positions
+    double rebuild = 0.0;
+    for (int i = 0; i < iterations; ++i) {
+        BenchClock::time_point start = BenchClock::now();
+        maze.RemoveBodies(pWorld);
+        maze.AddBodies(pWorld, bodies);
+        rebuild += elapsedMicroseconds(start);
+    }
+
+    // same ticks from the same snapshot
+    const int ticks = 30;
+    std::vector<btVector3> firstRun(bodies);
+    for (int tick = 0; tick < 60; ++tick) {
+        pWorld->stepSimulation(stepSize, 0, stepSize);
+    }
+    snapshot.Capture(pWorld);
+    float maxError = 0.0f;
+    for (int run = 0; run < 2; ++run) {
+        restored = snapshot.Restore(pWorld) && restored;
+        for (int tick = 0; tick < ticks; ++tick) {
+            pWorld->stepSimulation(stepSize, 0, stepSize);
+        }
+        for (int i = 0; i < bodies; ++i) {
+            const btVector3& position = maze.GetBodies()[i]->getWorldTransform().getOrigin();
+            if (run == 0) firstRun[i] = position;
+            else maxError = std::max(maxError, (float)(position - firstRun[i]).length());
+        }
+    }
+
+    std::cout << "# " << bodies << " bodies, " << snapshot.GetObjectCount() << " objects, " << iterations << " iterations, "
+        << PhysicsBackend::GetBroadphaseName(config.broadphase) << " broadphase" << std::endl;
+    std::cout << "snapshot_kb,capture_ms,restore_ms,rebuild_ms,replay_ticks,replay_max_error,restored" << std::endl;
+    std::cout << snapshot.GetByteSize() / 1024.0 << "," << capture / iterations / 1000.0 << "," << restore / iterations / 1000.0 << ","
+        << rebuild / iterations / 1000.0 << "," << ticks << "," << maxError << "," << (restored ? "yes" : "no") << std::endl;
+
+    maze.RemoveBodies(pWorld);
+    maze.RemoveFromWorld(pWorld);
+    return restored ? 0 : -1;
+}
+
+// closest hit, and the maze triangle it is on
+struct MazeRayCallback : public btCollisionWorld::ClosestRayResultCallback {
+    int triangle;
+
+    MazeRayCallback(const btVector3& from, const btVector3& to) : ClosestRayResultCallback(from, to), triangle(-1) {}
+
+    virtual btScalar addSingleResult(btCollisionWorld::LocalRayResult& rayResult, bool normalInWorldSpace) {
+        // only called with hits closer than the last one
+        triangle = rayResult.m_localShapeInfo ? rayResult.m_localShapeInfo->m_triangleIndex : -1;
+        return ClosestRayResultCallback::addSingleResult(rayResult, normalInWorldSpace);
+    }
+};
+
+/*
+    Startup of the maze physics: parsing the collider OBJ and building
+    the mesh and its BVH, against loading the baked .bullet file with the
+    world importer (Labyrinthe --bake physics). Rays through both mazes
+    check that they hit the same walls at the same places
+*/
+int runMazeLoadBenchmark(int runs, const std::string& bakedPath) {
+    double objMilliseconds = 0.0, bakedMilliseconds = 0.0;
+    for (int run = 0; run < runs; ++run) {
+        BenchClock::time_point start = BenchClock::now();
+        ObjWGroupsLoader colliderLoader;
+        colliderLoader.loadObj("models/mazeY_collider_NoTextures.obj");
+        MazePhysics built;
+        if (!built.Build(colliderLoader.Meshes, glm::translate(glm::mat4(1.0f), MAZE_OFFSET))) {
+            return -1;
+        }
+        objMilliseconds += elapsedMicroseconds(start) / 1000.0;
+
+        start = BenchClock::now();
+        MazePhysics loaded;
+        if (!loaded.Load(bakedPath, "models/mazeY_collider_NoTextures.obj")) {
+            std::cerr << "Bake it first with: --bake physics" << std::endl;
+            return -1;
+        }
+        bakedMilliseconds += elapsedMicroseconds(start) / 1000.0;
+    }
+
+    ObjWGroupsLoader colliderLoader;
+    colliderLoader.loadObj("models/mazeY_collider_NoTextures.obj");
+    MazePhysics built, loaded;
+    built.Build(colliderLoader.Meshes, glm::translate(glm::mat4(1.0f), MAZE_OFFSET));
+    loaded.Load(bakedPath, "models/mazeY_collider_NoTextures.obj");
+    PhysicsBackend builtBackend, loadedBackend;
+    btDiscreteDynamicsWorld* pBuiltWorld = builtBackend.Create(PhysicsConfig());
+    btDiscreteDynamicsWorld* pLoadedWorld = loadedBackend.Create(PhysicsConfig());
+    built.AddToWorld(pBuiltWorld);
+    loaded.AddToWorld(pLoadedWorld);
+
+    // level rays in random directions through the corridors
+    const int rays = 10000;
+    const AABB& bounds = built.GetBounds();
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> x(bounds.min.x, bounds.max.x), z(bounds.min.z, bounds.max.z), angle(0.0f, 6.2831853f);
+    int mismatches = 0, hits = 0;
+    for (int i = 0; i < rays; ++i) {
+        btVector3 from(x(random), built.GetFloorHeight() + 1.0f, z(random));
+        float a = angle(random);
+        btVector3 to = from + btVector3(std::cos(a), 0.0f, std::sin(a)) * 30.0f;
+        MazeRayCallback builtHit(from, to), loadedHit(from, to);
+        pBuiltWorld->rayTest(from, to, builtHit);
+        pLoadedWorld->rayTest(from, to, loadedHit);
+        hits += builtHit.hasHit() ? 1 : 0;
+        int builtWall = builtHit.hasHit() ? built.GetWallOfTriangle(builtHit.triangle) : -1;
+        int loadedWall = loadedHit.hasHit() ? loaded.GetWallOfTriangle(loadedHit.triangle) : -1;
+        if (builtHit.hasHit() != loadedHit.hasHit() || builtWall != loadedWall
+            || std::fabs(builtHit.m_closestHitFraction - loadedHit.m_closestHitFraction) > 1e-5f) {
+            ++mismatches;
+        }
+    }
+    built.RemoveFromWorld(pBuiltWorld);
+    loaded.RemoveFromWorld(pLoadedWorld);
+
+    std::ifstream bakedFile(bakedPath, std::ios::binary | std::ios::ate);
+    std::cout << "# " << built.GetWallCount() << " walls, " << runs << " runs, " << bakedPath << " " << (long long)bakedFile.tellg() / 1024 << " KB" << std::endl;
+    std::cout << "obj_build_ms,bullet_load_ms,speedup,rays,hits,mismatches" << std::endl;
+    std::cout << objMilliseconds / runs << "," << bakedMilliseconds / runs << "," << objMilliseconds / std::max(bakedMilliseconds, 1e-6) << ","
+        << rays << "," << hits << "," << mismatches << std::endl;
+    return mismatches == 0 ? 0 : -1;
+}
+
+/*
+    Batches of sensor rays and agent sweeps through the maze: the world's
+    rayTest / convexSweepTest one query at a time, against MazeQueries on
+    more and more threads. The batch results must match the world's
+*/
+int runMazeQueryBenchmark(int rays, int calls) {
+    ObjWGroupsLoader colliderLoader;
+    colliderLoader.loadObj("models/mazeY_collider_NoTextures.obj");
+    MazePhysics maze;
+    if (!maze.Build(colliderLoader.Meshes, glm::translate(glm::mat4(1.0f), MAZE_OFFSET))) {
+        return -1;
+    }
+    PhysicsBackend backend;
+    btDiscreteDynamicsWorld* pWorld = backend.Create(PhysicsConfig());
+    maze.AddToWorld(pWorld);
+
+    // 10 unit sensor rays from agent height, most level, some down to the floor.
+    // A tenth as many agent sized sweeps along the way the agents walk
+    const AABB& bounds = maze.GetBounds();
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> angle(0.0f, 2.0f * SIMD_PI), tilt(-0.4f, 0.05f);
+    std::uniform_real_distribution<float> spawnX(bounds.min.x, bounds.max.x), spawnZ(bounds.min.z, bounds.max.z);
+    std::vector<btVector3> from(rays), to(rays);
+    for (int i = 0; i < rays; ++i) {
+        from[i] = btVector3(spawnX(random), maze.GetFloorHeight() + 0.3f, spawnZ(random));
+        float a = angle(random);
+        to[i] = from[i] + btVector3(std::cos(a), tilt(random), std::sin(a)).normalized() * 10.0f;
+    }
+    btCylinderShape agentShape(btVector3(0.37f, 0.21f, 0.37f));
+    int sweeps = std::max(1, rays / 10);
+    std::vector<btTransform> sweepFrom(sweeps), sweepTo(sweeps);
+    for (int i = 0; i < sweeps; ++i) {
+        btVector3 start(spawnX(random), maze.GetFloorHeight() + 0.26f, spawnZ(random));
+        float a = angle(random);
+        sweepFrom[i] = btTransform(btQuaternion::getIdentity(), start);
+        sweepTo[i] = btTransform(btQuaternion::getIdentity(), start + btVector3(std::cos(a), 0.0f, std::sin(a)) * 3.0f);
+    }
+
+    // the world's answers, one query at a time
+    std::vector<float> worldRayDistances(rays), worldSweepDistances(sweeps);
+    std::vector<int> worldWalls(rays);
+    BenchClock::time_point start = BenchClock::now();
+    for (int call = 0; call < calls; ++call) {
+        for (int i = 0; i < rays; ++i) {
+            MazeRayCallback hit(from[i], to[i]);
+            pWorld->rayTest(from[i], to[i], hit);
+            worldRayDistances[i] = hit.hasHit() ? hit.m_closestHitFraction * (to[i] - from[i]).length() : -1.0f;
+            worldWalls[i] = hit.hasHit() && hit.m_collisionObject == maze.GetMazeObject() ? maze.GetWallOfTriangle(hit.triangle) : -1;
+        }
+    }
+    double worldRayMs = elapsedMicroseconds(start) / 1000.0 / calls;
+    start = BenchClock::now();
+    for (int call = 0; call < calls; ++call) {
+        for (int i = 0; i < sweeps; ++i) {
+            btCollisionWorld::ClosestConvexResultCallback hit(sweepFrom[i].getOrigin(), sweepTo[i].getOrigin());
+            pWorld->convexSweepTest(&agentShape, sweepFrom[i], sweepTo[i], hit);
+            worldSweepDistances[i] = hit.hasHit() ? hit.m_closestHitFraction * 3.0f : -1.0f;
+        }
+    }
+    double worldSweepMs = elapsedMicroseconds(start) / 1000.0 / calls;
+
+    int rayHits = 0, sweepHits = 0;
+    for (int i = 0; i < rays; ++i) rayHits += worldRayDistances[i] >= 0.0f ? 1 : 0;
+    for (int i = 0; i < sweeps; ++i) sweepHits += worldSweepDistances[i] >= 0.0f ? 1 : 0;
+
+    std::cout << "# " << maze.GetWallCount() << " walls, " << rays << " rays and " << sweeps << " sweeps per call, " << calls << " calls, "
+        << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << "query,method,threads,ms_per_call,queries_per_s,hits,mismatches" << std::endl;
+    std::cout << "ray,world,1," << worldRayMs << "," << rays / (worldRayMs / 1000.0) << "," << rayHits << ",0" << std::endl;
+    std::cout << "sweep,world,1," << worldSweepMs << "," << sweeps / (worldSweepMs / 1000.0) << "," << sweepHits << ",0" << std::endl;
+
+    std::vector<float> distances(rays);
+    std::vector<btVector3> normals(rays);
+    std::vector<int> walls(rays);
+    MazeQueryResults results(distances.data(), normals.data(), walls.data());
+    int maxThreads = std::max(4, (int)std::thread::hardware_concurrency());
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        MazeQueries queries(maze, threads);
+
+        start = BenchClock::now();
+        for (int call = 0; call < calls; ++call) {
+            queries.RayTest(from.data(), to.data(), rays, results);
+        }
+        double rayMs = elapsedMicroseconds(start) / 1000.0 / calls;
+        int hits = 0, mismatches = 0;
+        for (int i = 0; i < rays; ++i) {
+            hits += distances[i] >= 0.0f ? 1 : 0;
+            if (walls[i] != worldWalls[i] || std::fabs(distances[i] - worldRayDistances[i]) > 1e-4f) ++mismatches;
+        }
+        std::cout << "ray,batch," << threads << "," << rayMs << "," << rays / (rayMs / 1000.0) << "," << hits << "," << mismatches << std::endl;
+
+        start = BenchClock::now();
+        for (int call = 0; call < calls; ++call) {
+            queries.ConvexSweep(&agentShape, sweepFrom.data(), sweepTo.data(), sweeps, results);
+        }
+        double sweepMs = elapsedMicroseconds(start) / 1000.0 / calls;
+        hits = 0;
+        mismatches = 0;
+        for (int i = 0; i < sweeps; ++i) {
+            hits += distances[i] >= 0.0f ? 1 : 0;
+            if (std::fabs(distances[i] - worldSweepDistances[i]) > 1e-3f) ++mismatches;
+        }
+        std::cout << "sweep,batch," << threads << "," << sweepMs << "," << sweeps / (sweepMs / 1000.0) << "," << hits << "," << mismatches << std::endl;
+    }
+
+    maze.RemoveFromWorld(pWorld);
+    return 0;
+}
+
+/*
+    chibi.obj decomposed with more and more hulls allowed, against the
+    box it gets without a decomposition: bake time, how much the shape
+    overfills the mesh, and the step time of 'bodies' of them dropped on
+    the ground (each run starts from the same state)
+*/
+int runHullBenchmark(int bodies, int ticks, const ConvexDecompositionConfig& baseConfig) {
+    ConvexDecomposition source;
+    if (!source.LoadMesh("models/chibi.obj")) {
+        return -1;
+    }
+    double meshVolume = source.GetMeshVolume();
+    const int hullLimits[] = { 0, 1, 4, 8, 16, 32 };
+
+    std::cout << "# chibi.obj, mesh volume " << meshVolume << ", " << bodies << " bodies, " << ticks << " ticks of 1/60 s, "
+        << baseConfig.resolution << " voxels, at most " << baseConfig.maxVerticesPerHull << " vertices per hull" << std::endl;
+    std::cout << "shape,max_hulls,bake_ms,hulls,vertices,volume_ratio,avg_step_ms" << std::endl;
+    // frees the compounds with their children
+    ObjectPools pools;
+    for (int limit : hullLimits) {
+        ConvexDecomposition decomposition = source;
+        ConvexDecompositionConfig config = baseConfig;
+        // the box is the AABB of a single hull
+        config.maxHulls = limit == 0 ? 1 : limit;
+        BenchClock::time_point bakeStart = BenchClock::now();
+        btCompoundShape* pCompound = decomposition.Bake(config) ? decomposition.CreateShape() : nullptr;
+        double bake = limit == 0 ? 0.0 : elapsedMicroseconds(bakeStart) / 1000.0;
+        if (!pCompound) {
+            std::cerr << "Decomposition of chibi.obj into " << config.maxHulls << " hulls failed, skipped" << std::endl;
+            continue;
+        }
+
+        btCollisionShape* pShape = pCompound;
+        btVector3 aabbMin, aabbMax;
+        if (limit == 0) {
+            // the box around the mesh, what the objects get today
+            pCompound->getAabb(btTransform::getIdentity(), aabbMin, aabbMax);
+            pools.DestroyShape(pCompound);
+            pShape = new btBoxShape((aabbMax - aabbMin) * 0.5f);
+        }
+        pShape->getAabb(btTransform::getIdentity(), aabbMin, aabbMax);
+        btVector3 size = aabbMax - aabbMin;
+        double volume = limit == 0 ? size.x() * size.y() * size.z() : decomposition.GetHullVolume();
+
+        // a square of bodies above a ground box, tilted so they tumble
+        PhysicsBackend backend;
+        btDiscreteDynamicsWorld* pWorld = backend.Create(PhysicsConfig());
+        btBoxShape groundShape(btVector3(1000.0f, 1.0f, 1000.0f));
+        btCollisionObject ground;
+        ground.setCollisionShape(&groundShape);
+        ground.setWorldTransform(btTransform(btQuaternion::getIdentity(), btVector3(0.0f, -1.0f, 0.0f)));
+        pWorld->addCollisionObject(&ground);
+        btVector3 inertia;
+        pShape->calculateLocalInertia(1.0f, inertia);
+        int columns = std::max(1, (int)std::sqrt((float)bodies));
+        btScalar spacing = size.length();
+        std::vector<btRigidBody*> rigidBodies;
+        for (int i = 0; i < bodies; ++i) {
+            btTransform transform(btQuaternion(btVector3(1.0f, 0.0f, 1.0f).normalized(), 0.3f * (i % 7)),
+                btVector3((i % columns) * spacing, spacing, (i / columns) * spacing));
+            btRigidBody* pBody = new btRigidBody(1.0f, new btDefaultMotionState(transform), pShape, inertia);
+            pWorld->addRigidBody(pBody);
+            rigidBodies.push_back(pBody);
+        }
+
+        BenchClock::time_point start = BenchClock::now();
+        for (int tick = 0; tick < ticks; ++tick) {
+            pWorld->stepSimulation(1.0f / 60.0f, 0, 1.0f / 60.0f);
+        }
+        double step = elapsedMicroseconds(start) / 1000.0 / ticks;
+
+        std::cout << (limit == 0 ? "box" : "hulls") << "," << limit << "," << bake << "," << decomposition.GetHullCount() << ","
+            << (limit == 0 ? 8 : decomposition.GetVertexCount()) << "," << volume / meshVolume << "," << step << std::endl;
+
+        for (btRigidBody* pBody : rigidBodies) {
+            pWorld->removeRigidBody(pBody);
+            delete pBody->getMotionState();
+            delete pBody;
+        }
+        pWorld->removeCollisionObject(&ground);
+        pools.DestroyShape(pShape);
+    }
+    return 0;
+}
+
+int runBenchmarks(int argc, char* argv[]) {
+    std::string name = argc > 2 ? argv[2] : "";
+    int count = argc > 3 ? std::atoi(argv[3]) : 0;
+
+    if (name == "culling") {
+        return runCullingBenchmark(count > 0 ? count : 300);
+    }
+    if (name == "pvs") {
+        return runVisibilityBenchmark(count > 0 ? count : 300);
+    }
+    if (name == "textures") {
+        return runTextureBenchmark(count > 0 ? count : 5);
+    }
+    if (name == "hdr") {
+        return runHdrBenchmark(count > 0 ? count : 20);
+    }
+    if (name == "physics") {
+        // --physics-scheduler / --physics-threads pick the scheduler and the most threads to try
+        int frames = argc > 4 && argv[4][0] != '-' ? std::atoi(argv[4]) : 0;
+        return runPhysicsBenchmark(count > 0 ? count : 4000, frames > 0 ? frames : 300, PhysicsConfig::FromArgs(argc, argv));
+    }
+    if (name == "agents") {
+        // --physics-broadphase picks the broadphase
+        int ticks = argc > 4 && argv[4][0] != '-' ? std::atoi(argv[4]) : 0;
+        return runCharacterBenchmark(count > 0 ? count : 2000, ticks > 0 ? ticks : 300, PhysicsConfig::FromArgs(argc, argv));
+    }
+    if (name == "pools") {
+        // --physics-broadphase picks the broadphase
+        int rounds = argc > 4 && argv[4][0] != '-' ? std::atoi(argv[4]) : 0;
+        return runPoolBenchmark(count > 0 ? count : 4000, rounds > 0 ? rounds : 5, PhysicsConfig::FromArgs(argc, argv));
+    }
+    if (name == "snapshot") {
+        // --physics-broadphase picks the broadphase
+        int iterations = argc > 4 && argv[4][0] != '-' ? std::atoi(argv[4]) : 0;
+        return runSnapshotBenchmark(count > 0 ? count : 10000, iterations > 0 ? iterations : 20, PhysicsConfig::FromArgs(argc, argv));
+    }
+    if (name == "maze-load") {
+        std::string bakedPath = argc > 4 ? argv[4] : "models/mazeY.bullet";
+        return runMazeLoadBenchmark(count > 0 ? count : 10, bakedPath);
+    }
+    if (name == "hulls") {
+        // --hulls-vertices / --hulls-resolution / --hulls-concavity set the decomposition
+        int ticks = argc > 4 && argv[4][0] != '-' ? std::atoi(argv[4]) : 0;
+        return runHullBenchmark(count > 0 ? count : 100, ticks > 0 ? ticks : 300, ConvexDecompositionConfig::FromArgs(argc, argv));
+    }
+    if (name == "rays") {
+        int calls = argc > 4 ? std::atoi(argv[4]) : 0;
+        return runMazeQueryBenchmark(count > 0 ? count : 10000, calls > 0 ? calls : 10);
+    }
+    if (name == "broadphase") {
+        int ticks = argc > 4 ? std::atoi(argv[4]) : 0;
+        return runBroadphaseBenchmark(count > 0 ? count : 8000, ticks > 0 ? ticks : 120);
+    }
+
+    std::cerr << "Usage: " << argv[0] << " --bench <name> [count]" << std::endl;
+    std::cerr << "Available benchmarks:" << std::endl;
+    std::cerr << "  culling [frames]  frustum culling of the maze chunks along scripted camera paths" << std::endl;
+    std::cerr << "  pvs [frames]      triangles submitted with the maze PVS versus the full draw" << std::endl;
+    std::cerr << "  textures [runs]   image decode and mip build versus loading the baked DDS files" << std::endl;
+    std::cerr << "  hdr [runs]        agent.hdr decode and half float conversion, 8 bit SOIL versus the HDR paths" << std::endl;
+    std::cerr << "  physics [bodies] [frames] [--physics-scheduler name] [--physics-threads max]" << std::endl;
+    std::cerr << "                    maze step time, single threaded world versus the multithreaded one per thread count" << std::endl;
+    std::cerr << "  agents [count] [ticks] [--physics-broadphase name]" << std::endl;
+    std::cerr << "                    character controllers walking the maze, time per tick" << std::endl;
+    std::cerr << "  broadphase [agents] [ticks]  pair update and ray cost of the dbvt, sweep and prune and grid broadphases" << std::endl;
+    std::cerr << "  pools [agents] [rounds] [--physics-broadphase name]" << std::endl;
+    std::cerr << "                    spawn and despawn of game objects, heap calls with new/delete versus the pools" << std::endl;
+    std::cerr << "  maze-load [runs] [maze.bullet]  maze physics from the collider OBJ versus the baked .bullet file" << std::endl;
+    std::cerr << "  rays [rays] [calls]  batched maze rays and sweeps on 1..n threads versus the world's rayTest" << std::endl;
+    std::cerr << "  hulls [bodies] [ticks] [--hulls-vertices n] [--hulls-resolution voxels] [--hulls-concavity x]" << std::endl;
+    std::cerr << "                    chibi.obj as a box versus convex decompositions of more and more hulls" << std::endl;
+    std::cerr << "  snapshot [bodies] [iterations] [--physics-broadphase name]" << std::endl;
+    std::cerr << "                    capture and restore of the world state versus rebuilding the bodies, replay check" << std::endl;
+    return -1;
+}
@@ -0,0 +1,53 @@
+/*
+    Headless benchmarks. They only use CPU side data (no window or GL context
+    is created) and print their results on the standard output.
+    Run with: Labyrinthe --bench <name> [options]
+*/
+
+#ifndef BENCHMARKS_H_INCLUDED
+#define BENCHMARKS_H_INCLUDED
+
+#include <string>
+
+// runs the benchmark named by argv[2], returns the process exit code
+int runBenchmarks(int argc, char* argv[]);
+
+// frustum culling of the maze chunks along scripted camera paths
+int runCullingBenchmark(int frames);
+
+// maze cell visibility (PVS) on top of the frustum culling
+int runVisibilityBenchmark(int frames);
+
+// decoding the source textures versus loading the baked compressed ones
+int runTextureBenchmark(int iterations);
+
+// decode + half float conversion throughput of the HDR texture paths
+int runHdrBenchmark(int iterations);
+
+// step time of the maze filled with bodies against the physics thread count
+struct PhysicsConfig;
+int runPhysicsBenchmark(int bodies, int frames, const PhysicsConfig& baseConfig);
+
+// kinematic character controllers walking the maze, time per tick
+int runCharacterBenchmark(int agents, int ticks, const PhysicsConfig& config);
+
+// pair update and ray query cost of each broadphase as the agent count grows
+int runBroadphaseBenchmark(int maxAgents, int ticks);
+
+// spawn and despawn time and heap calls of game objects, from the heap, the pools and with shared shapes
+int runPoolBenchmark(int agents, int rounds, const PhysicsConfig& config);
+
+// maze physics startup, built from the collider OBJ versus loaded from the baked .bullet file
+int runMazeLoadBenchmark(int runs, const std::string& bakedPath);
+
+// batched maze ray and sweep queries per thread count, against the world's queries
+int runMazeQueryBenchmark(int rays, int calls);
+
+// bake time, fit and step time of a model's convex decomposition against its box
+struct ConvexDecompositionConfig;
+int runHullBenchmark(int bodies, int ticks, const ConvexDecompositionConfig& baseConfig);
+
+// capture and restore time of the world state, and replays from the same snapshot
+int runSnapshotBenchmark(int bodies, int iterations, const PhysicsConfig& config);
+
+#endif // BENCHMARKS_H_INCLUDED
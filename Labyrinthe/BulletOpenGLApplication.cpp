@@ -30,77 +30,68 @@ BulletOpenGLApplication::BulletOpenGLApplication() :
 	m_pCollisionConfiguration(nullptr),
 	m_pDispatcher(nullptr),
 	m_pSolver(nullptr),
-	m_pWorld(nullptr)
+	m_pWorld(nullptr),
+	m_awakeBodies(0),
+	m_atRest(false),
+	m_redraw(true),
+	m_skippedFrames(0),
+	m_renderBvhDirty(true),
+	m_shaderId(-1),
+	m_arrayShaderId(-1),
+	m_textureCache(&m_texturePool)
 {
 
 }
 
 BulletOpenGLApplication::~BulletOpenGLApplication() {
-	// shutdown the physics system
-	ShutdownPhysics();
+	// shutdown the physics system, once its thread is done. The objects go
+	// first: their bodies, motion states and shapes live in m_pools, and the
+	// world has to be deleted while they are still there. ShutdownPhysics()
+	// would only call the base version from here
+	m_physicsThread.Stop();
+	while (!m_objects.empty()) {
+		DestroyGameObject(m_objects.back());
+	}
+	DestroyPhysicsWorld();
+	// whether spawning went to the heap over the run
+	m_pools.PrintStats(std::cout);
 }
 
 void BulletOpenGLApplication::Initialize() {
 	// this function is called inside glutmain() after
 	// creating the window, but before handing control
 	// to glfw
-		// Compile vertex shader
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-	glCompileShader(vertexShader);
-	// Check compilation status
-	GLint vertexCompiled;
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &vertexCompiled);
-	if (vertexCompiled != GL_TRUE)
-	{
-		GLsizei logLength = 0;
-		GLchar message[1024];
-		glGetShaderInfoLog(vertexShader, 1024, &logLength, message);
-		// Write the error to a log or handle it accordingly
-	}
-	// Compile fragment shader
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-	glCompileShader(fragmentShader);
-	// Check compilation status
-	GLint fragmentCompiled;
-	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &fragmentCompiled);
-	if (fragmentCompiled != GL_TRUE)
-	{
-		GLsizei logLength = 0;
-		GLchar message[1024];
-		glGetShaderInfoLog(fragmentShader, 1024, &logLength, message);
-		// Write the error to a log or handle it accordingly
+	// build the shaders, from the binary cache when possible
+	m_shaderId = m_shaders.LoadProgram("textured", "shaders/textured.vert", "shaders/textured.frag");
+	m_arrayShaderId = m_shaders.LoadProgram("textured_array", "shaders/textured_array.vert", "shaders/textured_array.frag");
+	if (m_shaderId < 0 || m_arrayShaderId < 0) {
+		std::cerr << "Failed to build the shaders" << std::endl;
 	}
 
-	// Create shader program
-	shaderProgram = glCreateProgram();
-	// Attach shaders to the program
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	// Link the program
-	glLinkProgram(shaderProgram);
-
 	// initialize the physics system
 	InitializePhysics();
+	if (m_pWorld) {
+		SaveSnapshot(m_levelStart);
+	}
 
 	// Use the program
-	glUseProgram(shaderProgram);
+	m_shaders.UseProgram(m_shaderId);
 	glClearColor(0.0f, 0.1f, 0.1f, 1.0f);
 
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	modelLoc = glGetUniformLocation(shaderProgram, "model");
-	projLoc = glGetUniformLocation(shaderProgram, "projection");
-	viewLoc = glGetUniformLocation(shaderProgram, "view");
+	// the matrices are read from uniform buffers, shared by all programs
+	m_frameUniforms.Create();
+	// and a resident slot per transform sync slot, for the objects at rest
+	m_transforms.Create(4096, 3, 4096);
 
 	projection = glm::perspective(glm::radians(45.0f), (float)1400 / (float)800, 0.1f, 100.0f);
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+	m_frameUniforms.SetProjection(projection);
 
-	glm::mat4 view = cam.GetViewMatrix(glm::vec3(0.0f, -3.0f, -10.0f));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+	m_view = cam.GetViewMatrix(glm::vec3(0.0f, -3.0f, -10.0f));
+	m_frameUniforms.SetView(m_view);
 
 	// create the debug drawer
 	m_pDebugDrawer = new DebugDrawer();
@@ -109,6 +100,11 @@ void BulletOpenGLApplication::Initialize() {
 	// add the debug drawer to the world
 	m_pWorld->setDebugDrawer(m_pDebugDrawer);
 
+	// from now on the world may be stepped on its own thread
+	if (m_physicsConfig.ownThread) {
+		StartPhysicsThread();
+	}
+
 }
 
 void BulletOpenGLApplication::Keyboard(GLFWwindow* window, unsigned char key, int x, int y) {
@@ -131,11 +127,23 @@ void BulletOpenGLApplication::Keyboard(GLFWwindow* window, unsigned char key, in
 }
 
 void BulletOpenGLApplication::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	// whatever the key changes (debug drawing, a reload) shows in the next frame
+	RequestRedraw();
 	if (key == GLFW_KEY_B && action == GLFW_PRESS) {
 		// toggle wireframe debug drawing
 		std::cout << "toggle wireframe debug drawing" << std::endl;
 		m_pDebugDrawer->ToggleDebugFlag(btIDebugDraw::DBG_DrawWireframe);
 	}
+	if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+		std::cout << (ResetLevel() ? "level reset" : "level reset failed, the world changed") << std::endl;
+	}
+	if (key == GLFW_KEY_F5 && action == GLFW_PRESS) {
+		SaveSnapshot(m_quickSave);
+		std::cout << "quick save, " << m_quickSave.GetObjectCount() << " objects" << std::endl;
+	}
+	if (key == GLFW_KEY_F9 && action == GLFW_PRESS && !m_quickSave.IsEmpty()) {
+		std::cout << (RestoreSnapshot(m_quickSave) ? "quick load" : "quick load failed, the world changed") << std::endl;
+	}
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
 		glfwSetWindowShouldClose(window, GL_TRUE);
 	}
@@ -172,8 +180,10 @@ void BulletOpenGLApplication::SpecialUp(GLFWwindow* window, int key, int x, int
 
 void BulletOpenGLApplication::Reshape(GLFWwindow* window, int w, int h) {
 	glViewport(0, 0, w, h);
-	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)w / (float)h, 0.1f, 100.0f);
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+	// keep the member up to date, culling depends on it
+	projection = glm::perspective(glm::radians(45.0f), (float)w / (float)h, 0.1f, 100.0f);
+	m_frameUniforms.SetProjection(projection);
+	RequestRedraw();
 	//UpdateCamera();
 }
 
@@ -198,19 +208,57 @@ void BulletOpenGLApplication::Idle(GLFWwindow* window) {
 	// to perform any updating and rendering tasks
 
 	doMovement();
-	// get the time since the last iteration
-	float dt = m_clock.getTimeMilliseconds();
+	// get the real time since the last iteration, in seconds
+	float dt = m_clock.getTimeMicroseconds() * 0.000001f;
 	// reset the clock to 0
 	m_clock.reset();
-	// update the scene (convert ms to s)
-	UpdateScene(dt * 100000.0f);
+	// the time spent waiting at rest moved nothing, there is nothing to catch up
+	if (m_atRest) dt = 0.0f;
+	// run the fixed physics steps this time covers
+	UpdateScene(dt);
 
 	// update the camera
 	UpdateCamera();
 
+	// steps per frame and dropped time, every few seconds
+	if (m_timestepReportClock.getTimeMilliseconds() > 5000) {
+		const PhysicsFrame* pFrame = m_physicsThread.IsRunning() ? m_physicsThread.AcquireFrame() : nullptr;
+		if (pFrame) {
+			// totals since the thread started, the frame is a copy
+			FixedTimestep::PrintStats(std::cout, pFrame->stats, m_physicsConfig.tickRate);
+			std::cout << "Physics thread: tick " << pFrame->tick << ", last step " << pFrame->stepMilliseconds << " ms" << std::endl;
+		}
+		else {
+			m_timestep.PrintStats(std::cout);
+			m_timestep.ResetStats();
+		}
+		if (m_skippedFrames > 0) {
+			std::cout << "At rest: " << m_skippedFrames << " frames not rendered" << std::endl;
+			m_skippedFrames = 0;
+		}
+		m_timestepReportClock.reset();
+	}
+
+	// pick up edited shaders about once a second
+	if (m_shaderReloadClock.getTimeMilliseconds() > 1000) {
+		if (m_shaders.ReloadModifiedPrograms() > 0) RequestRedraw();
+		m_shaderReloadClock.reset();
+	}
+
+	// every body asleep, none moved in the last sync, the camera where the
+	// last frame saw the scene from and no texture left to load: the frame
+	// on screen is still right, the loop waits for events instead
+	m_atRest = !m_redraw && m_awakeBodies == 0 && m_transformSync.GetChangedCount() == 0 && m_view == m_renderedView
+		&& m_texturePool.getPendingCount() == 0 && m_textureStreamer.isSettled();
+	if (m_atRest) {
+		++m_skippedFrames;
+		return;
+	}
+
 	// render the scene
 	RenderScene();
-
+	m_renderedView = m_view;
+	m_redraw = false;
 }
 
 void BulletOpenGLApplication::Mouse(GLFWwindow* window, double xpos, double ypos) {
@@ -237,10 +285,10 @@ void BulletOpenGLApplication::UpdateCamera() {
 	if (m_screenWidth == 0 && m_screenHeight == 0)
 		return;
 
-	glm::mat4 view = cam.GetViewMatrix(glm::vec3(0.0f, -3.0f, -10.0f));
+	m_view = cam.GetViewMatrix(glm::vec3(0.0f, -3.0f, -10.0f));
 	//glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 8.0f), glm::vec3(0.0f, -4.0f, -10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	// the view matrix is now set
+	m_frameUniforms.SetView(m_view);
+	// the view matrix is now set, it is uploaded by RenderScene
 }
 
 void BulletOpenGLApplication::DrawBox(const btVector3& halfSize) {
@@ -336,40 +384,290 @@ void BulletOpenGLApplication::RenderScene() {
 	// clear the backbuffer
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// iterate through all of the objects in our world
-	for (GameObjects::iterator i = m_objects.begin(); i != m_objects.end(); ++i) {
-		// get the object from the iterator
-		GameObject* pObj = *i;
+	// upload the textures decoded since the last frame
+	if (m_texturePool.uploadFinished() > 0 && m_texturePool.getPendingCount() == 0) {
+		m_texturePool.printTimings();
+		m_textureCache.printMemoryReport();
+	}
 
-		// draw the object
-		//std::cout << "Drawing object in " << modelLoc << std::endl;
-		pObj->drawObject(modelLoc);
+	// upload the camera matrices if they changed
+	m_frameUniforms.Upload();
+
+	// find the chunks inside the view frustum
+	CullScene(m_view, projection);
+	m_textureStreamer.beginFrame();
+
+	// the visible items are sorted, so all the chunks of an object are
+	// next to each other and become a single batch with one transform
+	m_transforms.BeginFrame();
+	m_drawBatches.clear();
+	m_drawChunks.clear();
+	for (size_t i = 0; i < m_visibleItems.size();) {
+		DrawBatch batch;
+		batch.pObject = m_renderItems[m_visibleItems[i]].pObject;
+		batch.firstChunk = (int)m_drawChunks.size();
+		while (i < m_visibleItems.size() && m_renderItems[m_visibleItems[i]].pObject == batch.pObject) {
+			m_drawChunks.push_back(m_renderItems[m_visibleItems[i]].chunk);
+			++i;
+		}
+		batch.chunkCount = (int)m_drawChunks.size() - batch.firstChunk;
+		// objects that moved in the last sync go in this frame's segment.
+		// Static and sleeping ones keep a resident slot, written once when
+		// they come to rest and then only bound
+		int objectSlot = batch.pObject->GetTransformSlot();
+		int textureLayer = std::max(0, batch.pObject->GetTextureLayer());
+		if (m_transformSync.WasChanged(objectSlot)) {
+			m_transforms.ReleaseResident(objectSlot);
+			batch.transformSlot = m_transforms.Push(batch.pObject->GetPosition(), textureLayer);
+		}
+		else if (m_transforms.IsResident(objectSlot)) {
+			batch.transformSlot = m_transforms.GetResidentSlot(objectSlot);
+		}
+		else {
+			batch.transformSlot = m_transforms.SetResident(objectSlot, batch.pObject->GetPosition(), textureLayer);
+			if (batch.transformSlot < 0) {
+				// past the resident slots
+				batch.transformSlot = m_transforms.Push(batch.pObject->GetPosition(), textureLayer);
+			}
+		}
+		m_drawBatches.push_back(batch);
+
+		// the visible chunks tell how close the streamed textures are seen
+		if (m_textureStreamer.isStreamed(batch.pObject->GetTexture())) {
+			AABB bounds;
+			for (int c = 0; c < batch.chunkCount; ++c) {
+				bounds.Extend(batch.pObject->GetChunkWorldBounds(m_drawChunks[batch.firstChunk + c]));
+			}
+			m_textureStreamer.addDemand(batch.pObject->GetTexture(), bounds);
+		}
+	}
+	// one finer level per frame for the textures seen up close
+	m_textureStreamer.update(glm::vec3(glm::inverse(m_view)[3]), projection[1][1] * std::max(m_screenHeight, 1) * 0.5f);
+	// all the transforms are written before the first draw
+	m_transforms.Upload();
+
+	// objects in the texture array first, with a single program and texture bind
+	if (m_textureArray.getLayerCount() > 0) {
+		m_shaders.UseProgram(m_arrayShaderId);
+		m_textureArray.bind();
+		for (size_t i = 0; i < m_drawBatches.size(); ++i) {
+			const DrawBatch& batch = m_drawBatches[i];
+			if (batch.pObject->GetTextureLayer() < 0) continue;
+			m_transforms.Bind(batch.transformSlot);
+			batch.pObject->drawChunks(&m_drawChunks[batch.firstChunk], batch.chunkCount);
+		}
 	}
 
+	// then the objects with their own texture
+	m_shaders.UseProgram(m_shaderId);
+	for (size_t i = 0; i < m_drawBatches.size(); ++i) {
+		const DrawBatch& batch = m_drawBatches[i];
+		if (batch.pObject->GetTextureLayer() >= 0) continue;
+		m_transforms.Bind(batch.transformSlot);
+		batch.pObject->drawChunks(&m_drawChunks[batch.firstChunk], batch.chunkCount);
+	}
+	m_transforms.EndFrame();
+
 	// after rendering all game objects, perform debug rendering
 	// Bullet will figure out what needs to be drawn then call to
 	// our DebugDrawer class to do the rendering for us
-	m_pWorld->debugDrawWorld();
+	// The world is busy on the physics thread when it has one
+	if (!m_physicsThread.IsRunning()) {
+		m_pWorld->debugDrawWorld();
+	}
+}
+
+void BulletOpenGLApplication::RebuildRenderBvh() {
+	// one render item per chunk of every object
+	m_renderItems.clear();
+	m_renderItemBounds.clear();
+	for (GameObjects::iterator i = m_objects.begin(); i != m_objects.end(); ++i) {
+		GameObject* pObj = *i;
+		for (int chunk = 0; chunk < pObj->GetChunkCount(); ++chunk) {
+			RenderItem item = { pObj, chunk };
+			m_renderItems.push_back(item);
+			m_renderItemBounds.push_back(pObj->GetChunkWorldBounds(chunk));
+		}
+	}
+	m_renderBvh.Build(m_renderItemBounds);
+	m_renderBvhDirty = false;
+}
+
+int BulletOpenGLApplication::LoadTextureArray(const std::vector<std::string>& texturePaths) {
+	// objects created afterwards with one of these images use the array, its
+	// layers are decoded on the pool and uploaded by RenderScene once ready
+	int layers = m_textureArray.build(texturePaths, m_texturePool);
+	if (layers == 0) {
+		std::cerr << "Texture array disabled, every object binds its own texture" << std::endl;
+	}
+	return layers;
+}
+
+GLuint BulletOpenGLApplication::StreamTexture(const std::string& texturePath) {
+	// only the small levels are loaded now, RenderScene streams the others
+	return m_textureStreamer.add(texturePath);
+}
+
+bool BulletOpenGLApplication::LoadMazeVisibility(const std::string& path, const glm::mat4& mazeTransform) {
+	// without the baked file we simply render everything the frustum lets through
+	if (!m_mazeVisibility.Load(path)) {
+		std::cerr << "Maze visibility disabled, bake it with: --bake pvs" << std::endl;
+		return false;
+	}
+	m_mazeVisibility.SetTransform(mazeTransform);
+	return true;
+}
+
+void BulletOpenGLApplication::CullScene(const glm::mat4& view, const glm::mat4& projection) {
+	btClock cullClock;
+
+	if (m_renderBvhDirty) {
+		RebuildRenderBvh();
+	}
+	else {
+		// refit the tree when the last transform sync moved some objects
+		bool moved = false;
+		for (size_t i = 0; i < m_renderItems.size() && m_transformSync.GetChangedCount() > 0; ++i) {
+			if (m_transformSync.WasChanged(m_renderItems[i].pObject->GetTransformSlot())) {
+				m_renderItemBounds[i] = m_renderItems[i].pObject->GetChunkWorldBounds(m_renderItems[i].chunk);
+				moved = true;
+			}
+		}
+		if (moved) m_renderBvh.Refit(m_renderItemBounds);
+	}
+
+	Frustum frustum;
+	frustum.Extract(projection * view);
+
+	m_visibleItems.clear();
+	m_renderBvh.Query(frustum, m_visibleItems);
+
+	// drop the items hidden by the maze walls from the camera's cell
+	if (m_mazeVisibility.IsLoaded()) {
+		glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+		int cameraCell = m_mazeVisibility.GetCell(eye);
+		if (cameraCell >= 0) {
+			size_t kept = 0;
+			for (size_t i = 0; i < m_visibleItems.size(); ++i) {
+				if (m_mazeVisibility.IsVisible(cameraCell, m_renderItemBounds[m_visibleItems[i]])) {
+					m_visibleItems[kept++] = m_visibleItems[i];
+				}
+			}
+			m_visibleItems.resize(kept);
+		}
+	}
+	std::sort(m_visibleItems.begin(), m_visibleItems.end());
+
+	m_cullStats.visibleChunks = (int)m_visibleItems.size();
+	m_cullStats.totalChunks = (int)m_renderItems.size();
+	m_cullStats.submittedTriangles = 0;
+	m_cullStats.totalTriangles = 0;
+	for (size_t i = 0; i < m_visibleItems.size(); ++i) {
+		const RenderItem& item = m_renderItems[m_visibleItems[i]];
+		m_cullStats.submittedTriangles += item.pObject->GetChunkVertexCount(item.chunk) / 3;
+	}
+	for (size_t i = 0; i < m_renderItems.size(); ++i) {
+		m_cullStats.totalTriangles += m_renderItems[i].pObject->GetChunkVertexCount(m_renderItems[i].chunk) / 3;
+	}
+	m_cullStats.cullMicroseconds = cullClock.getTimeMicroseconds();
+}
+
+void BulletOpenGLApplication::CreatePhysicsWorld() {
+	m_pWorld = m_physics.Create(m_physicsConfig);
+	m_pCollisionConfiguration = m_physics.GetCollisionConfiguration();
+	m_pDispatcher = m_physics.GetDispatcher();
+	m_pBroadphase = m_physics.GetBroadphase();
+	m_pSolver = m_physics.GetSolver();
+	m_timestep.SetTickRate(m_physicsConfig.tickRate);
+	m_timestep.SetMaxCatchUpSteps(m_physicsConfig.maxCatchUpSteps);
+	m_timestep.Reset();
+	std::cout << "Physics: " << (m_physics.IsMultithreaded() ? "multithreaded" : "single threaded") << " world, "
+		<< m_physics.GetSchedulerName() << " scheduler, " << m_physics.GetThreadCount() << " thread(s), "
+		<< PhysicsBackend::GetBroadphaseName(m_physicsConfig.broadphase) << " broadphase, "
+		<< m_timestep.GetTickRate() << " Hz fixed step, up to " << m_timestep.GetMaxCatchUpSteps() << " steps per frame"
+		<< (m_physicsConfig.ownThread ? ", on its own thread" : "") << std::endl;
+}
+
+void BulletOpenGLApplication::StartPhysicsThread() {
+	if (!m_pWorld) return;
+	// the thread publishes the transforms in the slot order of m_transformSync
+	m_physicsThread.Start(m_pWorld, m_transformSync.GetMotionStates(), m_physicsConfig.tickRate, m_physicsConfig.maxCatchUpSteps);
+}
+
+bool BulletOpenGLApplication::StopPhysicsThread() {
+	bool wasRunning = m_physicsThread.IsRunning();
+	m_physicsThread.Stop();
+	return wasRunning;
+}
+
+void BulletOpenGLApplication::SaveSnapshot(WorldSnapshot& snapshot) {
+	if (!m_pWorld) return;
+	bool restart = StopPhysicsThread();
+	snapshot.Capture(m_pWorld);
+	if (restart) StartPhysicsThread();
+}
+
+bool BulletOpenGLApplication::RestoreSnapshot(const WorldSnapshot& snapshot) {
+	if (!m_pWorld || snapshot.IsEmpty()) return false;
+	bool restart = StopPhysicsThread();
+	bool restored = snapshot.Restore(m_pWorld);
+	if (restored) {
+		// the restored transforms become both ends of the interpolation,
+		// the next sync places every object instead of sliding them there,
+		// the sleeping ones too. The restarted thread publishes them
+		m_transformSync.Reset();
+		m_timestep.Reset();
+		m_transforms.ReleaseResidents();
+		RequestRedraw();
+	}
+	if (restart) StartPhysicsThread();
+	return restored;
+}
+
+void BulletOpenGLApplication::DestroyPhysicsWorld() {
+	m_physicsThread.Stop();
+	m_physics.Destroy();
+	m_pWorld = nullptr;
+	m_pCollisionConfiguration = nullptr;
+	m_pDispatcher = nullptr;
+	m_pBroadphase = nullptr;
+	m_pSolver = nullptr;
 }
 
 void BulletOpenGLApplication::UpdateScene(float dt) {
+	// the physics thread steps the world, only read what it published
+	if (m_physicsThread.IsRunning()) {
+		const PhysicsFrame* pFrame = m_physicsThread.AcquireFrame();
+		if (pFrame) {
+			m_transformSync.SyncFrom(pFrame->previous, pFrame->current, m_physicsThread.GetAlpha(*pFrame));
+			m_awakeBodies = pFrame->awakeBodies;
+		}
+		return;
+	}
+
 	// check if the world object exists
 	if (m_pWorld) {
-		float targetFPS = 60.0f;
-		float timeStep = 1.0f / targetFPS;
-
-		// Choose maxSubSteps based on your trade-off between accuracy and performance
-		int maxSubSteps = 1;
-
-		// Choose fixedTimeStep based on your desired accuracy
-		btScalar fixedTimeStep = 1.0f / targetFPS;
-		// step the simulation through time. This is called
-		// every update and the amount of elasped time was 
-		// determined back in ::Idle() by our clock object.
-		m_pWorld->stepSimulation(dt, maxSubSteps, fixedTimeStep);
+		// the frame time buys whole ticks of the same size, however
+		// fast or slow the frames are. Capped by the catch-up limit
+		int steps = m_timestep.Advance(dt);
+		for (int i = 0; i < steps; ++i) {
+			StepPhysics(m_timestep.GetStepSize());
+		}
+
+		// what is left of the frame time places the bodies that
+		// moved between the last two ticks, the others are untouched
+		m_transformSync.Sync(m_timestep.GetAlpha());
+		m_awakeBodies = PhysicsBackend::CountAwakeBodies(m_pWorld);
 	}
 }
 
+void BulletOpenGLApplication::StepPhysics(float stepSize) {
+	m_transformSync.BeginStep();
+	// maxSubSteps = 0: exactly one step of stepSize, and the motion
+	// states get the transforms at the end of it (no Bullet interpolation)
+	m_pWorld->stepSimulation(stepSize, 0, stepSize);
+}
+
 void BulletOpenGLApplication::DrawShape(btScalar* transform, const btCollisionShape* pShape, const btVector3& color) {
 	// set the color
 	glColor3f(color.x(), color.y(), color.z());
@@ -402,30 +700,108 @@ void BulletOpenGLApplication::DrawShape(btScalar* transform, const btCollisionSh
 
 GameObject* BulletOpenGLApplication::CreateGameObject(const std::string& objFilePath, const char* texturePath, glm::mat4 pos, btCollisionShape* pShape, const float& mass, const btVector3& color, const btVector3& initialPosition, const btQuaternion& initialRotation ) {
 	// create a new game object
-	GameObject* pObject = new GameObject(objFilePath, texturePath, pos, pShape, mass, color, initialPosition, initialRotation);
+	GameObject* pObject = m_pools.GetGameObjects().Create(objFilePath, texturePath, pos, pShape, mass, color, initialPosition, initialRotation, &m_pools);
+
+	// objects using the same image share one texture. It is decoded on the
+	// pool the first time and uploaded by RenderScene once ready. Images
+	// packed in the texture array only need their layer
+	int layer = m_textureArray.getLayer(pObject->GetTexturePath());
+	if (layer >= 0) {
+		pObject->SetTextureLayer(layer);
+	}
+	else if (m_textureStreamer.getTexture(pObject->GetTexturePath())) {
+		pObject->SetTexture(m_textureStreamer.getTexture(pObject->GetTexturePath()));
+	}
+	else {
+		pObject->SetTexture(m_textureCache.acquire(pObject->GetTexturePath()));
+	}
 
 	// push it to the back of the list
 	m_objects.push_back(pObject);
+	m_renderBvhDirty = true;
+	// it has to be drawn even if nothing else moves
+	RequestRedraw();
+	// its model matrix now lives in the transform array
+	pObject->SetTransformSlot(&m_transformSync,
+		m_transformSync.Add(pObject->GetOpenGLMotionState(), pObject->GetPosition(), pObject->GetBodyToModel()));
 
 	// check if the world object is valid
 	if (m_pWorld) {
-		// add the object's rigid body to the world
+		// add the object's rigid body to the world, between two steps
+		bool restart = StopPhysicsThread();
 		m_pWorld->addRigidBody(pObject->GetRigidBody());
+		if (restart) StartPhysicsThread();
 	}
 	return pObject;
 }
 
+btCollisionShape* BulletOpenGLApplication::AcquireHullShape(const std::string& objPath, btScalar scale, const ConvexDecompositionConfig& config) {
+	std::string cachePath = ConvexDecomposition::GetCachePath(objPath);
+	std::string assetId = scale == 1.0f ? cachePath : cachePath + "@" + std::to_string(scale);
+	btCollisionShape* pShape = GetShapes().AcquireAsset(assetId);
+	if (pShape) return pShape;
+
+	ConvexDecomposition decomposition;
+	if (!decomposition.Load(cachePath) || !(decomposition.GetConfig() == config)) {
+		// seconds of work, --bake hulls does it ahead of time
+		std::cout << "No convex hulls baked for " << objPath << " with this config, decomposing it now" << std::endl;
+		decomposition = ConvexDecomposition();
+		if (!decomposition.LoadMesh(objPath) || !decomposition.Bake(config)) {
+			return nullptr;
+		}
+		decomposition.Save(cachePath);
+	}
+	pShape = decomposition.CreateShape();
+	// moves the hulls and scales their points
+	pShape->setLocalScaling(btVector3(scale, scale, scale));
+	GetShapes().RegisterAsset(assetId, pShape);
+	return pShape;
+}
+
+void BulletOpenGLApplication::DestroyGameObject(GameObject* pObject) {
+	GameObjects::iterator it = std::find(m_objects.begin(), m_objects.end(), pObject);
+	if (it == m_objects.end()) return;
+	m_objects.erase(it);
+	m_renderBvhDirty = true;
+
+	if (m_pWorld) {
+		bool restart = StopPhysicsThread();
+		m_pWorld->removeRigidBody(pObject->GetRigidBody());
+		m_transformSync.Remove(pObject->GetTransformSlot());
+		if (restart) StartPhysicsThread();
+	}
+	else {
+		m_transformSync.Remove(pObject->GetTransformSlot());
+	}
+	// the next object in the slot writes its own transform
+	m_transforms.ReleaseResident(pObject->GetTransformSlot());
+	RequestRedraw();
+	// the texture stays in the cache until it is evicted
+	if (pObject->GetTexture() && !m_textureStreamer.isStreamed(pObject->GetTexture())) {
+		m_textureCache.release(pObject->GetTexturePath());
+	}
+	m_pools.GetGameObjects().Destroy(pObject);
+}
+
 GameObject* BulletOpenGLApplication::CreateGameObject(glm::mat4 pos, btCollisionShape* pShape, const float& mass, const btVector3& color, const btVector3& initialPosition, const btQuaternion& initialRotation) {
 	// create a new game object
-	GameObject* pObject = new GameObject(pos, pShape, mass, color, initialPosition, initialRotation);
+	GameObject* pObject = m_pools.GetGameObjects().Create(pos, pShape, mass, color, initialPosition, initialRotation, &m_pools);
 
 	// push it to the back of the list
 	m_objects.push_back(pObject);
+	m_renderBvhDirty = true;
+	// it has to be drawn even if nothing else moves
+	RequestRedraw();
+	// its model matrix now lives in the transform array
+	pObject->SetTransformSlot(&m_transformSync,
+		m_transformSync.Add(pObject->GetOpenGLMotionState(), pObject->GetPosition(), pObject->GetBodyToModel()));
 
 	// check if the world object is valid
 	if (m_pWorld) {
-		// add the object's rigid body to the world
+		// add the object's rigid body to the world, between two steps
+		bool restart = StopPhysicsThread();
 		m_pWorld->addRigidBody(pObject->GetRigidBody());
+		if (restart) StartPhysicsThread();
 	}
 	return pObject;
 }
\ No newline at end of file
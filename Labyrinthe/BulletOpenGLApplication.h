@@ -13,9 +13,24 @@
 
 // include our custom Motion State object
 #include "OpenGLMotionState.h"
+#include "PhysicsBackend.h"
+#include "FixedTimestep.h"
+#include "PhysicsThread.h"
+#include "WorldSnapshot.h"
+#include "TransformSync.h"
 
 #include "GameObject.h"
+#include "ObjectPools.h"
 #include "Camera.h"
+#include "RenderBvh.h"
+#include "MazeVisibility.h"
+#include "ConvexDecomposition.h"
+#include "UniformBuffers.h"
+#include "ShaderManager.h"
+#include "TextureDecodePool.h"
+#include "TextureCache.h"
+#include "TextureArray.h"
+#include "TextureStreamer.h"
 #include <vector>
 #include <set>
 #include <iterator>
@@ -31,6 +46,20 @@
 // a convenient typedef to reference an STL vector of GameObjects
 typedef std::vector<GameObject*> GameObjects;
 
+// a single cullable piece of the scene: one chunk of a game object's mesh
+struct RenderItem {
+	GameObject* pObject;
+	int chunk;
+};
+
+// the visible chunks of one object, drawn with a single transform
+struct DrawBatch {
+	GameObject* pObject;
+	int transformSlot;
+	int firstChunk; // range in m_drawChunks
+	int chunkCount;
+};
+
 class BulletOpenGLApplication {
 public:
 	BulletOpenGLApplication();
@@ -50,13 +79,51 @@ public:
 	// rendering. Can be overrideen by derived classes
 	virtual void RenderScene();
 
-	// scene updating. Can be overridden by derived classes
+	// scene updating, dt is the real frame time in seconds. Can be overridden by derived classes
 	virtual void UpdateScene(float dt);
+	// one fixed step of the world
+	void StepPhysics(float stepSize);
+	const FixedTimestepStats& GetTimestepStats() const { return m_timestep.GetStats(); }
+
+	// whether the last Idle found nothing to update and left the previous
+	// frame on screen. The loop can wait for events instead of swapping
+	bool IsAtRest() const { return m_atRest; }
+	// the next Idle renders, even when nothing moved (resized, exposed, a key)
+	void RequestRedraw() { m_redraw = true; }
 
 	// physics functions. Can be overriden by derived classes (like BasicDemo)
 	virtual void InitializePhysics() {};
 	virtual void ShutdownPhysics() {};
 
+	// single or multithreaded world, set before Initialize()
+	void SetPhysicsConfig(const PhysicsConfig& config) { m_physicsConfig = config; }
+	// builds the world below from the physics config
+	void CreatePhysicsWorld();
+	void DestroyPhysicsWorld();
+	// steps the world away from the frame (PhysicsConfig::ownThread). Stop
+	// returns whether it was running, to start it again after changing the world
+	void StartPhysicsThread();
+	bool StopPhysicsThread();
+
+	// every body's transform, velocities and activation, in place. Restore
+	// fails when objects were added or removed since the snapshot
+	void SaveSnapshot(WorldSnapshot& snapshot);
+	bool RestoreSnapshot(const WorldSnapshot& snapshot);
+	// back to the state right after InitializePhysics
+	bool ResetLevel() { return RestoreSnapshot(m_levelStart); }
+
+	// culling functions
+	void RebuildRenderBvh();
+	void CullScene(const glm::mat4& view, const glm::mat4& projection);
+	bool LoadMazeVisibility(const std::string& path, const glm::mat4& mazeTransform);
+	const CullStats& GetCullStats() const { return m_cullStats; }
+
+	// pack these images in the texture array, call before creating the objects using them
+	int LoadTextureArray(const std::vector<std::string>& texturePaths);
+
+	// stream the mip levels of this image by distance, call before creating the objects using it
+	GLuint StreamTexture(const std::string& texturePath);
+
 	// camera functions
 	void UpdateCamera();
 	void RotateCamera(float& angle, float value);
@@ -86,6 +153,18 @@ public:
 		const btQuaternion& initialRotation = btQuaternion(0, 0, 1, 1)
 	);
 
+	// remove the object from the world and release its texture
+	void DestroyGameObject(GameObject* pObject);
+
+	// the game objects, bodies, motion states and simple shapes come from here
+	ObjectPools& GetPools() { return m_pools; }
+	// shared shapes for CreateGameObject, each object takes one reference
+	ShapeRegistry& GetShapes() { return m_pools.GetShapes(); }
+	// a reference to the convex hulls of a model (btCompoundShape), shared
+	// like the shapes above, each scale is a shape of its own. From the .hulls
+	// file, decomposed again if it is missing or was baked with another config
+	btCollisionShape* AcquireHullShape(const std::string& objPath, btScalar scale = 1.0f, const ConvexDecompositionConfig& config = ConvexDecompositionConfig());
+
 
 
 protected:
@@ -109,56 +188,72 @@ protected:
 	btCollisionDispatcher* m_pDispatcher;
 	btConstraintSolver* m_pSolver;
 	btDynamicsWorld* m_pWorld;
+	// owns the components above
+	PhysicsBackend m_physics;
+	PhysicsConfig m_physicsConfig;
 
 	// a simple clock for counting time
 	btClock m_clock;
-
-	// an array of our game objects
+	// fixed rate physics steps, and their report
+	FixedTimestep m_timestep;
+	btClock m_timestepReportClock;
+	// or the same steps on their own thread
+	PhysicsThread m_physicsThread;
+	// the model matrices of the objects, updated from the bodies that moved
+	TransformSync m_transformSync;
+	// frames are skipped while nothing changes: bodies awake after the last
+	// steps, and the view of the last rendered frame
+	int m_awakeBodies;
+	bool m_atRest;
+	bool m_redraw;
+	glm::mat4 m_renderedView;
+	unsigned long long m_skippedFrames;
+	// the world as the level starts, and one quick save (F5 / F9)
+	WorldSnapshot m_levelStart;
+	WorldSnapshot m_quickSave;
+
+	// an array of our game objects, and the pools they are made from
+	ObjectPools m_pools;
 	GameObjects m_objects;
 
 	// debug renderer
 	DebugDrawer* m_pDebugDrawer;
 
-	GLint projLoc;
-	GLint modelLoc;
-	GLint viewLoc;
+	// frustum culling state
+	std::vector<RenderItem> m_renderItems;
+	std::vector<AABB> m_renderItemBounds;
+	std::vector<int> m_visibleItems;
+	RenderBvh m_renderBvh;
+	bool m_renderBvhDirty;
+	CullStats m_cullStats;
+	// precomputed maze cell visibility (optional)
+	MazeVisibility m_mazeVisibility;
+
+	// draw lists built from the visible items
+	std::vector<DrawBatch> m_drawBatches;
+	std::vector<int> m_drawChunks;
+
+	// camera matrices and per object transforms
+	FrameUniformBuffer m_frameUniforms;
+	TransformRingBuffer m_transforms;
+
+	// programs, with hot reload
+	ShaderManager m_shaders;
+	int m_shaderId;
+	int m_arrayShaderId;
+	btClock m_shaderReloadClock;
+
+	// background texture decoding, and the textures shared by the objects
+	TextureDecodePool m_texturePool;
+	TextureCache m_textureCache;
+	// small textures packed together, drawn without rebinding
+	TextureArray m_textureArray;
+	// large textures, their finest levels are only loaded when seen up close
+	TextureStreamer m_textureStreamer;
+
 	glm::mat4 projection;
-	GLuint shaderProgram;
+	glm::mat4 m_view;
 	GLuint VAO[3], VBO[3], textures;
-	const char* vertexShaderSource = R"(
-		#version 330
-
-		layout(location = 0) in vec3 a_position;
-		layout(location = 1) in vec2 a_texture;
-		layout(location = 2) in vec3 a_normal;
-
-		uniform mat4 model;
-		uniform mat4 projection;
-		uniform mat4 view;
-
-		out vec2 v_texture;
-
-		void main()
-		{
-			gl_Position = projection * view * model * vec4(a_position, 1.0);
-			v_texture = a_texture;
-		}
-	)";
-
-	const char* fragmentShaderSource = R"(
-		#version 330
-
-		in vec2 v_texture;
-
-		out vec4 out_color;
-
-		uniform sampler2D s_texture;
-
-		void main()
-		{
-			out_color = texture(s_texture, v_texture);
-		}
-	)";
 	bool firstMouse = true;
 
 	bool left = false, right = false, forward = false, backward = false;
@@ -0,0 +1,233 @@
+#include "CharacterController.h"
+
+#include <algorithm>
+
+CharacterStats CharacterController::s_stats;
+
+// the closest hit of a sweep, ignoring the character itself and, for the
+// floor sweep, the surfaces too steep to stand on
+class ClosestNotMeConvexResultCallback : public btCollisionWorld::ClosestConvexResultCallback {
+public:
+	ClosestNotMeConvexResultCallback(btCollisionObject* pMe, btScalar minNormalUp) :
+		btCollisionWorld::ClosestConvexResultCallback(btVector3(0.0f, 0.0f, 0.0f), btVector3(0.0f, 0.0f, 0.0f)),
+		m_pMe(pMe),
+		m_minNormalUp(minNormalUp)
+	{
+	}
+
+	virtual btScalar addSingleResult(btCollisionWorld::LocalConvexResult& convexResult, bool normalInWorldSpace) {
+		if (convexResult.m_hitCollisionObject == m_pMe || !convexResult.m_hitCollisionObject->hasContactResponse()) {
+			return 1.0f;
+		}
+		btVector3 normal = normalInWorldSpace ? convexResult.m_hitNormalLocal
+			: convexResult.m_hitCollisionObject->getWorldTransform().getBasis() * convexResult.m_hitNormalLocal;
+		if (normal.y() < m_minNormalUp) {
+			return 1.0f;
+		}
+		return ClosestConvexResultCallback::addSingleResult(convexResult, normalInWorldSpace);
+	}
+
+private:
+	btCollisionObject* m_pMe;
+	btScalar m_minNormalUp;
+};
+
+CharacterController::CharacterController(btConvexShape* pShape, btScalar stepHeight, const btVector3& position) :
+	m_pShape(pShape),
+	m_pMotionState(nullptr),
+	m_stepHeight(stepHeight),
+	m_gravity(9.81f),
+	m_maxSlopeCos(btCos(btRadians(45.0f))),
+	m_maxFallSpeed(50.0f),
+	m_walkVelocity(0.0f, 0.0f, 0.0f),
+	m_previousPosition(position),
+	m_verticalSpeed(0.0f),
+	m_onGround(false),
+	m_hitWall(false),
+	m_needsRecovery(true)
+{
+	m_pGhostObject = new btPairCachingGhostObject();
+	m_pGhostObject->setCollisionShape(pShape);
+	m_pGhostObject->setCollisionFlags(btCollisionObject::CF_CHARACTER_OBJECT);
+	m_pGhostObject->setWorldTransform(btTransform(btQuaternion::getIdentity(), position));
+	// the world doesn't compute contacts for it, only the recovery does
+	m_pGhostObject->forceActivationState(DISABLE_SIMULATION);
+}
+
+CharacterController::~CharacterController() {
+	delete m_pGhostObject;
+}
+
+void CharacterController::AddToWorld(btCollisionWorld* pWorld) {
+	// other characters are ignored, only the maze and the bodies stop it
+	pWorld->addCollisionObject(m_pGhostObject, btBroadphaseProxy::CharacterFilter,
+		btBroadphaseProxy::StaticFilter | btBroadphaseProxy::DefaultFilter);
+}
+
+void CharacterController::RemoveFromWorld(btCollisionWorld* pWorld) {
+	pWorld->removeCollisionObject(m_pGhostObject);
+}
+
+void CharacterController::Warp(const btVector3& position) {
+	m_pGhostObject->getWorldTransform().setOrigin(position);
+	m_previousPosition = position;
+	m_verticalSpeed = 0.0f;
+	m_onGround = false;
+	m_needsRecovery = true;
+	if (m_pMotionState) {
+		m_pMotionState->setWorldTransform(m_pGhostObject->getWorldTransform());
+	}
+}
+
+void CharacterController::Move(btCollisionWorld* pWorld, btScalar dt) {
+	const btVector3 up(0.0f, 1.0f, 0.0f);
+	m_previousPosition = GetPosition();
+	m_hitWall = false;
+
+	// the pairs must cover everything the sweeps of this tick can reach
+	m_verticalSpeed = m_onGround ? 0.0f : std::min(m_verticalSpeed + m_gravity * dt, m_maxFallSpeed);
+	btScalar fall = m_verticalSpeed * dt;
+	UpdateBroadphase(pWorld, m_walkVelocity.length() * dt + 2.0f * m_stepHeight + fall);
+
+	// a few passes get it out of a wall it was placed in. The sweeps stop
+	// short of what they hit, so only a warp, a wall or a landing can
+	// leave the character penetrating something
+	if (m_needsRecovery) {
+		for (int i = 0; i < 4 && RecoverFromPenetration(pWorld); ++i) {
+			++s_stats.recoveries;
+		}
+		m_needsRecovery = false;
+	}
+
+	btVector3 start = GetPosition();
+	btScalar fraction;
+	btVector3 normal;
+
+	// walk at the current height first, most ticks nothing is in the way
+	btVector3 position = start;
+	btScalar stepUp = 0.0f;
+	m_hitWall = Walk(pWorld, position, m_walkVelocity * dt);
+
+	// blocked: try again from a step higher (as far as the ceiling allows),
+	// and keep it if it gets farther, it was a ledge rather than a wall
+	if (m_hitWall && m_onGround && m_stepHeight > 0.0f) {
+		btScalar raise = m_stepHeight;
+		if (Sweep(pWorld, start, start + up * raise, -1.0f, fraction, normal)) {
+			raise *= std::max(0.0f, fraction - 0.01f);
+		}
+		btVector3 raised = start + up * raise;
+		bool raisedHitWall = Walk(pWorld, raised, m_walkVelocity * dt);
+		btVector3 low = position - start, high = raised - start;
+		low.setY(0.0f);
+		high.setY(0.0f);
+		if (high.length2() > low.length2() + SIMD_EPSILON) {
+			position = raised;
+			stepUp = raise;
+			m_hitWall = raisedHitWall;
+		}
+	}
+	m_needsRecovery = m_hitWall;
+
+	// back down: the step, the fall of this tick, and when walking a step
+	// more to stay on the floor going down a ledge
+	btScalar snap = m_onGround ? m_stepHeight : 0.0f;
+	btScalar drop = stepUp + fall + snap;
+	if (drop > 0.0f && Sweep(pWorld, position, position - up * drop, m_maxSlopeCos, fraction, normal)) {
+		position -= up * drop * std::max(0.0f, fraction - 0.01f);
+		m_needsRecovery |= !m_onGround;
+		m_onGround = true;
+		m_verticalSpeed = 0.0f;
+	}
+	else {
+		position -= up * (stepUp + fall);
+		m_onGround = false;
+	}
+
+	m_pGhostObject->getWorldTransform().setOrigin(position);
+	if (m_pMotionState && position != m_previousPosition) {
+		m_pMotionState->setWorldTransform(m_pGhostObject->getWorldTransform());
+	}
+}
+
+bool CharacterController::Walk(btCollisionWorld* pWorld, btVector3& position, const btVector3& move) {
+	// what a wall stops goes along it instead
+	btVector3 target = position + move;
+	btScalar fraction;
+	btVector3 normal;
+	bool hit = false;
+	for (int i = 0; i < 3; ++i) {
+		btVector3 remaining = target - position;
+		if (remaining.length2() < SIMD_EPSILON) break;
+		if (!Sweep(pWorld, position, target, -1.0f, fraction, normal)) {
+			position = target;
+			break;
+		}
+		hit = true;
+		position += remaining * std::max(0.0f, fraction - 0.01f);
+
+		// the slope of the hit doesn't lift the character, only its horizontal part counts
+		normal.setY(0.0f);
+		if (normal.length2() < SIMD_EPSILON) break;
+		normal.normalize();
+		remaining = target - position;
+		target = position + remaining - normal * remaining.dot(normal);
+		++s_stats.slides;
+	}
+	return hit;
+}
+
+bool CharacterController::RecoverFromPenetration(btCollisionWorld* pWorld) {
+	// contacts with the overlapping objects, computed for this ghost only.
+	// The ghost is inactive for the world, so it needs to look active here
+	m_pGhostObject->forceActivationState(ACTIVE_TAG);
+	pWorld->getDispatcher()->dispatchAllCollisionPairs(m_pGhostObject->getOverlappingPairCache(), pWorld->getDispatchInfo(), pWorld->getDispatcher());
+	m_pGhostObject->forceActivationState(DISABLE_SIMULATION);
+
+	btVector3 position = GetPosition();
+	bool penetration = false;
+	btBroadphasePairArray& pairs = m_pGhostObject->getOverlappingPairCache()->getOverlappingPairArray();
+	for (int i = 0; i < pairs.size(); ++i) {
+		if (!pairs[i].m_algorithm) continue;
+		m_manifolds.resize(0);
+		pairs[i].m_algorithm->getAllContactManifolds(m_manifolds);
+		for (int m = 0; m < m_manifolds.size(); ++m) {
+			btPersistentManifold* pManifold = m_manifolds[m];
+			btScalar direction = pManifold->getBody0() == m_pGhostObject ? -1.0f : 1.0f;
+			for (int c = 0; c < pManifold->getNumContacts(); ++c) {
+				const btManifoldPoint& point = pManifold->getContactPoint(c);
+				if (point.getDistance() < -0.05f) {
+					// part of the way out each pass, the contacts overlap
+					position += point.m_normalWorldOnB * direction * point.getDistance() * 0.2f;
+					penetration = true;
+				}
+			}
+		}
+	}
+	if (penetration) {
+		m_pGhostObject->getWorldTransform().setOrigin(position);
+	}
+	return penetration;
+}
+
+bool CharacterController::Sweep(btCollisionWorld* pWorld, const btVector3& from, const btVector3& to, btScalar minNormalUp, btScalar& fraction, btVector3& normal) {
+	ClosestNotMeConvexResultCallback callback(m_pGhostObject, minNormalUp);
+	callback.m_collisionFilterGroup = m_pGhostObject->getBroadphaseHandle()->m_collisionFilterGroup;
+	callback.m_collisionFilterMask = m_pGhostObject->getBroadphaseHandle()->m_collisionFilterMask;
+
+	// only against the pairs of the ghost, not the whole world
+	btTransform start(btQuaternion::getIdentity(), from), end(btQuaternion::getIdentity(), to);
+	m_pGhostObject->convexSweepTest(m_pShape, start, end, callback, pWorld->getDispatchInfo().m_allowedCcdPenetration);
+	++s_stats.sweeps;
+
+	if (!callback.hasHit()) return false;
+	fraction = callback.m_closestHitFraction;
+	normal = callback.m_hitNormalWorld;
+	return true;
+}
+
+void CharacterController::UpdateBroadphase(btCollisionWorld* pWorld, btScalar reach) {
+	btVector3 minAabb, maxAabb;
+	m_pShape->getAabb(m_pGhostObject->getWorldTransform(), minAabb, maxAabb);
+	btVector3 margin(reach, reach, reach);
+	pWorld->getBroadphase()->setAabb(m_pGhostObject->getBroadphaseHandle(), minAabb - margin, maxAabb + margin, pWorld->getDispatcher());
+}
@@ -0,0 +1,100 @@
+#ifndef BULLETOPENGL_CHARACTERCONTROLLER_H
+#define BULLETOPENGL_CHARACTERCONTROLLER_H
+
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <Bullet/BulletCollision/CollisionDispatch/btGhostObject.h>
+
+// per tick counters of the character controllers, summed by the caller
+struct CharacterStats {
+	int sweeps;
+	int recoveries; // penetration recovery passes that moved the character
+	int slides;     // wall hits turned into a slide along the wall
+
+	CharacterStats() : sweeps(0), recoveries(0), slides(0) {}
+};
+
+// A kinematic character: the agent is never pushed by the solver, it
+// moves where it is told and the maze stops it. Built on a
+// btPairCachingGhostObject, so the convex sweeps only test the objects
+// already overlapping its (enlarged) bounds instead of the whole world.
+//
+// Each tick, as a btActionInterface run by the world after collision
+// detection:
+//  - push the shape out of anything it penetrates (after warps and hits),
+//  - sweep along the walk velocity, sliding along the walls it hits,
+//  - when blocked, try again a step height higher, so small ledges are climbed,
+//  - sweep down to land on the floor again, or fall under gravity.
+//
+// Characters don't collide with each other (CharacterFilter isn't in
+// their mask), which keeps thousands of them in one world cheap.
+class CharacterController : public btActionInterface {
+public:
+	// the shape is not owned, many characters can share it
+	CharacterController(btConvexShape* pShape, btScalar stepHeight, const btVector3& position);
+	virtual ~CharacterController();
+
+	void AddToWorld(btCollisionWorld* pWorld);
+	void RemoveFromWorld(btCollisionWorld* pWorld);
+
+	// horizontal velocity in units per second, kept until changed
+	void SetWalkVelocity(const btVector3& velocity) { m_walkVelocity = velocity; }
+	const btVector3& GetWalkVelocity() const { return m_walkVelocity; }
+
+	void Warp(const btVector3& position);
+	// a motion state that follows the character, for a body drawing it. Set
+	// at the end of the ticks that moved it, so it sleeps when the character
+	// rests. Not owned
+	void SetMotionState(btMotionState* pMotionState) { m_pMotionState = pMotionState; }
+	const btVector3& GetPosition() const { return m_pGhostObject->getWorldTransform().getOrigin(); }
+	// the position before the last tick, for interpolation
+	const btVector3& GetPreviousPosition() const { return m_previousPosition; }
+
+	// fall acceleration, and the steepest floor it can stand on
+	void SetGravity(btScalar gravity) { m_gravity = gravity; }
+	void SetMaxSlope(btScalar radians) { m_maxSlopeCos = btCos(radians); }
+
+	bool IsOnGround() const { return m_onGround; }
+	// standing still on the floor with no walk velocity: the next ticks
+	// leave it where it is
+	bool IsResting() const { return m_onGround && m_walkVelocity.isZero() && m_previousPosition == GetPosition(); }
+	// whether the last tick ran into a wall
+	bool HitWall() const { return m_hitWall; }
+
+	btPairCachingGhostObject* GetGhostObject() const { return m_pGhostObject; }
+
+	// one tick of movement, also called by the world as an action
+	void Move(btCollisionWorld* pWorld, btScalar dt);
+	virtual void updateAction(btCollisionWorld* pWorld, btScalar deltaTimeStep) { Move(pWorld, deltaTimeStep); }
+	virtual void debugDraw(btIDebugDraw* /*pDebugDrawer*/) {}
+
+	// counters of every character since the last reset
+	static const CharacterStats& GetStats() { return s_stats; }
+	static void ResetStats() { s_stats = CharacterStats(); }
+
+private:
+	bool RecoverFromPenetration(btCollisionWorld* pWorld);
+	// moves 'position' by 'move', sliding along what it hits. True when something was hit
+	bool Walk(btCollisionWorld* pWorld, btVector3& position, const btVector3& move);
+	// closest hit between two positions, false when the way is free
+	bool Sweep(btCollisionWorld* pWorld, const btVector3& from, const btVector3& to, btScalar minNormalUp, btScalar& fraction, btVector3& normal);
+	void UpdateBroadphase(btCollisionWorld* pWorld, btScalar reach);
+
+	btPairCachingGhostObject* m_pGhostObject;
+	btConvexShape* m_pShape;
+	btMotionState* m_pMotionState;
+	btScalar m_stepHeight;
+	btScalar m_gravity;
+	btScalar m_maxSlopeCos;
+	btScalar m_maxFallSpeed;
+	btVector3 m_walkVelocity;
+	btVector3 m_previousPosition;
+	btScalar m_verticalSpeed;
+	bool m_onGround;
+	bool m_hitWall;
+	bool m_needsRecovery;
+	btManifoldArray m_manifolds;
+
+	static CharacterStats s_stats;
+};
+
+#endif //BULLETOPENGL_CHARACTERCONTROLLER_H
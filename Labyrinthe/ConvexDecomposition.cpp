@@ -0,0 +1,347 @@
+#include "ConvexDecomposition.h"
+#include "ObjLoader.h"
+
+#include <Bullet/VHACD/public/VHACD.h>
+#include <Bullet/LinearMath/btConvexHullComputer.h>
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+static const char HULLS_MAGIC[4] = { 'H', 'U', 'L', '1' };
+
+ConvexDecompositionConfig ConvexDecompositionConfig::FromArgs(int argc, char* argv[]) {
+	ConvexDecompositionConfig config;
+	for (int i = 1; i + 1 < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--hulls-max") {
+			config.maxHulls = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--hulls-vertices") {
+			// VHACD wants at least a tetrahedron
+			config.maxVerticesPerHull = std::max(4, std::atoi(argv[++i]));
+		}
+		else if (arg == "--hulls-resolution") {
+			config.resolution = (unsigned int)std::max(10000, std::atoi(argv[++i]));
+		}
+		else if (arg == "--hulls-concavity") {
+			config.concavity = std::max(0.0, std::atof(argv[++i]));
+		}
+		else if (arg == "--hulls-depth") {
+			config.depth = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--hulls-threads") {
+			config.threads = std::max(0, std::atoi(argv[++i]));
+		}
+	}
+	return config;
+}
+
+bool ConvexDecompositionConfig::operator==(const ConvexDecompositionConfig& other) const {
+	// the thread count doesn't change the hulls
+	return maxHulls == other.maxHulls && maxVerticesPerHull == other.maxVerticesPerHull && resolution == other.resolution
+		&& concavity == other.concavity && depth == other.depth;
+}
+
+bool ConvexDecomposition::LoadMesh(const std::string& objPath) {
+	// the buffer has 8 floats per face corner, the indices are the positions of the corners
+	std::pair<std::vector<uint32_t>, std::vector<float>> model = ObjLoader::loadModel(objPath, true);
+	const std::vector<uint32_t>& indices = model.first;
+	const std::vector<float>& buffer = model.second;
+	if (indices.empty() || buffer.size() < indices.size() * 8) {
+		std::cerr << "Error: no triangles in " << objPath << std::endl;
+		return false;
+	}
+
+	uint32_t positionCount = *std::max_element(indices.begin(), indices.end()) + 1;
+	m_positions.assign(positionCount * 3, 0.0f);
+	m_triangles.resize(indices.size() - indices.size() % 3);
+	for (size_t i = 0; i < m_triangles.size(); ++i) {
+		uint32_t position = indices[i];
+		m_positions[position * 3 + 0] = buffer[i * 8 + 0];
+		m_positions[position * 3 + 1] = buffer[i * 8 + 1];
+		m_positions[position * 3 + 2] = buffer[i * 8 + 2];
+		m_triangles[i] = (int)position;
+	}
+	return true;
+}
+
+bool ConvexDecomposition::Bake(const ConvexDecompositionConfig& config) {
+	m_hulls.clear();
+	m_config = config;
+	if (m_triangles.empty()) return false;
+
+	VHACD::IVHACD::Parameters parameters;
+	parameters.m_resolution = config.resolution;
+	parameters.m_concavity = config.concavity;
+	parameters.m_depth = config.depth;
+	parameters.m_maxNumVerticesPerCH = std::max(4, config.maxVerticesPerHull);
+	parameters.m_oclAcceleration = 0;
+
+	VHACD::IVHACD* pVhacd = VHACD::CreateVHACD();
+	bool computed = pVhacd->Compute(&m_positions[0], 3, (unsigned int)m_positions.size() / 3,
+		&m_triangles[0], 3, (unsigned int)m_triangles.size() / 3, parameters);
+	if (computed) {
+		m_hulls.resize(pVhacd->GetNConvexHulls());
+		for (unsigned int i = 0; i < pVhacd->GetNConvexHulls(); ++i) {
+			VHACD::IVHACD::ConvexHull convexHull;
+			pVhacd->GetConvexHull(i, convexHull);
+			m_hulls[i].assign(convexHull.m_points, convexHull.m_points + convexHull.m_nPoints * 3);
+		}
+	}
+	pVhacd->Clean();
+	pVhacd->Release();
+
+	// VHACD doesn't cap its hull count
+	MergeHulls(config.maxHulls);
+	return !m_hulls.empty();
+}
+
+int ConvexDecomposition::BakeAll(const std::vector<ConvexDecomposition*>& decompositions, const ConvexDecompositionConfig& config) {
+	// each VHACD run is independent, the meshes go to the threads as they free up
+	std::atomic<int> next(0), failures(0);
+	unsigned int threadCount = config.threads > 0 ? (unsigned int)config.threads : std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, (unsigned int)decompositions.size());
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < threadCount; ++t) {
+		threads.push_back(std::thread([&]() {
+			for (int i = next++; i < (int)decompositions.size(); i = next++) {
+				if (!decompositions[i]->Bake(config)) {
+					++failures;
+				}
+			}
+		}));
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	return failures;
+}
+
+void ConvexDecomposition::MergeHulls(int maxHulls) {
+	// the pair whose bounds grow the least when joined goes first
+	std::vector<btVector3> mins(m_hulls.size()), maxs(m_hulls.size());
+	for (size_t i = 0; i < m_hulls.size(); ++i) {
+		mins[i] = btVector3(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+		maxs[i] = -mins[i];
+		for (size_t v = 0; v < m_hulls[i].size(); v += 3) {
+			btVector3 point(m_hulls[i][v], m_hulls[i][v + 1], m_hulls[i][v + 2]);
+			mins[i].setMin(point);
+			maxs[i].setMax(point);
+		}
+	}
+	while ((int)m_hulls.size() > std::max(1, maxHulls)) {
+		int bestA = 0, bestB = 1;
+		btScalar bestGrowth = BT_LARGE_FLOAT;
+		for (size_t a = 0; a < m_hulls.size(); ++a) {
+			btVector3 sizeA = maxs[a] - mins[a];
+			for (size_t b = a + 1; b < m_hulls.size(); ++b) {
+				btVector3 joinedMin = mins[a], joinedMax = maxs[a];
+				joinedMin.setMin(mins[b]);
+				joinedMax.setMax(maxs[b]);
+				btVector3 joined = joinedMax - joinedMin, sizeB = maxs[b] - mins[b];
+				btScalar growth = joined.x() * joined.y() * joined.z() - sizeA.x() * sizeA.y() * sizeA.z() - sizeB.x() * sizeB.y() * sizeB.z();
+				if (growth < bestGrowth) {
+					bestGrowth = growth;
+					bestA = (int)a;
+					bestB = (int)b;
+				}
+			}
+		}
+		m_hulls[bestA].insert(m_hulls[bestA].end(), m_hulls[bestB].begin(), m_hulls[bestB].end());
+		mins[bestA].setMin(mins[bestB]);
+		maxs[bestA].setMax(maxs[bestB]);
+		TrimHull(m_hulls[bestA], m_config.maxVerticesPerHull);
+		m_hulls.erase(m_hulls.begin() + bestB);
+		mins.erase(mins.begin() + bestB);
+		maxs.erase(maxs.begin() + bestB);
+	}
+}
+
+void ConvexDecomposition::TrimHull(Hull& hull, int maxVertices) {
+	btConvexHullComputer computer;
+	computer.compute(&hull[0], 3 * sizeof(float), (int)hull.size() / 3, 0.0f, 0.0f);
+	int count = computer.vertices.size();
+	if (count == 0) return;
+
+	// farthest point sampling: each vertex kept is the one farthest from
+	// those already kept. The trimmed hull stays inside the full one
+	std::vector<int> kept;
+	std::vector<btScalar> distances(count, BT_LARGE_FLOAT);
+	btVector3 center(0.0f, 0.0f, 0.0f);
+	for (int i = 0; i < count; ++i) {
+		center += computer.vertices[i];
+	}
+	center /= (btScalar)count;
+	int next = 0;
+	for (int i = 1; i < count; ++i) {
+		if (computer.vertices[i].distance2(center) > computer.vertices[next].distance2(center)) next = i;
+	}
+	while ((int)kept.size() < std::min(count, std::max(4, maxVertices))) {
+		kept.push_back(next);
+		int farthest = -1;
+		for (int i = 0; i < count; ++i) {
+			distances[i] = std::min(distances[i], computer.vertices[i].distance2(computer.vertices[next]));
+			if (distances[i] > 0.0f && (farthest < 0 || distances[i] > distances[farthest])) farthest = i;
+		}
+		if (farthest < 0) break;
+		next = farthest;
+	}
+
+	hull.clear();
+	for (size_t i = 0; i < kept.size(); ++i) {
+		const btVector3& vertex = computer.vertices[kept[i]];
+		hull.push_back(vertex.x());
+		hull.push_back(vertex.y());
+		hull.push_back(vertex.z());
+	}
+}
+
+double ConvexDecomposition::HullVolume(const Hull& hull) {
+	if (hull.size() < 12) return 0.0;
+	btConvexHullComputer computer;
+	computer.compute(&hull[0], 3 * sizeof(float), (int)hull.size() / 3, 0.0f, 0.0f);
+	// a fan of tetrahedra from the first vertex over every face
+	const btVector3& origin = computer.vertices[0];
+	double volume = 0.0;
+	for (int f = 0; f < computer.faces.size(); ++f) {
+		const btConvexHullComputer::Edge* pFirst = &computer.edges[computer.faces[f]];
+		const btVector3& a = computer.vertices[pFirst->getSourceVertex()];
+		for (const btConvexHullComputer::Edge* pEdge = pFirst->getNextEdgeOfFace(); pEdge != pFirst; pEdge = pEdge->getNextEdgeOfFace()) {
+			const btVector3& b = computer.vertices[pEdge->getSourceVertex()];
+			const btVector3& c = computer.vertices[pEdge->getTargetVertex()];
+			volume += (a - origin).dot((b - origin).cross(c - origin)) / 6.0;
+		}
+	}
+	return std::fabs(volume);
+}
+
+int ConvexDecomposition::GetVertexCount() const {
+	int count = 0;
+	for (size_t i = 0; i < m_hulls.size(); ++i) {
+		count += (int)m_hulls[i].size() / 3;
+	}
+	return count;
+}
+
+double ConvexDecomposition::GetHullVolume() const {
+	double volume = 0.0;
+	for (size_t i = 0; i < m_hulls.size(); ++i) {
+		volume += HullVolume(m_hulls[i]);
+	}
+	return volume;
+}
+
+double ConvexDecomposition::GetMeshVolume() const {
+	// divergence theorem, only meaningful for a closed mesh
+	double volume = 0.0;
+	for (size_t i = 0; i + 2 < m_triangles.size(); i += 3) {
+		const float* a = &m_positions[m_triangles[i] * 3];
+		const float* b = &m_positions[m_triangles[i + 1] * 3];
+		const float* c = &m_positions[m_triangles[i + 2] * 3];
+		volume += (a[0] * (b[1] * c[2] - b[2] * c[1]) - a[1] * (b[0] * c[2] - b[2] * c[0]) + a[2] * (b[0] * c[1] - b[1] * c[0])) / 6.0;
+	}
+	return std::fabs(volume);
+}
+
+btCompoundShape* ConvexDecomposition::CreateShape() const {
+	if (m_hulls.empty()) return nullptr;
+	btCompoundShape* pCompound = new btCompoundShape(true, (int)m_hulls.size());
+	for (size_t i = 0; i < m_hulls.size(); ++i) {
+		const Hull& hull = m_hulls[i];
+		btConvexHullShape* pHull = new btConvexHullShape();
+		for (size_t v = 0; v < hull.size(); v += 3) {
+			pHull->addPoint(btVector3(hull[v], hull[v + 1], hull[v + 2]), false);
+		}
+		pHull->recalcLocalAabb();
+		// faster support queries while the body is awake
+		pHull->optimizeConvexHull();
+		pCompound->addChildShape(btTransform::getIdentity(), pHull);
+	}
+	return pCompound;
+}
+
+std::string ConvexDecomposition::GetCachePath(const std::string& objPath) {
+	size_t dot = objPath.find_last_of('.');
+	size_t slash = objPath.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+		return objPath + ".hulls";
+	}
+	return objPath.substr(0, dot) + ".hulls";
+}
+
+bool ConvexDecomposition::Save(const std::string& path) const {
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Error: could not write " << path << std::endl;
+		return false;
+	}
+
+	int hullCount = (int)m_hulls.size();
+	file.write(HULLS_MAGIC, sizeof(HULLS_MAGIC));
+	file.write((const char*)&m_config.maxHulls, sizeof(m_config.maxHulls));
+	file.write((const char*)&m_config.maxVerticesPerHull, sizeof(m_config.maxVerticesPerHull));
+	file.write((const char*)&m_config.resolution, sizeof(m_config.resolution));
+	file.write((const char*)&m_config.concavity, sizeof(m_config.concavity));
+	file.write((const char*)&m_config.depth, sizeof(m_config.depth));
+	file.write((const char*)&hullCount, sizeof(hullCount));
+	for (int i = 0; i < hullCount; ++i) {
+		int floatCount = (int)m_hulls[i].size();
+		file.write((const char*)&floatCount, sizeof(floatCount));
+		file.write((const char*)&m_hulls[i][0], floatCount * sizeof(float));
+	}
+	return file.good();
+}
+
+bool ConvexDecomposition::Load(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	char magic[4];
+	int hullCount = 0;
+	file.read(magic, sizeof(magic));
+	file.read((char*)&m_config.maxHulls, sizeof(m_config.maxHulls));
+	file.read((char*)&m_config.maxVerticesPerHull, sizeof(m_config.maxVerticesPerHull));
+	file.read((char*)&m_config.resolution, sizeof(m_config.resolution));
+	file.read((char*)&m_config.concavity, sizeof(m_config.concavity));
+	file.read((char*)&m_config.depth, sizeof(m_config.depth));
+	file.read((char*)&hullCount, sizeof(hullCount));
+	if (!file || !std::equal(magic, magic + 4, HULLS_MAGIC) || hullCount <= 0) {
+		std::cerr << "Error: " << path << " is not a valid hulls file" << std::endl;
+		return false;
+	}
+
+	// the counts are checked against what is left of the file before
+	// anything is allocated, a corrupt count would ask for gigabytes
+	std::streamoff position = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff remaining = file.tellg() - position;
+	file.seekg(position);
+	const std::streamoff minHullBytes = sizeof(int) + 3 * sizeof(float);
+	bool valid = remaining >= 0 && hullCount <= remaining / minHullBytes;
+
+	if (valid) m_hulls.resize(hullCount);
+	for (int i = 0; i < hullCount && valid; ++i) {
+		int floatCount = 0;
+		file.read((char*)&floatCount, sizeof(floatCount));
+		remaining -= sizeof(floatCount);
+		valid = file && floatCount >= 3 && floatCount % 3 == 0 && floatCount <= remaining / (std::streamoff)sizeof(float);
+		if (!valid) break;
+		m_hulls[i].resize(floatCount);
+		file.read((char*)&m_hulls[i][0], floatCount * sizeof(float));
+		remaining -= floatCount * sizeof(float);
+		valid = (bool)file;
+	}
+	if (!valid) {
+		std::cerr << "Error: " << path << " is truncated" << std::endl;
+		m_hulls.clear();
+		return false;
+	}
+	return true;
+}
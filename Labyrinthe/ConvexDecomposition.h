@@ -0,0 +1,76 @@
+#ifndef BULLETOPENGL_CONVEXDECOMPOSITION_H
+#define BULLETOPENGL_CONVEXDECOMPOSITION_H
+
+#include <vector>
+#include <string>
+
+#include <Bullet/btBulletCollisionCommon.h>
+
+// limits of a decomposition: more hulls and vertices follow the mesh closer,
+// and cost more in every contact test of the body
+struct ConvexDecompositionConfig {
+	int maxHulls;              // past this the closest hulls are merged
+	int maxVerticesPerHull;
+	unsigned int resolution;   // voxels VHACD fills the mesh with
+	double concavity;          // how concave a part may stay, lower splits more
+	int depth;                 // most clipping steps of VHACD
+	int threads;               // meshes decomposed at once, 0 = one per hardware thread
+
+	ConvexDecompositionConfig() : maxHulls(16), maxVerticesPerHull(32), resolution(100000), concavity(0.0025), depth(20), threads(0) {}
+
+	// --hulls-max <n>, --hulls-vertices <n>, --hulls-resolution <voxels>,
+	// --hulls-concavity <x>, --hulls-depth <n> and --hulls-threads <n>
+	static ConvexDecompositionConfig FromArgs(int argc, char* argv[]);
+	bool operator==(const ConvexDecompositionConfig& other) const;
+};
+
+// A dynamic mesh as a few convex hulls, for bodies a box fits badly. The
+// bundled VHACD splits the triangles of the model, then the hulls are
+// merged and trimmed down to the config's limits.
+//
+// Decomposing takes seconds, so the hulls are baked (see AssetBaker) to a
+// .hulls file next to the model, and the compound shape is built from it
+// at load time. VHACD splits its plane search over OpenMP threads when
+// compiled with it, and BakeAll runs several meshes at once.
+class ConvexDecomposition {
+public:
+	// the triangles of an OBJ model, in model space. Not thread safe (ObjLoader)
+	bool LoadMesh(const std::string& objPath);
+	// decomposes the loaded mesh, the mesh is kept for the stats
+	bool Bake(const ConvexDecompositionConfig& config);
+	// the decompositions on config.threads threads, returns how many failed
+	static int BakeAll(const std::vector<ConvexDecomposition*>& decompositions, const ConvexDecompositionConfig& config);
+
+	// read/write the hulls (.hulls file), with the config they were baked with
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+	// models/chibi.obj -> models/chibi.hulls
+	static std::string GetCachePath(const std::string& objPath);
+
+	// a btCompoundShape of btConvexHullShape, null without hulls. The
+	// compound owns its children: ObjectPools::DestroyShape frees them too
+	btCompoundShape* CreateShape() const;
+
+	int GetHullCount() const { return (int)m_hulls.size(); }
+	int GetVertexCount() const;
+	// sum of the hull volumes, and the volume enclosed by the source mesh
+	double GetHullVolume() const;
+	double GetMeshVolume() const;
+	const ConvexDecompositionConfig& GetConfig() const { return m_config; }
+
+private:
+	// xyz triples
+	typedef std::vector<float> Hull;
+
+	void MergeHulls(int maxHulls);
+	// the hull's own vertices, at most maxVertices of them spread over it
+	static void TrimHull(Hull& hull, int maxVertices);
+	static double HullVolume(const Hull& hull);
+
+	std::vector<float> m_positions;
+	std::vector<int> m_triangles;
+	std::vector<Hull> m_hulls;
+	ConvexDecompositionConfig m_config;
+};
+
+#endif //BULLETOPENGL_CONVEXDECOMPOSITION_H
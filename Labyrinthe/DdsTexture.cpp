@@ -0,0 +1,197 @@
+#include "DdsTexture.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <SOIL2/image_helper.h>
+extern "C" {
+#include <SOIL2/image_DXT.h>
+}
+
+#define FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+/*
+    Builds the mip chain by halving the previous level (box filter) and
+    compresses every level, BC3 only when a pixel isn't fully opaque
+*/
+bool DdsTexture::compress(const unsigned char* pixels, int width, int height, int channels, DdsImage& image) {
+    if (!pixels || width < 1 || height < 1 || (channels != 3 && channels != 4)) {
+        return false;
+    }
+
+    bool hasAlpha = false;
+    if (channels == 4) {
+        for (size_t i = 3; i < (size_t)width * height * 4; i += 4) {
+            if (pixels[i] != 255) {
+                hasAlpha = true;
+                break;
+            }
+        }
+    }
+    image.format = hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    image.levels.clear();
+    image.data.clear();
+
+    std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * channels);
+    std::vector<unsigned char> next;
+    for (;;) {
+        int size = 0;
+        unsigned char* pCompressed = hasAlpha
+            ? convert_image_to_DXT5(&level[0], width, height, channels, &size)
+            : convert_image_to_DXT1(&level[0], width, height, channels, &size);
+        if (!pCompressed) {
+            return false;
+        }
+
+        DdsLevel info;
+        info.width = width;
+        info.height = height;
+        info.offset = image.data.size();
+        info.size = size;
+        image.levels.push_back(info);
+        image.data.insert(image.data.end(), pCompressed, pCompressed + size);
+        free(pCompressed);
+
+        if (width == 1 && height == 1) break;
+
+        int nextWidth = width > 1 ? width / 2 : 1;
+        int nextHeight = height > 1 ? height / 2 : 1;
+        next.resize((size_t)nextWidth * nextHeight * channels);
+        mipmap_image(&level[0], width, height, channels, &next[0], width > 1 ? 2 : 1, height > 1 ? 2 : 1);
+        level.swap(next);
+        width = nextWidth;
+        height = nextHeight;
+    }
+    return true;
+}
+
+bool DdsTexture::save(const std::string& path, const DdsImage& image) {
+    if (image.levels.empty()) return false;
+
+    DDS_header header;
+    std::memset(&header, 0, sizeof(header));
+    header.dwMagic = FOURCC('D', 'D', 'S', ' ');
+    header.dwSize = 124;
+    header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE | DDSD_MIPMAPCOUNT;
+    header.dwWidth = image.getWidth();
+    header.dwHeight = image.getHeight();
+    header.dwPitchOrLinearSize = (uint32_t)image.levels[0].size;
+    header.dwMipMapCount = (uint32_t)image.levels.size();
+    header.sPixelFormat.dwSize = 32;
+    header.sPixelFormat.dwFlags = DDPF_FOURCC;
+    header.sPixelFormat.dwFourCC = image.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? FOURCC('D', 'X', 'T', '5') : FOURCC('D', 'X', 'T', '1');
+    header.sCaps.dwCaps1 = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file) {
+        std::cerr << "Can't write " << path << std::endl;
+        return false;
+    }
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)&image.data[0], image.data.size());
+    return (bool)file;
+}
+
+/*
+    Reads a DXT1/DXT5 DDS file, the levels are not decoded
+*/
+bool DdsTexture::load(const std::string& path, DdsImage& image) {
+    if (!loadHeader(path, image)) {
+        return false;
+    }
+
+    size_t total = image.levels.back().offset + image.levels.back().size;
+    std::ifstream file(path.c_str(), std::ios::binary);
+    file.seekg(sizeof(DDS_header));
+    image.data.resize(total);
+    file.read((char*)&image.data[0], total);
+    if (!file) {
+        std::cerr << "Truncated DDS file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool DdsTexture::loadHeader(const std::string& path, DdsImage& image) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file) return false;
+
+    DDS_header header;
+    file.read((char*)&header, sizeof(header));
+    if (!file || header.dwMagic != FOURCC('D', 'D', 'S', ' ') || header.dwSize != 124 || !(header.sPixelFormat.dwFlags & DDPF_FOURCC)) {
+        std::cerr << "Not a compressed DDS file: " << path << std::endl;
+        return false;
+    }
+
+    size_t blockSize;
+    if (header.sPixelFormat.dwFourCC == FOURCC('D', 'X', 'T', '1')) {
+        image.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        blockSize = 8;
+    }
+    else if (header.sPixelFormat.dwFourCC == FOURCC('D', 'X', 'T', '5')) {
+        image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        blockSize = 16;
+    }
+    else {
+        std::cerr << "Unsupported DDS format in " << path << std::endl;
+        return false;
+    }
+
+    int levelCount = (header.dwFlags & DDSD_MIPMAPCOUNT) && header.dwMipMapCount > 0 ? (int)header.dwMipMapCount : 1;
+    int width = (int)header.dwWidth, height = (int)header.dwHeight;
+    image.levels.resize(levelCount);
+    image.data.clear();
+    size_t total = 0;
+    for (int i = 0; i < levelCount; ++i) {
+        DdsLevel& level = image.levels[i];
+        level.width = width;
+        level.height = height;
+        level.offset = total;
+        level.size = ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+        total += level.size;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return true;
+}
+
+bool DdsTexture::readLevel(const std::string& path, const DdsLevel& level, std::vector<unsigned char>& data) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file) return false;
+
+    file.seekg(sizeof(DDS_header) + level.offset);
+    data.resize(level.size);
+    file.read((char*)&data[0], level.size);
+    return (bool)file;
+}
+
+GLuint DdsTexture::upload(GLuint texture, const DdsImage& image) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+
+    for (size_t i = 0; i < image.levels.size(); ++i) {
+        const DdsLevel& level = image.levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, image.format, level.width, level.height, 0, (GLsizei)level.size, &image.data[level.offset]);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+bool DdsTexture::isSupported() {
+    return GLEW_EXT_texture_compression_s3tc != 0;
+}
+
+std::string DdsTexture::getCompressedPath(const std::string& sourcePath) {
+    size_t dot = sourcePath.find_last_of('.');
+    size_t slash = sourcePath.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return sourcePath + ".dds";
+    }
+    return sourcePath.substr(0, dot) + ".dds";
+}
@@ -0,0 +1,56 @@
+/*
+    Block compressed textures with a baked mip chain, stored as DDS files.
+
+    The baker (--bake textures) decodes a source image once, builds every mip
+    level on the CPU and compresses them with SOIL2's DXT encoder: BC1 (DXT1)
+    for opaque images and BC3 (DXT5) when the alpha channel is used. At runtime
+    the file is read as is and every level goes straight to
+    glCompressedTexImage2D, with no image decode and no glGenerateMipmap.
+*/
+
+#ifndef DDSTEXTURE_H_INCLUDED
+#define DDSTEXTURE_H_INCLUDED
+
+#include <vector>
+#include <string>
+#include <GL/glew.h>
+
+struct DdsLevel {
+    int width, height;
+    size_t offset; // in DdsImage::data
+    size_t size;
+};
+
+struct DdsImage {
+    GLenum format; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT or GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    std::vector<DdsLevel> levels;
+    std::vector<unsigned char> data;
+
+    int getWidth() const { return levels.empty() ? 0 : levels[0].width; }
+    int getHeight() const { return levels.empty() ? 0 : levels[0].height; }
+};
+
+class DdsTexture {
+public:
+    // compress 8 bit pixels (3 or 4 channels) with a full mip chain
+    static bool compress(const unsigned char* pixels, int width, int height, int channels, DdsImage& image);
+
+    static bool save(const std::string& path, const DdsImage& image);
+    static bool load(const std::string& path, DdsImage& image);
+
+    // the format and level sizes only, the level offsets are relative to the
+    // end of the header so single levels can be read with readLevel
+    static bool loadHeader(const std::string& path, DdsImage& image);
+    static bool readLevel(const std::string& path, const DdsLevel& level, std::vector<unsigned char>& data);
+
+    // upload every level of the image, on the thread that owns the GL context
+    static GLuint upload(GLuint texture, const DdsImage& image);
+
+    // whether the driver can sample the formats written by compress()
+    static bool isSupported();
+
+    // "textures/ground.jpg" -> "textures/ground.dds"
+    static std::string getCompressedPath(const std::string& sourcePath);
+};
+
+#endif // DDSTEXTURE_H_INCLUDED
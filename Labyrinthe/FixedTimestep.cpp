@@ -0,0 +1,52 @@
+#include "FixedTimestep.h"
+
+#include <algorithm>
+
+FixedTimestep::FixedTimestep(float tickRate, int maxCatchUpSteps) :
+	m_stepSize(1.0 / 60.0),
+	m_accumulator(0.0),
+	m_maxCatchUpSteps(5)
+{
+	SetTickRate(tickRate);
+	SetMaxCatchUpSteps(maxCatchUpSteps);
+}
+
+void FixedTimestep::SetTickRate(float ticksPerSecond) {
+	m_stepSize = 1.0 / std::max(1.0f, ticksPerSecond);
+}
+
+void FixedTimestep::SetMaxCatchUpSteps(int steps) {
+	m_maxCatchUpSteps = std::max(1, steps);
+}
+
+int FixedTimestep::Advance(double frameSeconds) {
+	m_accumulator += std::max(0.0, frameSeconds);
+	int steps = (int)(m_accumulator / m_stepSize);
+	m_accumulator -= steps * m_stepSize;
+
+	// too far behind: run what the limit allows and let the rest go
+	if (steps > m_maxCatchUpSteps) {
+		m_stats.droppedSeconds += (steps - m_maxCatchUpSteps) * m_stepSize;
+		++m_stats.droppingFrames;
+		steps = m_maxCatchUpSteps;
+	}
+
+	++m_stats.frames;
+	m_stats.steps += steps;
+	m_stats.lastFrameSteps = steps;
+	m_stats.maxFrameSteps = std::max(m_stats.maxFrameSteps, steps);
+	++m_stats.stepHistogram[std::min(steps, 4)];
+	return steps;
+}
+
+float FixedTimestep::GetAlpha() const {
+	return (float)std::min(1.0, m_accumulator / m_stepSize);
+}
+
+void FixedTimestep::PrintStats(std::ostream& out, const FixedTimestepStats& stats, float tickRate) {
+	double average = stats.frames > 0 ? (double)stats.steps / stats.frames : 0.0;
+	out << "Physics: " << tickRate << " Hz, " << stats.frames << " frames, " << average << " steps/frame (max "
+		<< stats.maxFrameSteps << "), frames with 0/1/2/3/4+ steps: " << stats.stepHistogram[0] << "/" << stats.stepHistogram[1]
+		<< "/" << stats.stepHistogram[2] << "/" << stats.stepHistogram[3] << "/" << stats.stepHistogram[4]
+		<< ", dropped " << stats.droppedSeconds * 1000.0 << " ms in " << stats.droppingFrames << " frames" << std::endl;
+}
@@ -0,0 +1,63 @@
+#ifndef BULLETOPENGL_FIXEDTIMESTEP_H
+#define BULLETOPENGL_FIXEDTIMESTEP_H
+
+#include <iostream>
+
+// what the fixed step loop did since the last ResetStats()
+struct FixedTimestepStats {
+	unsigned long long frames;
+	unsigned long long steps;
+	int lastFrameSteps;
+	int maxFrameSteps;
+	// frames that ran 0, 1, 2, 3 and 4 or more steps
+	unsigned long long stepHistogram[5];
+	// real time thrown away by the catch-up limit, and the frames that did it
+	double droppedSeconds;
+	unsigned long long droppingFrames;
+
+	FixedTimestepStats() : frames(0), steps(0), lastFrameSteps(0), maxFrameSteps(0), droppedSeconds(0.0), droppingFrames(0) {
+		for (int i = 0; i < 5; ++i) stepHistogram[i] = 0;
+	}
+};
+
+// Splits real frame time into simulation ticks of a fixed size. Frame time
+// goes into an accumulator, whole ticks are taken out of it and what is left
+// tells how far the renderer is between the last two ticks (GetAlpha()).
+//
+// A slow frame is caught up with several ticks, but never more than the
+// catch-up limit: past it the simulation slows down instead of spiralling
+// (each tick making the next frame slower), and the time is counted as dropped.
+class FixedTimestep {
+public:
+	FixedTimestep(float tickRate = 60.0f, int maxCatchUpSteps = 5);
+
+	void SetTickRate(float ticksPerSecond);
+	float GetTickRate() const { return (float)(1.0 / m_stepSize); }
+	float GetStepSize() const { return (float)m_stepSize; }
+
+	void SetMaxCatchUpSteps(int steps);
+	int GetMaxCatchUpSteps() const { return m_maxCatchUpSteps; }
+
+	// adds the real time of a frame, returns the number of ticks to run now
+	int Advance(double frameSeconds);
+
+	// 0 on the previous tick, 1 on the last one
+	float GetAlpha() const;
+
+	// forgets the accumulated time, e.g. after loading
+	void Reset() { m_accumulator = 0.0; }
+
+	const FixedTimestepStats& GetStats() const { return m_stats; }
+	void ResetStats() { m_stats = FixedTimestepStats(); }
+	// one line summary: tick rate, steps per frame and dropped time
+	void PrintStats(std::ostream& out) const { PrintStats(out, m_stats, GetTickRate()); }
+	static void PrintStats(std::ostream& out, const FixedTimestepStats& stats, float tickRate);
+
+private:
+	double m_stepSize;
+	double m_accumulator;
+	int m_maxCatchUpSteps;
+	FixedTimestepStats m_stats;
+};
+
+#endif //BULLETOPENGL_FIXEDTIMESTEP_H
@@ -0,0 +1,152 @@
+#ifndef BULLETOPENGL_FRUSTUM_H
+#define BULLETOPENGL_FRUSTUM_H
+
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+// use SSE for the plane tests whenever the compiler targets it
+// (always the case for our x64 builds)
+#if defined(_M_X64) || defined(__SSE2__)
+#define FRUSTUM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+// an axis aligned bounding box
+struct AABB {
+	glm::vec3 min;
+	glm::vec3 max;
+
+	AABB() : min(FLT_MAX), max(-FLT_MAX) {}
+	AABB(const glm::vec3& minBounds, const glm::vec3& maxBounds) : min(minBounds), max(maxBounds) {}
+
+	bool IsValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+
+	glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+	glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+
+	void Extend(const glm::vec3& point) {
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void Extend(const AABB& other) {
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	// returns the box enclosing this box once transformed by 'transform'
+	AABB Transformed(const glm::mat4& transform) const {
+		// transform the center, then project the extents on
+		// each world axis using the absolute rotation part
+		glm::vec3 center = glm::vec3(transform * glm::vec4(GetCenter(), 1.0f));
+		glm::vec3 extents = GetExtents();
+		glm::vec3 newExtents;
+		for (int i = 0; i < 3; ++i) {
+			newExtents[i] = std::fabs(transform[0][i]) * extents.x
+				+ std::fabs(transform[1][i]) * extents.y
+				+ std::fabs(transform[2][i]) * extents.z;
+		}
+		return AABB(center - newExtents, center + newExtents);
+	}
+};
+
+// the six clipping planes of a view-projection matrix, stored as
+// structure-of-arrays so four planes can be tested at once
+class Frustum {
+public:
+	enum Result {
+		OUTSIDE = 0,
+		INTERSECTING,
+		INSIDE
+	};
+
+	Frustum() {
+		for (int i = 0; i < 8; ++i) {
+			m_nx[i] = m_ny[i] = m_nz[i] = 0.0f;
+			m_d[i] = FLT_MAX;
+		}
+	}
+
+	// extract the planes from a projection * view matrix
+	// (Gribb/Hartmann method, planes point inwards)
+	void Extract(const glm::mat4& viewProjection) {
+		glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		glm::vec4 planes[6] = {
+			row3 + row0, // left
+			row3 - row0, // right
+			row3 + row1, // bottom
+			row3 - row1, // top
+			row3 + row2, // near
+			row3 - row2  // far
+		};
+
+		for (int i = 0; i < 6; ++i) {
+			float length = glm::length(glm::vec3(planes[i]));
+			if (length > 0.0f) planes[i] /= length;
+			m_nx[i] = planes[i].x;
+			m_ny[i] = planes[i].y;
+			m_nz[i] = planes[i].z;
+			m_d[i] = planes[i].w;
+		}
+		// the two padding planes never reject anything
+		for (int i = 6; i < 8; ++i) {
+			m_nx[i] = m_ny[i] = m_nz[i] = 0.0f;
+			m_d[i] = FLT_MAX;
+		}
+	}
+
+	// classify a box against the frustum
+	Result TestAABB(const AABB& box) const {
+		glm::vec3 c = box.GetCenter();
+		glm::vec3 e = box.GetExtents();
+#ifdef FRUSTUM_USE_SSE
+		__m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+		__m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+		__m128 signMask = _mm_set1_ps(-0.0f);
+		int outside = 0, intersecting = 0;
+		for (int i = 0; i < 8; i += 4) {
+			__m128 nx = _mm_load_ps(m_nx + i);
+			__m128 ny = _mm_load_ps(m_ny + i);
+			__m128 nz = _mm_load_ps(m_nz + i);
+			// signed distance of the box center to each plane
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+				_mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(m_d + i)));
+			// projected radius of the box on each plane normal
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex),
+				_mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+				_mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+			outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+			intersecting |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(dist, radius), _mm_setzero_ps()));
+		}
+		if (outside) return OUTSIDE;
+		return intersecting ? INTERSECTING : INSIDE;
+#else
+		bool intersecting = false;
+		for (int i = 0; i < 6; ++i) {
+			float dist = m_nx[i] * c.x + m_ny[i] * c.y + m_nz[i] * c.z + m_d[i];
+			float radius = std::fabs(m_nx[i]) * e.x + std::fabs(m_ny[i]) * e.y + std::fabs(m_nz[i]) * e.z;
+			if (dist + radius < 0.0f) return OUTSIDE;
+			if (dist - radius < 0.0f) intersecting = true;
+		}
+		return intersecting ? INTERSECTING : INSIDE;
+#endif
+	}
+
+	bool IsVisible(const AABB& box) const { return TestAABB(box) != OUTSIDE; }
+
+private:
+	// 6 planes padded to 8 so the SSE path needs no remainder loop
+	alignas(16) float m_nx[8];
+	alignas(16) float m_ny[8];
+	alignas(16) float m_nz[8];
+	alignas(16) float m_d[8];
+};
+
+#endif //BULLETOPENGL_FRUSTUM_H
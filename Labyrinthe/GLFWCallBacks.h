@@ -40,6 +40,13 @@ static void MotionCallback(GLFWwindow* window, int x, int y) {
 static void DisplayCallback(void) {
     g_pApp->Display();
 }
+static void RefreshCallback(GLFWwindow* window) {
+    g_pApp->RequestRedraw();
+}
+
+// longest wait for events while the scene is at rest, the shader reload
+// and the texture uploads still get checked this often
+#define IDLE_WAIT_SECONDS 0.25
 
 // our custom-built 'main' function, which accepts a reference to a
 // BulletOpenGLApplication object.
@@ -87,6 +94,7 @@ int glfwmain(int width, int height, BulletOpenGLApplication* pApp) {
     glfwSetKeyCallback(window, KeyboardCallback);
     glfwSetCursorPosCallback(window, MouseCallback);
     glfwSetWindowSizeCallback(window, ReshapeCallback);
+    glfwSetWindowRefreshCallback(window, RefreshCallback);
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -111,6 +119,13 @@ int glfwmain(int width, int height, BulletOpenGLApplication* pApp) {
         // render here
         g_pApp->Idle(window);
 
+        // nothing moved, the last frame is still on screen: sleep until
+        // input arrives instead of spinning
+        if (g_pApp->IsAtRest()) {
+            glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+            continue;
+        }
+
         // swap front and back buffers
         glfwSwapBuffers(window);
 
@@ -1,7 +1,6 @@
 
 #include "GameObject.h"
-#include "ObjLoader.h" 
-#include "TextureLoader.h" 
+#include "ObjectPools.h"
 
 #include <GL/glew.h>
 
@@ -11,8 +10,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-GameObject::GameObject(const std::string& objFilePath, const char* texturePath, glm::mat4 pos, btCollisionShape* pShape, float mass, const btVector3& color, const btVector3& initialPosition, const btQuaternion& initialRotation)
-	: VAO(0), VBO(0), texture(0) {
+GameObject::GameObject(const std::string& objFilePath, const char* texturePath, glm::mat4 pos, btCollisionShape* pShape, float mass, const btVector3& color, const btVector3& initialPosition, const btQuaternion& initialRotation, ObjectPools* pPools)
+	: m_pPools(pPools), m_pMesh(nullptr), texture(0), m_pTexturePath(&m_texturePath), m_textureLayer(-1), m_pTransforms(nullptr), m_transformSlot(-1) {
 	// store the shape for later usage
 	m_pShape = pShape;
 
@@ -21,7 +20,15 @@ GameObject::GameObject(const std::string& objFilePath, const char* texturePath,
 
 	m_pos = pos;
 
-	LoadMesh(objFilePath, texturePath);
+	// shared with the other objects of the same model and texture
+	if (m_pPools) {
+		m_pTexturePath = &m_pPools->InternPath(texturePath ? texturePath : "");
+		m_pMesh = m_pPools->GetMeshes().Acquire(objFilePath);
+	}
+	else {
+		m_texturePath = texturePath ? texturePath : "";
+		m_pMesh = new SharedMesh(objFilePath);
+	}
 
 	// create the initial transform
 	btTransform transform;
@@ -31,7 +38,12 @@ GameObject::GameObject(const std::string& objFilePath, const char* texturePath,
 
 	// create the motion state from the
 	// initial transform
-	m_pMotionState = new OpenGLMotionState(transform);
+	m_pMotionState = m_pPools ? m_pPools->CreateMotionState(transform) : new OpenGLMotionState(transform);
+
+	// the model keeps its offset from the body when the body moves
+	btScalar bodyMatrix[16];
+	transform.getOpenGLMatrix(bodyMatrix);
+	m_bodyToModel = glm::inverse(glm::mat4(glm::make_mat4(bodyMatrix))) * m_pos;
 
 	// calculate the local inertia
 	btVector3 localInertia(0, 0, 0);
@@ -48,11 +60,11 @@ GameObject::GameObject(const std::string& objFilePath, const char* texturePath,
 	btRigidBody::btRigidBodyConstructionInfo cInfo(mass, m_pMotionState, pShape, localInertia);
 
 	// create the rigid body
-	m_pBody = new btRigidBody(cInfo);
+	m_pBody = m_pPools ? m_pPools->CreateBody(cInfo) : new btRigidBody(cInfo);
 }
 
-GameObject::GameObject(glm::mat4 pos, btCollisionShape* pShape, float mass, const btVector3& color, const btVector3& initialPosition, const btQuaternion& initialRotation)
-	: VAO(0), VBO(0), texture(0) {
+GameObject::GameObject(glm::mat4 pos, btCollisionShape* pShape, float mass, const btVector3& color, const btVector3& initialPosition, const btQuaternion& initialRotation, ObjectPools* pPools)
+	: m_pPools(pPools), m_pMesh(nullptr), texture(0), m_pTexturePath(&m_texturePath), m_textureLayer(-1), m_pTransforms(nullptr), m_transformSlot(-1) {
 	// store the shape for later usage
 	m_pShape = pShape;
 
@@ -69,7 +81,12 @@ GameObject::GameObject(glm::mat4 pos, btCollisionShape* pShape, float mass, cons
 
 	// create the motion state from the
 	// initial transform
-	m_pMotionState = new OpenGLMotionState(transform);
+	m_pMotionState = m_pPools ? m_pPools->CreateMotionState(transform) : new OpenGLMotionState(transform);
+
+	// the model keeps its offset from the body when the body moves
+	btScalar bodyMatrix[16];
+	transform.getOpenGLMatrix(bodyMatrix);
+	m_bodyToModel = glm::inverse(glm::mat4(glm::make_mat4(bodyMatrix))) * m_pos;
 
 	// calculate the local inertia
 	btVector3 localInertia(0, 0, 0);
@@ -86,48 +103,49 @@ GameObject::GameObject(glm::mat4 pos, btCollisionShape* pShape, float mass, cons
 	btRigidBody::btRigidBodyConstructionInfo cInfo(mass, m_pMotionState, pShape, localInertia);
 
 	// create the rigid body
-	m_pBody = new btRigidBody(cInfo);
+	m_pBody = m_pPools ? m_pPools->CreateBody(cInfo) : new btRigidBody(cInfo);
 }
 
-void GameObject::LoadMesh(const std::string& objFilePath, const char* texturePath) {
-	// Load OBJ model
-	std::pair<std::vector<uint32_t>, std::vector<float>> model = ObjLoader::loadModel(objFilePath, true);
-	indices = model.first;
-	vertexBuffer = model.second;
-
-	// Generate Vertex Array Object (VAO)
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
-
-	// Generate Vertex Buffer Object (VBO)
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, vertexBuffer.size() * sizeof(float), &vertexBuffer[0], GL_STATIC_DRAW);
-
-	// Specify the layout of the vertex data
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-	// maze textures
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	// maze normals
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-
-	glGenTextures(1, &texture);
-	TextureLoader::loadTexture(texturePath, texture);
+void GameObject::drawObject() {
+	if (!m_pMesh) return;
+	m_pMesh->Bind();
+	// objects in the texture array share the texture bound by the caller
+	if (m_textureLayer < 0) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+	}
+	glDrawArrays(GL_TRIANGLES, 0, m_pMesh->GetVertexCount());
 }
 
-void GameObject::drawObject(GLint& modelLoc) {
-	glBindVertexArray(VAO);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(m_pos));
-	glDrawArrays(GL_TRIANGLES, 0, indices.size());
+void GameObject::drawChunks(const int* chunks, int chunkCount) {
+	if (!m_pMesh) return;
+	const std::vector<MeshChunk>& meshChunks = m_pMesh->GetChunks();
+	m_pMesh->Bind();
+	// objects in the texture array share the texture bound by the caller
+	if (m_textureLayer < 0) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+	}
+	for (int i = 0; i < chunkCount; ++i) {
+		GLint first = meshChunks[chunks[i]].first;
+		GLsizei count = meshChunks[chunks[i]].count;
+		// merge chunks that follow each other in the buffer into one draw
+		while (i + 1 < chunkCount && meshChunks[chunks[i + 1]].first == first + count) {
+			count += meshChunks[chunks[++i]].count;
+		}
+		glDrawArrays(GL_TRIANGLES, first, count);
+	}
 }
 
 GameObject::~GameObject() {
+	// the last user of a mesh deletes its VAO and VBO
+	if (m_pPools) {
+		m_pPools->DestroyBody(m_pBody);
+		m_pPools->DestroyMotionState(m_pMotionState);
+		m_pPools->ReleaseShape(m_pShape);
+		m_pPools->GetMeshes().Release(m_pMesh);
+		return;
+	}
 	delete m_pBody;
 	delete m_pMotionState;
 	delete m_pShape;
+	delete m_pMesh;
 }
\ No newline at end of file
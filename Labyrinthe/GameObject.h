@@ -5,6 +5,9 @@
 
 #include <Bullet/btBulletDynamicsCommon.h>
 #include "OpenGLMotionState.h"
+#include "TransformSync.h"
+#include "MeshChunker.h"
+#include "MeshRegistry.h"
 #include <vector>
 
 #include <GL/glew.h>
@@ -18,11 +21,18 @@
 
 
 
+class ObjectPools;
+
 class GameObject {
 public:
-	GameObject(const std::string& objFilePath, const char* texturePath, glm::mat4 pos, btCollisionShape* pShape, float mass, const btVector3& color, const btVector3& initialPosition = btVector3(0, 0, 0), const btQuaternion& initialRotation = btQuaternion(0, 0, 1, 1));
+	// with pools, the body and motion state come from them, and the object
+	// holds one reference to the shape: a shape of the pools' registry is
+	// released with the object, any other is destroyed. The mesh is shared
+	// the same way through the pools' mesh registry, without pools the
+	// object loads its own
+	GameObject(const std::string& objFilePath, const char* texturePath, glm::mat4 pos, btCollisionShape* pShape, float mass, const btVector3& color, const btVector3& initialPosition = btVector3(0, 0, 0), const btQuaternion& initialRotation = btQuaternion(0, 0, 1, 1), ObjectPools* pPools = nullptr);
 
-	GameObject(glm::mat4 pos, btCollisionShape* pShape, float mass, const btVector3& color, const btVector3& initialPosition = btVector3(0, 0, 0), const btQuaternion& initialRotation = btQuaternion(0, 0, 1, 1));
+	GameObject(glm::mat4 pos, btCollisionShape* pShape, float mass, const btVector3& color, const btVector3& initialPosition = btVector3(0, 0, 0), const btQuaternion& initialRotation = btQuaternion(0, 0, 1, 1), ObjectPools* pPools = nullptr);
 
 	~GameObject();
 
@@ -32,36 +42,69 @@ public:
 	btRigidBody* GetRigidBody() { return m_pBody; }
 
 	btMotionState* GetMotionState() { return m_pMotionState; }
+	OpenGLMotionState* GetOpenGLMotionState() { return m_pMotionState; }
 
 	void GetTransform(btScalar* transform) {
 		if (m_pMotionState) m_pMotionState->GetWorldTransform(transform);
 	}
 
-	glm::mat4 GetPosition() {
-		return m_pos;
+	// the model matrix: the one it was created with, or its slot in the
+	// application's transform array once it has one (it follows the body)
+	glm::mat4 GetPosition() const {
+		return m_pTransforms ? m_pTransforms->GetMatrix(m_transformSlot) : m_pos;
+	}
+	// the model matrix in the space of the rigid body
+	const glm::mat4& GetBodyToModel() const { return m_bodyToModel; }
+
+	void SetTransformSlot(const TransformSync* pTransforms, int slot) {
+		m_pTransforms = pTransforms;
+		m_transformSlot = slot;
 	}
+	int GetTransformSlot() const { return m_transformSlot; }
 
 	btVector3 GetColor() { return m_color; }
 
-	void drawObject(GLint& modelLoc);
+	// the texture is shared through the application's texture cache
+	const std::string& GetTexturePath() const { return *m_pTexturePath; }
+	GLuint GetTexture() const { return texture; }
+	void SetTexture(GLuint newTexture) { texture = newTexture; }
+
+	// layer in the application's texture array, -1 when the object uses its own texture
+	int GetTextureLayer() const { return m_textureLayer; }
+	void SetTextureLayer(int layer) { m_textureLayer = layer; }
+
+	// objects that can be moved by the simulation
+	bool IsDynamic() { return m_pBody && !m_pBody->isStaticObject(); }
 
-private:	
+	// spatial chunks of the mesh, used for culling
+	int GetChunkCount() const { return m_pMesh ? (int)m_pMesh->GetChunks().size() : 0; }
+	AABB GetChunkWorldBounds(int chunk) const { return m_pMesh->GetChunks()[chunk].bounds.Transformed(GetPosition()); }
+	GLsizei GetChunkVertexCount(int chunk) const { return m_pMesh->GetChunks()[chunk].count; }
+	SharedMesh* GetMesh() const { return m_pMesh; }
 
-	// New private function to load and initialize the mesh
-	void LoadMesh(const std::string& objFilePath, const char* texturePath);
+	// the model matrix (GetPosition) is bound by the caller
+	void drawObject();
 
+	// draw only the given chunks of the mesh
+	void drawChunks(const int* chunks, int chunkCount);
 
 protected:
+	ObjectPools* m_pPools;
 	btCollisionShape* m_pShape;
 	btRigidBody* m_pBody;
 	OpenGLMotionState* m_pMotionState;
 	btVector3      m_color;
-	GLuint VAO;
-	GLuint VBO;
+	// null for the objects without a model
+	SharedMesh* m_pMesh;
 	GLuint texture;
-	std::vector<uint32_t> indices;
-	std::vector<float> vertexBuffer;
+	// the pools' copy of the path, or m_texturePath without pools
+	const std::string* m_pTexturePath;
+	std::string m_texturePath;
+	int m_textureLayer;
 	glm::mat4 m_pos;
+	glm::mat4 m_bodyToModel;
+	const TransformSync* m_pTransforms;
+	int m_transformSlot;
 };
 
 
@@ -0,0 +1,327 @@
+#include "GridBroadphase.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+// the grid is never finer than this many cells a side
+static const int MAX_CELLS_PER_AXIS = 4096;
+
+// A proxy is listed in several cells, so a query marks the proxies it has
+// already seen. The marks belong to the thread, which lets queries run in
+// parallel.
+static thread_local std::vector<unsigned int> t_visitMarks;
+static thread_local unsigned int t_visitStamp = 0;
+
+static unsigned int BeginVisit(size_t proxyIds) {
+	if (t_visitMarks.size() < proxyIds) {
+		t_visitMarks.resize(proxyIds, 0);
+	}
+	if (++t_visitStamp == 0) {
+		std::fill(t_visitMarks.begin(), t_visitMarks.end(), 0);
+		t_visitStamp = 1;
+	}
+	return t_visitStamp;
+}
+
+static bool FirstVisit(const btBroadphaseProxy* pProxy, unsigned int stamp) {
+	unsigned int& mark = t_visitMarks[pProxy->m_uniqueId];
+	if (mark == stamp) return false;
+	mark = stamp;
+	return true;
+}
+
+static bool Contains(const btVector3& outerMin, const btVector3& outerMax, const btVector3& aabbMin, const btVector3& aabbMax) {
+	return aabbMin.x() >= outerMin.x() && aabbMin.y() >= outerMin.y() && aabbMin.z() >= outerMin.z()
+		&& aabbMax.x() <= outerMax.x() && aabbMax.y() <= outerMax.y() && aabbMax.z() <= outerMax.z();
+}
+
+GridBroadphase::GridBroadphase(const btVector3& worldMin, const btVector3& worldMax, btScalar cellSize) :
+	m_worldMin(worldMin),
+	m_worldMax(worldMax),
+	m_margin(0.05f),
+	m_maxProxyCells(64),
+	m_needsCleanup(false),
+	m_pPairCache(nullptr)
+{
+	btVector3 size = worldMax - worldMin;
+	m_cellSize = std::max(cellSize, std::max(size.x(), size.z()) / MAX_CELLS_PER_AXIS);
+	m_cellSize = std::max(m_cellSize, (btScalar)0.01f);
+	m_inverseCellSize = 1.0f / m_cellSize;
+	m_cellsX = std::max(1, (int)std::ceil(size.x() * m_inverseCellSize));
+	m_cellsZ = std::max(1, (int)std::ceil(size.z() * m_inverseCellSize));
+	m_cells.resize(m_cellsX * m_cellsZ);
+
+	m_pPairCache = new btHashedOverlappingPairCache();
+}
+
+GridBroadphase::~GridBroadphase() {
+	// the world destroys its proxies first, these are the ones left behind
+	for (size_t i = 0; i < m_proxies.size(); ++i) {
+		m_proxyPool.Destroy(m_proxies[i]);
+	}
+	delete m_pPairCache;
+}
+
+btBroadphaseProxy* GridBroadphase::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int /*shapeType*/, void* userPtr,
+	int collisionFilterGroup, int collisionFilterMask, btDispatcher* /*dispatcher*/) {
+	GridProxy* pProxy = m_proxyPool.Create();
+	pProxy->m_clientObject = userPtr;
+	pProxy->m_collisionFilterGroup = collisionFilterGroup;
+	pProxy->m_collisionFilterMask = collisionFilterMask;
+	pProxy->m_aabbMin = aabbMin;
+	pProxy->m_aabbMax = aabbMax;
+	pProxy->m_moved = false;
+	if (m_freeIds.empty()) {
+		pProxy->m_uniqueId = (int)m_proxies.size();
+		m_proxies.push_back(pProxy);
+	}
+	else {
+		pProxy->m_uniqueId = m_freeIds.back();
+		m_freeIds.pop_back();
+		m_proxies[pProxy->m_uniqueId] = pProxy;
+	}
+
+	btVector3 margin(m_margin, m_margin, m_margin);
+	pProxy->m_cellMin = aabbMin - margin;
+	pProxy->m_cellMax = aabbMax + margin;
+	Link(pProxy);
+	AddPairs(pProxy);
+	return pProxy;
+}
+
+void GridBroadphase::destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher) {
+	GridProxy* pProxy = (GridProxy*)proxy;
+	Unlink(pProxy);
+	m_pPairCache->removeOverlappingPairsContainingProxy(pProxy, dispatcher);
+	m_proxies[pProxy->m_uniqueId] = nullptr;
+	m_freeIds.push_back(pProxy->m_uniqueId);
+	m_proxyPool.Destroy(pProxy);
+}
+
+void GridBroadphase::setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* /*dispatcher*/) {
+	GridProxy* pProxy = (GridProxy*)proxy;
+	pProxy->m_aabbMin = aabbMin;
+	pProxy->m_aabbMax = aabbMax;
+
+	// still inside the enlarged bounds: the cells and the pairs are still right
+	if (Contains(pProxy->m_cellMin, pProxy->m_cellMax, aabbMin, aabbMax)) {
+		return;
+	}
+	btVector3 margin(m_margin, m_margin, m_margin);
+	pProxy->m_cellMin = aabbMin - margin;
+	pProxy->m_cellMax = aabbMax + margin;
+	if (CellX(pProxy->m_cellMin.x()) != pProxy->m_cellX0 || CellX(pProxy->m_cellMax.x()) != pProxy->m_cellX1
+		|| CellZ(pProxy->m_cellMin.z()) != pProxy->m_cellZ0 || CellZ(pProxy->m_cellMax.z()) != pProxy->m_cellZ1) {
+		Unlink(pProxy);
+		Link(pProxy);
+	}
+	pProxy->m_moved = true;
+	m_needsCleanup = true;
+	AddPairs(pProxy);
+}
+
+void GridBroadphase::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const {
+	aabbMin = proxy->m_aabbMin;
+	aabbMax = proxy->m_aabbMax;
+}
+
+void GridBroadphase::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback,
+	const btVector3& aabbMin, const btVector3& aabbMax) {
+	unsigned int stamp = BeginVisit(m_proxies.size());
+	// the bounds grow by the swept box, like btDbvt::rayTestInternal
+	btVector3 bounds[2];
+	btScalar lambda;
+	for (size_t i = 0; i < m_largeProxies.size(); ++i) {
+		GridProxy* pProxy = m_largeProxies[i];
+		bounds[0] = pProxy->m_aabbMin - aabbMax;
+		bounds[1] = pProxy->m_aabbMax - aabbMin;
+		if (btRayAabb2(rayFrom, rayCallback.m_rayDirectionInverse, rayCallback.m_signs, bounds, lambda, 0.0f, rayCallback.m_lambda_max)) {
+			rayCallback.process(pProxy);
+		}
+	}
+
+	// walk the cells along the ray, each with the cells around it that the
+	// swept box reaches
+	int reachX = (int)std::ceil(std::max(-aabbMin.x(), aabbMax.x()) * m_inverseCellSize);
+	int reachZ = (int)std::ceil(std::max(-aabbMin.z(), aabbMax.z()) * m_inverseCellSize);
+	btVector3 delta = rayTo - rayFrom;
+	int x = CellX(rayFrom.x()), z = CellZ(rayFrom.z());
+	btScalar nextX = NextBoundary(x, m_cellsX, m_worldMin.x(), rayFrom.x(), delta.x());
+	btScalar nextZ = NextBoundary(z, m_cellsZ, m_worldMin.z(), rayFrom.z(), delta.z());
+	for (;;) {
+		int x0 = std::max(0, x - reachX), x1 = std::min(m_cellsX - 1, x + reachX);
+		int z0 = std::max(0, z - reachZ), z1 = std::min(m_cellsZ - 1, z + reachZ);
+		for (int cz = z0; cz <= z1; ++cz) {
+			for (int cx = x0; cx <= x1; ++cx) {
+				const std::vector<GridProxy*>& cell = m_cells[cz * m_cellsX + cx];
+				for (size_t i = 0; i < cell.size(); ++i) {
+					GridProxy* pProxy = cell[i];
+					if (!FirstVisit(pProxy, stamp)) continue;
+					bounds[0] = pProxy->m_aabbMin - aabbMax;
+					bounds[1] = pProxy->m_aabbMax - aabbMin;
+					if (btRayAabb2(rayFrom, rayCallback.m_rayDirectionInverse, rayCallback.m_signs, bounds, lambda, 0.0f, rayCallback.m_lambda_max)) {
+						rayCallback.process(pProxy);
+					}
+				}
+			}
+		}
+
+		if (nextX > 1.0f && nextZ > 1.0f) break;
+		if (nextX < nextZ) {
+			x += delta.x() > 0.0f ? 1 : -1;
+			nextX = NextBoundary(x, m_cellsX, m_worldMin.x(), rayFrom.x(), delta.x());
+		}
+		else {
+			z += delta.z() > 0.0f ? 1 : -1;
+			nextZ = NextBoundary(z, m_cellsZ, m_worldMin.z(), rayFrom.z(), delta.z());
+		}
+	}
+}
+
+void GridBroadphase::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback) {
+	unsigned int stamp = BeginVisit(m_proxies.size());
+	for (size_t i = 0; i < m_largeProxies.size(); ++i) {
+		GridProxy* pProxy = m_largeProxies[i];
+		if (TestAabbAgainstAabb2(aabbMin, aabbMax, pProxy->m_aabbMin, pProxy->m_aabbMax)) {
+			callback.process(pProxy);
+		}
+	}
+
+	int x0 = CellX(aabbMin.x()), x1 = CellX(aabbMax.x());
+	int z0 = CellZ(aabbMin.z()), z1 = CellZ(aabbMax.z());
+	for (int z = z0; z <= z1; ++z) {
+		for (int x = x0; x <= x1; ++x) {
+			const std::vector<GridProxy*>& cell = m_cells[z * m_cellsX + x];
+			for (size_t i = 0; i < cell.size(); ++i) {
+				GridProxy* pProxy = cell[i];
+				if (FirstVisit(pProxy, stamp) && TestAabbAgainstAabb2(aabbMin, aabbMax, pProxy->m_aabbMin, pProxy->m_aabbMax)) {
+					callback.process(pProxy);
+				}
+			}
+		}
+	}
+}
+
+void GridBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher) {
+	// the new pairs were added when the proxies moved
+	if (!m_needsCleanup) return;
+
+	// removing a pair moves the last one into its place, like btDbvtBroadphase
+	btBroadphasePairArray& pairs = m_pPairCache->getOverlappingPairArray();
+	for (int i = 0; i < pairs.size(); ++i) {
+		GridProxy* pProxy0 = (GridProxy*)pairs[i].m_pProxy0;
+		GridProxy* pProxy1 = (GridProxy*)pairs[i].m_pProxy1;
+		if ((pProxy0->m_moved || pProxy1->m_moved)
+			&& !TestAabbAgainstAabb2(pProxy0->m_cellMin, pProxy0->m_cellMax, pProxy1->m_cellMin, pProxy1->m_cellMax)) {
+			m_pPairCache->removeOverlappingPair(pProxy0, pProxy1, dispatcher);
+			--i;
+		}
+	}
+	for (size_t i = 0; i < m_proxies.size(); ++i) {
+		if (m_proxies[i]) m_proxies[i]->m_moved = false;
+	}
+	m_needsCleanup = false;
+}
+
+void GridBroadphase::getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const {
+	aabbMin = m_worldMin;
+	aabbMax = m_worldMax;
+}
+
+void GridBroadphase::printStats() {
+	size_t entries = 0, fullest = 0;
+	for (size_t i = 0; i < m_cells.size(); ++i) {
+		entries += m_cells[i].size();
+		fullest = std::max(fullest, m_cells[i].size());
+	}
+	std::cout << "GridBroadphase: " << GetProxyCount() << " proxies (" << m_largeProxies.size() << " large), "
+		<< m_cellsX << "x" << m_cellsZ << " cells of " << m_cellSize << ", " << entries << " cell entries, fullest cell "
+		<< fullest << ", " << m_pPairCache->getNumOverlappingPairs() << " pairs" << std::endl;
+}
+
+int GridBroadphase::CellX(btScalar x) const {
+	btScalar cell = (x - m_worldMin.x()) * m_inverseCellSize;
+	// written so that NaN lands in the first cell
+	if (!(cell >= 0.0f)) return 0;
+	return cell < m_cellsX ? (int)cell : m_cellsX - 1;
+}
+
+int GridBroadphase::CellZ(btScalar z) const {
+	btScalar cell = (z - m_worldMin.z()) * m_inverseCellSize;
+	if (!(cell >= 0.0f)) return 0;
+	return cell < m_cellsZ ? (int)cell : m_cellsZ - 1;
+}
+
+btScalar GridBroadphase::NextBoundary(int cell, int cellCount, btScalar worldMin, btScalar from, btScalar delta) const {
+	// the border cells have no outer boundary
+	if (delta > 0.0f && cell < cellCount - 1) {
+		return (worldMin + (cell + 1) * m_cellSize - from) / delta;
+	}
+	if (delta < 0.0f && cell > 0) {
+		return (worldMin + cell * m_cellSize - from) / delta;
+	}
+	return BT_LARGE_FLOAT;
+}
+
+void GridBroadphase::Link(GridProxy* pProxy) {
+	pProxy->m_cellX0 = CellX(pProxy->m_cellMin.x());
+	pProxy->m_cellX1 = CellX(pProxy->m_cellMax.x());
+	pProxy->m_cellZ0 = CellZ(pProxy->m_cellMin.z());
+	pProxy->m_cellZ1 = CellZ(pProxy->m_cellMax.z());
+	int cells = (pProxy->m_cellX1 - pProxy->m_cellX0 + 1) * (pProxy->m_cellZ1 - pProxy->m_cellZ0 + 1);
+	pProxy->m_large = cells > m_maxProxyCells;
+	if (pProxy->m_large) {
+		m_largeProxies.push_back(pProxy);
+		return;
+	}
+	for (int z = pProxy->m_cellZ0; z <= pProxy->m_cellZ1; ++z) {
+		for (int x = pProxy->m_cellX0; x <= pProxy->m_cellX1; ++x) {
+			m_cells[z * m_cellsX + x].push_back(pProxy);
+		}
+	}
+}
+
+void GridBroadphase::Unlink(GridProxy* pProxy) {
+	if (pProxy->m_large) {
+		std::vector<GridProxy*>::iterator it = std::find(m_largeProxies.begin(), m_largeProxies.end(), pProxy);
+		if (it != m_largeProxies.end()) {
+			*it = m_largeProxies.back();
+			m_largeProxies.pop_back();
+		}
+		return;
+	}
+	for (int z = pProxy->m_cellZ0; z <= pProxy->m_cellZ1; ++z) {
+		for (int x = pProxy->m_cellX0; x <= pProxy->m_cellX1; ++x) {
+			std::vector<GridProxy*>& cell = m_cells[z * m_cellsX + x];
+			std::vector<GridProxy*>::iterator it = std::find(cell.begin(), cell.end(), pProxy);
+			if (it != cell.end()) {
+				*it = cell.back();
+				cell.pop_back();
+			}
+		}
+	}
+}
+
+void GridBroadphase::AddPairs(GridProxy* pProxy) {
+	// the pair cache checks the filters and ignores the pairs it already has
+	unsigned int stamp = BeginVisit(m_proxies.size());
+	FirstVisit(pProxy, stamp);
+	for (size_t i = 0; i < m_largeProxies.size(); ++i) {
+		GridProxy* pOther = m_largeProxies[i];
+		if (pOther != pProxy && TestAabbAgainstAabb2(pProxy->m_cellMin, pProxy->m_cellMax, pOther->m_cellMin, pOther->m_cellMax)) {
+			m_pPairCache->addOverlappingPair(pProxy, pOther);
+		}
+	}
+	for (int z = pProxy->m_cellZ0; z <= pProxy->m_cellZ1; ++z) {
+		for (int x = pProxy->m_cellX0; x <= pProxy->m_cellX1; ++x) {
+			const std::vector<GridProxy*>& cell = m_cells[z * m_cellsX + x];
+			for (size_t i = 0; i < cell.size(); ++i) {
+				GridProxy* pOther = cell[i];
+				if (FirstVisit(pOther, stamp) && TestAabbAgainstAabb2(pProxy->m_cellMin, pProxy->m_cellMax, pOther->m_cellMin, pOther->m_cellMax)) {
+					m_pPairCache->addOverlappingPair(pProxy, pOther);
+				}
+			}
+		}
+	}
+}
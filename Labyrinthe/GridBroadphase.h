@@ -0,0 +1,100 @@
+#ifndef BULLETOPENGL_GRIDBROADPHASE_H
+#define BULLETOPENGL_GRIDBROADPHASE_H
+
+#include <vector>
+
+#include <Bullet/btBulletCollisionCommon.h>
+
+#include "ObjectPool.h"
+
+// A broadphase for flat worlds with many small objects, like the maze
+// agents. The XZ plane between the world bounds is cut into square cells.
+// A proxy is listed in every cell its bounds touch, and only proxies that
+// share a cell are tested against each other. Height only matters in the
+// overlap test. The border cells reach to infinity, so objects outside the
+// bounds are still found, just more slowly.
+//
+// Proxies that cover too many cells (the maze mesh, the ground) are kept
+// out of the cells, in a list that every proxy is tested against.
+//
+// The cells use bounds enlarged by a margin, so a proxy that moves less than
+// the margin doesn't touch them. New pairs are added as soon as a proxy is
+// created or moved, like btDbvtBroadphase does without deferred collide: the
+// ghost objects of the character controllers need their pairs before the
+// next calculateOverlappingPairs. Pairs that stopped overlapping are removed
+// there.
+class GridBroadphase : public btBroadphaseInterface {
+public:
+	GridBroadphase(const btVector3& worldMin, const btVector3& worldMax, btScalar cellSize);
+	virtual ~GridBroadphase();
+
+	virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr,
+		int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher);
+	virtual void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher);
+	virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher);
+	virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const;
+
+	// the queries only read the grid, several threads can run them at once
+	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback,
+		const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0));
+	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+
+	// removes the pairs of moved proxies that don't overlap anymore
+	virtual void calculateOverlappingPairs(btDispatcher* dispatcher);
+
+	virtual btOverlappingPairCache* getOverlappingPairCache() { return m_pPairCache; }
+	virtual const btOverlappingPairCache* getOverlappingPairCache() const { return m_pPairCache; }
+	virtual void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const;
+	virtual void resetPool(btDispatcher* /*dispatcher*/) {}
+	virtual void printStats();
+
+	// how much the cell bounds of a proxy are bigger than its bounds
+	void SetMargin(btScalar margin) { m_margin = margin; }
+	// proxies covering more cells than this go to the list tested against all
+	void SetMaxProxyCells(int cells) { m_maxProxyCells = cells; }
+
+	int GetProxyCount() const { return (int)m_proxies.size() - (int)m_freeIds.size(); }
+	int GetLargeProxyCount() const { return (int)m_largeProxies.size(); }
+	int GetCellCount() const { return m_cellsX * m_cellsZ; }
+	btScalar GetCellSize() const { return m_cellSize; }
+
+private:
+	struct GridProxy : public btBroadphaseProxy {
+		btVector3 m_cellMin; // enlarged bounds, the cells and pairs use these
+		btVector3 m_cellMax;
+		int m_cellX0, m_cellZ0, m_cellX1, m_cellZ1;
+		bool m_large;
+		bool m_moved; // since the last calculateOverlappingPairs
+	};
+
+	int CellX(btScalar x) const;
+	int CellZ(btScalar z) const;
+	// where the ray leaves cell 'cell' along one axis, as a fraction of the ray
+	btScalar NextBoundary(int cell, int cellCount, btScalar worldMin, btScalar from, btScalar delta) const;
+
+	void Link(GridProxy* pProxy);
+	void Unlink(GridProxy* pProxy);
+	void AddPairs(GridProxy* pProxy);
+
+	btVector3 m_worldMin;
+	btVector3 m_worldMax;
+	btScalar m_cellSize;
+	btScalar m_inverseCellSize;
+	int m_cellsX;
+	int m_cellsZ;
+	btScalar m_margin;
+	int m_maxProxyCells;
+	bool m_needsCleanup;
+
+	std::vector<std::vector<GridProxy*> > m_cells;
+	std::vector<GridProxy*> m_largeProxies;
+	// the proxies come from the pool, moving agents in and out of the world
+	// doesn't call the heap. By unique id, the ids of destroyed proxies are used again
+	ObjectPool<GridProxy> m_proxyPool;
+	std::vector<GridProxy*> m_proxies;
+	std::vector<int> m_freeIds;
+
+	btOverlappingPairCache* m_pPairCache;
+};
+
+#endif //BULLETOPENGL_GRIDBROADPHASE_H
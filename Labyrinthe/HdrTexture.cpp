@@ -0,0 +1,268 @@
+#include "HdrTexture.h"
+#include "VertexFormat.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <SOIL2/stb_image.h>
+
+#if defined(__F16C__) || defined(__AVX2__)
+#define HDR_F16C
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HDR_SSE2
+#include <emmintrin.h>
+#endif
+
+static const float HALF_MAX = 65504.0f;
+
+bool HdrTexture::isHdrPath(const std::string& path) {
+    if (path.size() < 4) return false;
+    std::string extension = path.substr(path.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".hdr";
+}
+
+bool HdrTexture::decode(const std::string& path, HdrImage& image, bool directRgbe) {
+    std::vector<unsigned char> rgbe;
+    if (directRgbe && readRgbe(path, image.width, image.height, rgbe)) {
+        image.pixels.resize((size_t)image.width * image.height * 3);
+        rgbeToHalf(&rgbe[0], (size_t)image.width * image.height, &image.pixels[0]);
+        return true;
+    }
+
+    int channels;
+    float* pValues = stbi_loadf(path.c_str(), &image.width, &image.height, &channels, 3);
+    if (!pValues) {
+        std::cerr << "Failed to load HDR texture: " << path << std::endl;
+        return false;
+    }
+    image.pixels.resize((size_t)image.width * image.height * 3);
+    floatToHalf(pValues, image.pixels.size(), &image.pixels[0]);
+    stbi_image_free(pValues);
+    return true;
+}
+
+/*
+    Reads a 32-bit_rle_rgbe file with the usual "-Y height +X width" layout.
+    Scanlines are either flat or new style RLE (each channel run length
+    encoded on its own), anything else is left to stb
+*/
+bool HdrTexture::readRgbe(const std::string& path, int& width, int& height, std::vector<unsigned char>& rgbe) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file) return false;
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // text header, ends with an empty line, then the resolution line
+    size_t pos = 0;
+    bool validFormat = false;
+    std::string line;
+    for (;;) {
+        size_t end = pos;
+        while (end < data.size() && data[end] != '\n') ++end;
+        if (end >= data.size()) return false;
+        line.assign(data.begin() + pos, data.begin() + end);
+        pos = end + 1;
+
+        if (line.compare(0, 2, "#?") == 0) continue;
+        if (line == "FORMAT=32-bit_rle_rgbe") validFormat = true;
+        if (line.empty()) break;
+    }
+    size_t end = pos;
+    while (end < data.size() && data[end] != '\n') ++end;
+    if (!validFormat || end >= data.size()) return false;
+    line.assign(data.begin() + pos, data.begin() + end);
+    pos = end + 1;
+
+    std::istringstream resolution(line);
+    std::string yAxis, xAxis;
+    if (!(resolution >> yAxis >> height >> xAxis >> width) || yAxis != "-Y" || xAxis != "+X" || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    rgbe.resize((size_t)width * height * 4);
+    std::vector<unsigned char> planes((size_t)width * 4);
+    for (int y = 0; y < height; ++y) {
+        unsigned char* pRow = &rgbe[(size_t)y * width * 4];
+        if (pos + 4 > data.size()) return false;
+
+        bool rle = width >= 8 && width < 0x8000 && data[pos] == 2 && data[pos + 1] == 2 && !(data[pos + 2] & 0x80);
+        if (!rle) {
+            // flat scanline, old style RLE starts with 1 1 1
+            if (pos + (size_t)width * 4 > data.size()) return false;
+            std::memcpy(pRow, &data[pos], (size_t)width * 4);
+            for (int x = 0; x < width; ++x) {
+                if (pRow[x * 4] == 1 && pRow[x * 4 + 1] == 1 && pRow[x * 4 + 2] == 1) return false;
+            }
+            pos += (size_t)width * 4;
+            continue;
+        }
+
+        if (((data[pos + 2] << 8) | data[pos + 3]) != width) return false;
+        pos += 4;
+        for (int channel = 0; channel < 4; ++channel) {
+            unsigned char* pPlane = &planes[(size_t)channel * width];
+            int x = 0;
+            while (x < width) {
+                if (pos >= data.size()) return false;
+                int count = data[pos++];
+                if (count > 128) {
+                    // run of one value
+                    count -= 128;
+                    if (count > width - x || pos >= data.size()) return false;
+                    std::memset(pPlane + x, data[pos++], count);
+                }
+                else {
+                    if (count == 0 || count > width - x || pos + count > data.size()) return false;
+                    std::memcpy(pPlane + x, &data[pos], count);
+                    pos += count;
+                }
+                x += count;
+            }
+        }
+        for (int x = 0; x < width; ++x) {
+            pRow[x * 4] = planes[x];
+            pRow[x * 4 + 1] = planes[width + x];
+            pRow[x * 4 + 2] = planes[2 * width + x];
+            pRow[x * 4 + 3] = planes[3 * width + x];
+        }
+    }
+    return true;
+}
+
+/*
+    value = mantissa * 2^(exponent - 136). Exponents up to 9 give values far
+    below the smallest half and become 0, like a zero exponent
+*/
+void HdrTexture::rgbeToHalfScalar(const unsigned char* pRgbe, size_t pixelCount, uint16_t* pOut) {
+    for (size_t i = 0; i < pixelCount; ++i) {
+        const unsigned char* pPixel = pRgbe + i * 4;
+        float scale = 0.0f;
+        if (pPixel[3] > 9) {
+            uint32_t bits = (uint32_t)(pPixel[3] - 9) << 23;
+            std::memcpy(&scale, &bits, sizeof(scale));
+        }
+        for (int c = 0; c < 3; ++c) {
+            pOut[i * 3 + c] = VertexFormat::floatToHalf(std::min(pPixel[c] * scale, HALF_MAX));
+        }
+    }
+}
+
+void HdrTexture::floatToHalfScalar(const float* pValues, size_t count, uint16_t* pOut) {
+    for (size_t i = 0; i < count; ++i) {
+        pOut[i] = VertexFormat::floatToHalf(std::min(std::max(pValues[i], 0.0f), HALF_MAX));
+    }
+}
+
+#if defined(HDR_F16C) || defined(HDR_SSE2)
+
+/*
+    4 floats to 4 halves (one per 32 bit lane), rounded to nearest even.
+    Without F16C: halves below the smallest normal are aligned by adding a
+    magic float, which rounds correctly by itself; the others get their
+    exponent rebiased and the 13 dropped mantissa bits rounded by hand
+*/
+static inline __m128i toHalfLanes(__m128 values) {
+    values = _mm_min_ps(_mm_max_ps(values, _mm_setzero_ps()), _mm_set1_ps(HALF_MAX));
+#ifdef HDR_F16C
+    return _mm_cvtepu16_epi32(_mm_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+#else
+    __m128i bits = _mm_castps_si128(values);
+    const __m128i magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(values, _mm_castsi128_ps(magic))), magic);
+
+    // exponent bias 127 -> 15 and half of the dropped bits, minus one
+    const __m128i rebias = _mm_set1_epi32((int)0xc8000fffu);
+    __m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+    __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, rebias), odd), 13);
+
+    __m128i isSubnormal = _mm_cmplt_epi32(bits, _mm_set1_epi32(113 << 23));
+    return _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+#endif
+}
+
+// one RGBE pixel in 4 lanes to its RGB values (the last lane is garbage)
+static inline __m128 rgbeLanesToFloats(__m128i pixel) {
+    __m128i exponent = _mm_shuffle_epi32(pixel, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i scaleBits = _mm_slli_epi32(_mm_sub_epi32(exponent, _mm_set1_epi32(9)), 23);
+    __m128i valid = _mm_cmpgt_epi32(exponent, _mm_set1_epi32(9));
+    __m128 scale = _mm_castsi128_ps(_mm_and_si128(scaleBits, valid));
+    return _mm_mul_ps(_mm_cvtepi32_ps(pixel), scale);
+}
+
+void HdrTexture::rgbeToHalf(const unsigned char* pRgbe, size_t pixelCount, uint16_t* pOut) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    // every pixel stores 4 halves, the 4th is overwritten by the next pixel,
+    // so the last pixel is left to the scalar loop
+    for (; i + 4 < pixelCount; i += 4) {
+        __m128i packed = _mm_loadu_si128((const __m128i*)(pRgbe + i * 4));
+        __m128i low = _mm_unpacklo_epi8(packed, zero);
+        __m128i high = _mm_unpackhi_epi8(packed, zero);
+
+        __m128i h0 = toHalfLanes(rgbeLanesToFloats(_mm_unpacklo_epi16(low, zero)));
+        __m128i h1 = toHalfLanes(rgbeLanesToFloats(_mm_unpackhi_epi16(low, zero)));
+        __m128i h2 = toHalfLanes(rgbeLanesToFloats(_mm_unpacklo_epi16(high, zero)));
+        __m128i h3 = toHalfLanes(rgbeLanesToFloats(_mm_unpackhi_epi16(high, zero)));
+
+        // halves are at most 0x7bff, the signed saturation never kicks in
+        __m128i h01 = _mm_packs_epi32(h0, h1);
+        __m128i h23 = _mm_packs_epi32(h2, h3);
+        _mm_storel_epi64((__m128i*)(pOut + i * 3), h01);
+        _mm_storel_epi64((__m128i*)(pOut + i * 3 + 3), _mm_srli_si128(h01, 8));
+        _mm_storel_epi64((__m128i*)(pOut + i * 3 + 6), h23);
+        _mm_storel_epi64((__m128i*)(pOut + i * 3 + 9), _mm_srli_si128(h23, 8));
+    }
+    rgbeToHalfScalar(pRgbe + i * 4, pixelCount - i, pOut + i * 3);
+}
+
+void HdrTexture::floatToHalf(const float* pValues, size_t count, uint16_t* pOut) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i low = toHalfLanes(_mm_loadu_ps(pValues + i));
+        __m128i high = toHalfLanes(_mm_loadu_ps(pValues + i + 4));
+        _mm_storeu_si128((__m128i*)(pOut + i), _mm_packs_epi32(low, high));
+    }
+    floatToHalfScalar(pValues + i, count - i, pOut + i);
+}
+
+#else
+
+void HdrTexture::rgbeToHalf(const unsigned char* pRgbe, size_t pixelCount, uint16_t* pOut) {
+    rgbeToHalfScalar(pRgbe, pixelCount, pOut);
+}
+
+void HdrTexture::floatToHalf(const float* pValues, size_t count, uint16_t* pOut) {
+    floatToHalfScalar(pValues, count, pOut);
+}
+
+#endif
+
+GLuint HdrTexture::upload(GLuint texture, const HdrImage& image) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // rows are 6 bytes per pixel, only 2 byte aligned for odd widths
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, image.width, image.height, 0, GL_RGB, GL_HALF_FLOAT, &image.pixels[0]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+const char* HdrTexture::getSimdName() {
+#if defined(HDR_F16C)
+    return "F16C";
+#elif defined(HDR_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
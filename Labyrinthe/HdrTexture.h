@@ -0,0 +1,59 @@
+/*
+    Radiance .hdr textures, kept in floating point up to the GPU.
+
+    SOIL_LOAD_RGBA would clamp the image to 8 bits per channel, so HDR files
+    are uploaded as GL_RGB16F with half float pixels prepared on the CPU: the
+    driver gets the exact format it stores and doesn't convert anything.
+
+    Two decoders produce the halves:
+    - RGBE direct (default): the RLE scanlines are read here and every RGBE
+      pixel goes straight to half floats, 4 pixels per SIMD iteration.
+    - stb float: stbi_loadf expands the file to 32 bit floats, which are then
+      converted to halves (SIMD as well). Also the fallback for the rare files
+      the direct reader doesn't handle (flipped axes, old style RLE).
+
+    Both round to nearest even and clamp to the largest half (65504), the SIMD
+    code gives the same bits as the scalar one. Decoding is pure CPU work, the
+    TextureDecodePool runs it on its worker threads.
+*/
+
+#ifndef HDRTEXTURE_H_INCLUDED
+#define HDRTEXTURE_H_INCLUDED
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <GL/glew.h>
+
+struct HdrImage {
+    int width, height;
+    std::vector<uint16_t> pixels; // 3 halves per pixel, RGB
+};
+
+class HdrTexture {
+public:
+    // true for ".hdr" files
+    static bool isHdrPath(const std::string& path);
+
+    // decode a Radiance file to half floats
+    static bool decode(const std::string& path, HdrImage& image, bool directRgbe = true);
+
+    // the raw RGBE pixels of the file, top row first
+    static bool readRgbe(const std::string& path, int& width, int& height, std::vector<unsigned char>& rgbe);
+
+    // RGBE pixels (4 bytes each) to RGB halves (3 per pixel)
+    static void rgbeToHalf(const unsigned char* pRgbe, size_t pixelCount, uint16_t* pOut);
+    static void rgbeToHalfScalar(const unsigned char* pRgbe, size_t pixelCount, uint16_t* pOut);
+
+    // floats to halves, clamped to [0, 65504]
+    static void floatToHalf(const float* pValues, size_t count, uint16_t* pOut);
+    static void floatToHalfScalar(const float* pValues, size_t count, uint16_t* pOut);
+
+    // GL_RGB16F with its mipmaps, on the thread that owns the GL context
+    static GLuint upload(GLuint texture, const HdrImage& image);
+
+    // instruction set the conversions were compiled for: "F16C", "SSE2" or "scalar"
+    static const char* getSimdName();
+};
+
+#endif // HDRTEXTURE_H_INCLUDED
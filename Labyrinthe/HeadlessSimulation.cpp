@@ -0,0 +1,243 @@
+#include "HeadlessSimulation.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "ObjLoader.h"
+#include "ObjWGroupsLoader.h"
+
+// where main puts the maze, the ground and the agent model
+static const glm::vec3 MAZE_OFFSET(0.0f, -4.0f, -10.0f);
+
+// whether a spawn point is free
+class SpawnTestCallback : public btCollisionWorld::ContactResultCallback {
+public:
+	SpawnTestCallback() : m_touching(false) {}
+
+	virtual btScalar addSingleResult(btManifoldPoint& /*cp*/, const btCollisionObjectWrapper* /*colObj0Wrap*/, int /*partId0*/, int /*index0*/,
+		const btCollisionObjectWrapper* /*colObj1Wrap*/, int /*partId1*/, int /*index1*/) {
+		m_touching = true;
+		return 0.0f;
+	}
+
+	bool m_touching;
+};
+
+HeadlessConfig HeadlessConfig::FromArgs(int argc, char* argv[]) {
+	HeadlessConfig config;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--agents" && i + 1 < argc) {
+			config.agents = std::max(0, std::atoi(argv[++i]));
+		}
+		else if (arg == "--ticks" && i + 1 < argc) {
+			config.ticks = std::max(0LL, std::atoll(argv[++i]));
+			// a tick count alone runs all of them
+			config.seconds = 0.0;
+		}
+		else if (arg == "--seconds" && i + 1 < argc) {
+			config.seconds = std::max(0.0, std::atof(argv[++i]));
+		}
+		else if (arg == "--report" && i + 1 < argc) {
+			config.reportSeconds = std::max(0.1, std::atof(argv[++i]));
+		}
+		else if (arg == "--seed" && i + 1 < argc) {
+			config.seed = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--agent-speed" && i + 1 < argc) {
+			config.agentSpeed = std::max(0.0f, (float)std::atof(argv[++i]));
+		}
+	}
+	config.physics = PhysicsConfig::FromArgs(argc, argv);
+	return config;
+}
+
+HeadlessSimulation::HeadlessSimulation() :
+	m_pWorld(nullptr),
+	m_stepSize(1.0f / 60.0f),
+	m_pAgentShape(nullptr),
+	m_agentCenter(0.0f),
+	m_agentSpeed(0.0f),
+	m_ticks(0)
+{
+}
+
+HeadlessSimulation::~HeadlessSimulation() {
+	RemoveAgents();
+	if (m_pWorld) {
+		m_maze.RemoveFromWorld(m_pWorld);
+	}
+	m_physics.Destroy();
+	delete m_pAgentShape;
+}
+
+bool HeadlessSimulation::LoadMesh(const std::string& objPath, CpuMesh& mesh) {
+	std::ifstream file(objPath);
+	if (!file) {
+		std::cerr << "Can't open " << objPath << std::endl;
+		return false;
+	}
+	mesh.vertices = ObjLoader::loadModel(objPath, true).second;
+	mesh.chunks = MeshChunker::splitIntoChunks(mesh.vertices, MESH_CHUNK_SIZE);
+	mesh.bounds = MeshChunker::computeBounds(mesh.vertices);
+	return !mesh.vertices.empty();
+}
+
+bool HeadlessSimulation::Load(const PhysicsConfig& physics) {
+	if (m_pWorld) return false;
+
+	// the render meshes, as the game loads them but never uploaded
+	if (!LoadMesh("models/mazeY.obj", m_mazeMesh) || !LoadMesh("models/agentY.obj", m_agentMesh)
+		|| !LoadMesh("models/groundY.obj", m_groundMesh)) {
+		return false;
+	}
+
+	// the baked maze physics when there is one (--bake physics) and the colliders haven't changed
+	glm::mat4 mazeTransform = glm::translate(glm::mat4(1.0f), MAZE_OFFSET);
+	std::ifstream baked("models/mazeY.bullet");
+	if (!baked || !m_maze.Load("models/mazeY.bullet", "models/mazeY_collider_NoTextures.obj")) {
+		ObjWGroupsLoader colliderLoader;
+		colliderLoader.loadObj("models/mazeY_collider_NoTextures.obj");
+		if (colliderLoader.Meshes.empty() || !m_maze.Build(colliderLoader.Meshes, mazeTransform)) {
+			std::cerr << "Failed to load the maze colliders" << std::endl;
+			return false;
+		}
+	}
+
+	m_pWorld = m_physics.Create(physics);
+	if (!m_pWorld) return false;
+	m_maze.AddToWorld(m_pWorld);
+	m_stepSize = 1.0f / physics.tickRate;
+
+	// a cylinder around the agent model, the controllers move its center
+	glm::vec3 extents = (m_agentMesh.bounds.max - m_agentMesh.bounds.min) * 0.5f;
+	m_agentCenter = (m_agentMesh.bounds.min + m_agentMesh.bounds.max) * 0.5f;
+	btScalar radius = std::max(extents.x, extents.z);
+	m_pAgentShape = new btCylinderShape(btVector3(radius, extents.y, radius));
+	return true;
+}
+
+int HeadlessSimulation::SpawnAgents(int count, unsigned int seed, float speed) {
+	if (!m_pWorld) return 0;
+	m_random.seed(seed);
+	m_agentSpeed = speed;
+
+	// random spots on the maze floor that touch nothing
+	const AABB& bounds = m_maze.GetBounds();
+	std::uniform_real_distribution<float> spawnX(bounds.min.x, bounds.max.x), spawnZ(bounds.min.z, bounds.max.z);
+	btScalar height = m_maze.GetFloorHeight() + m_pAgentShape->getHalfExtentsWithMargin().y() + 0.05f;
+	btCollisionObject probe;
+	probe.setCollisionShape(m_pAgentShape);
+	int spawned = 0;
+	for (int tries = 0; spawned < count && tries < count * 20; ++tries) {
+		btVector3 position(spawnX(m_random), height, spawnZ(m_random));
+		probe.setWorldTransform(btTransform(btQuaternion::getIdentity(), position));
+		SpawnTestCallback test;
+		m_pWorld->contactTest(&probe, test);
+		if (test.m_touching) continue;
+
+		CharacterController* pAgent = new CharacterController(m_pAgentShape, 0.15f, position);
+		Steer(pAgent);
+		pAgent->AddToWorld(m_pWorld);
+		m_pWorld->addAction(pAgent);
+		m_agents.push_back(pAgent);
+		++spawned;
+	}
+	m_agentMatrices.resize(m_agents.size());
+	return spawned;
+}
+
+void HeadlessSimulation::RemoveAgents() {
+	for (size_t i = 0; i < m_agents.size(); ++i) {
+		m_pWorld->removeAction(m_agents[i]);
+		m_agents[i]->RemoveFromWorld(m_pWorld);
+		delete m_agents[i];
+	}
+	m_agents.clear();
+	m_agentMatrices.clear();
+}
+
+void HeadlessSimulation::Steer(CharacterController* pAgent) {
+	std::uniform_real_distribution<float> angle(0.0f, 2.0f * SIMD_PI);
+	float a = angle(m_random);
+	pAgent->SetWalkVelocity(btVector3(std::cos(a), 0.0f, std::sin(a)) * m_agentSpeed);
+}
+
+void HeadlessSimulation::Tick() {
+	// the agent logic: whoever ran into a wall last tick turns away from it
+	for (size_t i = 0; i < m_agents.size(); ++i) {
+		if (m_agents[i]->HitWall()) Steer(m_agents[i]);
+	}
+	m_pWorld->stepSimulation(m_stepSize, 0, m_stepSize);
+	RenderStub();
+	++m_ticks;
+}
+
+void HeadlessSimulation::RenderStub() {
+	// ticks run back to back, there is nothing to interpolate
+	for (size_t i = 0; i < m_agents.size(); ++i) {
+		const btVector3& position = m_agents[i]->GetPosition();
+		m_agentMatrices[i] = glm::translate(glm::mat4(1.0f), glm::vec3(position.x(), position.y(), position.z()) - m_agentCenter);
+	}
+}
+
+void HeadlessSimulation::Run(const HeadlessConfig& config) {
+	std::cout << "# headless, " << m_agents.size() << " agents, " << m_maze.GetWallCount() << " walls, ticks of " << m_stepSize << " s, "
+		<< PhysicsBackend::GetBroadphaseName(config.physics.broadphase) << " broadphase, "
+		<< (m_physics.IsMultithreaded() ? m_physics.GetSchedulerName() : "single threaded") << " world" << std::endl;
+	std::cout << "seconds,ticks,ticks_per_s,agent_ticks_per_s,tick_ms_avg,tick_ms_max,on_ground" << std::endl;
+
+	btClock clock, reportClock;
+	unsigned long long startTicks = m_ticks, reportTicks = 0;
+	double worst = 0.0;
+	while ((config.ticks <= 0 || (long long)(m_ticks - startTicks) < config.ticks)
+		&& (config.seconds <= 0.0 || clock.getTimeMicroseconds() * 0.000001 < config.seconds)) {
+		btClock tickClock;
+		Tick();
+		worst = std::max(worst, tickClock.getTimeMicroseconds() * 0.001);
+		++reportTicks;
+
+		double reportElapsed = reportClock.getTimeMicroseconds() * 0.000001;
+		if (reportElapsed >= config.reportSeconds) {
+			int onGround = 0;
+			for (size_t i = 0; i < m_agents.size(); ++i) {
+				onGround += m_agents[i]->IsOnGround() ? 1 : 0;
+			}
+			double rate = reportTicks / reportElapsed;
+			std::cout << clock.getTimeMicroseconds() * 0.000001 << "," << m_ticks - startTicks << "," << rate << "," << rate * m_agents.size() << ","
+				<< 1000.0 / rate << "," << worst << "," << onGround << std::endl;
+			reportTicks = 0;
+			worst = 0.0;
+			reportClock.reset();
+		}
+	}
+
+	double seconds = clock.getTimeMicroseconds() * 0.000001;
+	unsigned long long ticks = m_ticks - startTicks;
+	double rate = seconds > 0.0 ? ticks / seconds : 0.0;
+	std::cout << "# " << ticks << " ticks in " << seconds << " s: " << rate << " ticks/s, " << rate * m_agents.size() << " agent ticks/s, "
+		<< rate * m_stepSize << "x real time" << std::endl;
+}
+
+int runHeadless(int argc, char* argv[]) {
+	HeadlessConfig config = HeadlessConfig::FromArgs(argc, argv);
+	// the tick rate only sets the step size, nothing waits for real time
+	if (config.physics.ownThread) {
+		std::cerr << "--physics-thread is ignored headless, the ticks already run back to back" << std::endl;
+	}
+
+	HeadlessSimulation simulation;
+	if (!simulation.Load(config.physics)) {
+		return -1;
+	}
+	int spawned = simulation.SpawnAgents(config.agents, config.seed, config.agentSpeed);
+	if (spawned < config.agents) {
+		std::cerr << "Only " << spawned << " of " << config.agents << " agents found a free spot" << std::endl;
+	}
+	simulation.Run(config);
+	return 0;
+}
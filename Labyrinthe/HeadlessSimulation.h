@@ -0,0 +1,105 @@
+#ifndef BULLETOPENGL_HEADLESSSIMULATION_H
+#define BULLETOPENGL_HEADLESSSIMULATION_H
+
+#include <vector>
+#include <string>
+#include <random>
+
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <glm/glm.hpp>
+
+#include "PhysicsBackend.h"
+#include "MazePhysics.h"
+#include "CharacterController.h"
+#include "MeshChunker.h"
+
+// what a headless run simulates, and for how long
+struct HeadlessConfig {
+	int agents;            // character controllers wandering the maze
+	long long ticks;       // stop after this many ticks, 0 = no limit
+	double seconds;        // or after this much real time, 0 = no limit
+	double reportSeconds;  // ticks per second printed this often
+	unsigned int seed;     // spawn points and walk directions
+	float agentSpeed;      // units per second
+	PhysicsConfig physics;
+
+	HeadlessConfig() : agents(1000), ticks(0), seconds(10.0), reportSeconds(1.0), seed(1), agentSpeed(3.0f) {}
+
+	// --agents <n>, --ticks <n>, --seconds <s>, --report <s>, --seed <n>,
+	// --agent-speed <units/s> and the --physics-* options of PhysicsConfig
+	static HeadlessConfig FromArgs(int argc, char* argv[]);
+};
+
+// a mesh kept on the CPU: the interleaved vertices of ObjLoader, cut into
+// the same chunks the renderer would draw
+struct CpuMesh {
+	std::vector<float> vertices;
+	std::vector<MeshChunk> chunks;
+	AABB bounds;
+};
+
+// The maze simulation without a window or GL context, for the CI boxes and
+// simulation servers. The meshes load into CPU buffers (the agent size
+// comes from its model, like in the windowed game), the maze physics from
+// the baked .bullet file or the collider OBJ, and the agents are the same
+// character controllers the game uses.
+//
+// Ticks run back to back, as fast as the machine goes, with the fixed step
+// of the physics config. Each tick runs the agent logic (turn away from the
+// wall it ran into), steps the world, then hands the agents to the render
+// stub, which only fills the model matrices the renderer would upload.
+class HeadlessSimulation {
+public:
+	HeadlessSimulation();
+	~HeadlessSimulation();
+
+	// the meshes and the maze physics, then the world. False when a file is missing
+	bool Load(const PhysicsConfig& physics);
+	// 'count' agents on free spots of the maze floor, returns how many fit
+	int SpawnAgents(int count, unsigned int seed, float speed);
+	void RemoveAgents();
+
+	// agent logic, one fixed step of the world, then the render stub
+	void Tick();
+	// ticks until the config's limits, printing the rate every reportSeconds
+	void Run(const HeadlessConfig& config);
+
+	// what the renderer would get: one model matrix per agent
+	const std::vector<glm::mat4>& GetAgentMatrices() const { return m_agentMatrices; }
+	int GetAgentCount() const { return (int)m_agents.size(); }
+	unsigned long long GetTickCount() const { return m_ticks; }
+	btDiscreteDynamicsWorld* GetWorld() const { return m_pWorld; }
+	const MazePhysics& GetMaze() const { return m_maze; }
+
+private:
+	static bool LoadMesh(const std::string& objPath, CpuMesh& mesh);
+	// a new random walk direction
+	void Steer(CharacterController* pAgent);
+	// stands in for RenderScene: the agents' model matrices, nothing drawn
+	void RenderStub();
+
+	CpuMesh m_mazeMesh;
+	CpuMesh m_agentMesh;
+	CpuMesh m_groundMesh;
+
+	PhysicsBackend m_physics;
+	btDiscreteDynamicsWorld* m_pWorld;
+	MazePhysics m_maze;
+	float m_stepSize;
+
+	// the agents share one cylinder around the agent model
+	btCylinderShape* m_pAgentShape;
+	glm::vec3 m_agentCenter;
+	std::vector<CharacterController*> m_agents;
+	std::mt19937 m_random;
+	float m_agentSpeed;
+
+	std::vector<glm::mat4> m_agentMatrices;
+	unsigned long long m_ticks;
+};
+
+// the --headless entry point of main: a HeadlessSimulation from the
+// command line, no window is ever created
+int runHeadless(int argc, char* argv[]);
+
+#endif //BULLETOPENGL_HEADLESSSIMULATION_H
@@ -0,0 +1,351 @@
+#include "MazePhysics.h"
+
+#include <Bullet/Serialize/BulletWorldImporter/btBulletWorldImporter.h>
+#include <Bullet/Serialize/BulletFileLoader/btBulletFile.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// the walls chunk of the .bullet file, five ints per wall
+static const int WALL_CHUNK_CODE = BT_MAKE_ID('W', 'A', 'L', 'L');
+static const int WALL_CHUNK_INTS = 5;
+// the source chunk: size and modification time of the collider OBJ, in 32 bit halves
+static const int SOURCE_CHUNK_CODE = BT_MAKE_ID('S', 'R', 'C', 'E');
+static const int SOURCE_CHUNK_INTS = 4;
+
+// size and modification time of a file, false if it can't be read
+static bool GetSourceStamp(const std::string& path, long long& size, long long& time) {
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0) return false;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) return false;
+#endif
+	size = (long long)info.st_size;
+	time = (long long)info.st_mtime;
+	return true;
+}
+
+// the importer doesn't know the walls chunk, it is only kept in the chunks of the file
+class MazeBulletFile : public bParse::btBulletFile {
+public:
+	explicit MazeBulletFile(const char* path) : bParse::btBulletFile(path) {}
+
+	// data of the first chunk with this code, null if there is none
+	const void* FindChunk(int code, int& count) {
+		for (int i = 0; i < m_chunks.size(); ++i) {
+			if (m_chunks[i].code == code) {
+				// parse() replaced the saved pointers with the loaded data
+				count = m_chunks[i].nr;
+				return m_chunks[i].oldPtr;
+			}
+		}
+		return nullptr;
+	}
+};
+
+MazePhysics::MazePhysics() :
+	m_pMeshArray(nullptr),
+	m_pMazeShape(nullptr),
+	m_pMazeObject(nullptr),
+	m_pGroundShape(nullptr),
+	m_pGroundObject(nullptr),
+	m_pImporter(nullptr),
+	m_pBodyShape(nullptr)
+{
+}
+
+MazePhysics::~MazePhysics() {
+	// the caller removes the objects from its world before deleting it
+	for (size_t i = 0; i < m_bodies.size(); ++i) {
+		delete m_bodies[i]->getMotionState();
+		delete m_bodies[i];
+	}
+	delete m_pBodyShape;
+	Clear();
+}
+
+void MazePhysics::Clear() {
+	if (m_pImporter) {
+		// loaded: the shapes, mesh and objects are the importer's
+		m_pImporter->deleteAllData();
+		delete m_pImporter;
+		m_pImporter = nullptr;
+	}
+	else {
+		delete m_pGroundObject;
+		delete m_pGroundShape;
+		delete m_pMazeObject;
+		delete m_pMazeShape;
+		delete m_pMeshArray;
+	}
+	m_pMeshArray = nullptr;
+	m_pMazeShape = nullptr;
+	m_pMazeObject = nullptr;
+	m_pGroundShape = nullptr;
+	m_pGroundObject = nullptr;
+
+	m_vertices.clear();
+	m_indices.clear();
+	m_wallParts.clear();
+	m_triangleWalls.clear();
+	m_bounds = AABB();
+}
+
+bool MazePhysics::Build(const std::vector<Mesh>& colliders, const glm::mat4& transform) {
+	Clear();
+
+	// same parsing as the visibility bake: "v" lines and 1-based face values per group
+	for (size_t c = 0; c < colliders.size(); ++c) {
+		const Mesh& mesh = colliders[c];
+		WallPart part;
+		part.collider = (int)c;
+		part.firstIndex = (int)m_indices.size();
+		part.firstVertex = (int)m_vertices.size();
+
+		for (const std::string& line : mesh.data) {
+			if (line.substr(0, 2) == "v ") {
+				std::istringstream iss(line.substr(2));
+				glm::vec3 v;
+				iss >> v.x >> v.y >> v.z;
+				glm::vec3 world = glm::vec3(transform * glm::vec4(v, 1.0f));
+				m_vertices.push_back(btVector3(world.x, world.y, world.z));
+				m_bounds.Extend(world);
+			}
+		}
+		part.vertexCount = (int)m_vertices.size() - part.firstVertex;
+
+		for (size_t i = 0; i + 2 < mesh.facesValues.size(); i += 3) {
+			int i0 = mesh.facesValues[i] - 1, i1 = mesh.facesValues[i + 1] - 1, i2 = mesh.facesValues[i + 2] - 1;
+			if (i0 < 0 || i1 < 0 || i2 < 0 || i0 >= part.vertexCount || i1 >= part.vertexCount || i2 >= part.vertexCount) {
+				continue;
+			}
+			m_indices.push_back(part.firstVertex + i0);
+			m_indices.push_back(part.firstVertex + i1);
+			m_indices.push_back(part.firstVertex + i2);
+			m_triangleWalls.push_back((int)m_wallParts.size());
+		}
+		part.triangleCount = ((int)m_indices.size() - part.firstIndex) / 3;
+
+		if (part.triangleCount > 0) {
+			m_wallParts.push_back(part);
+		}
+		else {
+			m_vertices.resize(part.firstVertex);
+		}
+	}
+
+	if (m_wallParts.empty()) {
+		std::cerr << "Error: no walls found to build the maze collision mesh" << std::endl;
+		return false;
+	}
+
+	// the arrays are complete, they won't move anymore. A single mesh
+	// part: the quantized BVH only has 10 bits for the part index, far
+	// fewer than the walls, so the wall of a triangle comes from m_triangleWalls
+	m_pMeshArray = new btTriangleIndexVertexArray();
+	btIndexedMesh indexedMesh;
+	indexedMesh.m_numTriangles = (int)m_triangleWalls.size();
+	indexedMesh.m_triangleIndexBase = (const unsigned char*)&m_indices[0];
+	indexedMesh.m_triangleIndexStride = 3 * sizeof(int);
+	indexedMesh.m_numVertices = m_vertices.size();
+	indexedMesh.m_vertexBase = (const unsigned char*)&m_vertices[0];
+	indexedMesh.m_vertexStride = sizeof(btVector3);
+#ifdef BT_USE_DOUBLE_PRECISION
+	indexedMesh.m_vertexType = PHY_DOUBLE;
+#else
+	indexedMesh.m_vertexType = PHY_FLOAT;
+#endif
+	m_pMeshArray->addIndexedMesh(indexedMesh, PHY_INTEGER);
+	m_pMazeShape = new btBvhTriangleMeshShape(m_pMeshArray, true);
+
+	m_pMazeObject = new btCollisionObject();
+	m_pMazeObject->setCollisionShape(m_pMazeShape);
+	m_pMazeObject->setCollisionFlags(btCollisionObject::CF_STATIC_OBJECT);
+	// like addRigidBody does for static bodies: pairs with other inactive objects are skipped
+	m_pMazeObject->setActivationState(ISLAND_SLEEPING);
+
+	// the ground is a thick box whose top is the floor of the maze
+	glm::vec3 center = m_bounds.GetCenter(), extents = m_bounds.GetExtents();
+	m_pGroundShape = new btBoxShape(btVector3(extents.x + 10.0f, 1.0f, extents.z + 10.0f));
+	m_pGroundObject = new btCollisionObject();
+	m_pGroundObject->setCollisionShape(m_pGroundShape);
+	m_pGroundObject->setCollisionFlags(btCollisionObject::CF_STATIC_OBJECT);
+	m_pGroundObject->setActivationState(ISLAND_SLEEPING);
+	m_pGroundObject->setWorldTransform(btTransform(btQuaternion::getIdentity(), btVector3(center.x, m_bounds.min.y - 1.0f, center.z)));
+	return true;
+}
+
+bool MazePhysics::Save(const std::string& path, const std::string& sourcePath) const {
+	if (!m_pMazeObject) return false;
+	long long sourceSize, sourceTime;
+	if (!GetSourceStamp(sourcePath, sourceSize, sourceTime)) {
+		std::cerr << "Error: Failed to read " << sourcePath << std::endl;
+		return false;
+	}
+
+	// the objects are found by name when loading
+	btDefaultSerializer serializer;
+	serializer.registerNameForPointer(m_pMazeObject, "maze");
+	serializer.registerNameForPointer(m_pGroundObject, "ground");
+	serializer.startSerialization();
+	// the mesh shape writes its vertices, indices and BVH
+	m_pMazeShape->serializeSingleShape(&serializer);
+	m_pGroundShape->serializeSingleShape(&serializer);
+	m_pMazeObject->serializeSingleObject(&serializer);
+	m_pGroundObject->serializeSingleObject(&serializer);
+
+	btChunk* pChunk = serializer.allocate(sizeof(btIntIndexData), (int)m_wallParts.size() * WALL_CHUNK_INTS);
+	btIntIndexData* pWalls = (btIntIndexData*)pChunk->m_oldPtr;
+	for (size_t i = 0; i < m_wallParts.size(); ++i) {
+		const WallPart& part = m_wallParts[i];
+		pWalls[i * WALL_CHUNK_INTS + 0].m_value = part.collider;
+		pWalls[i * WALL_CHUNK_INTS + 1].m_value = part.firstIndex;
+		pWalls[i * WALL_CHUNK_INTS + 2].m_value = part.triangleCount;
+		pWalls[i * WALL_CHUNK_INTS + 3].m_value = part.firstVertex;
+		pWalls[i * WALL_CHUNK_INTS + 4].m_value = part.vertexCount;
+	}
+	serializer.finalizeChunk(pChunk, "btIntIndexData", WALL_CHUNK_CODE, (void*)&m_wallParts[0]);
+
+	int stamp[SOURCE_CHUNK_INTS] = { (int)(sourceSize & 0xffffffff), (int)(sourceSize >> 32), (int)(sourceTime & 0xffffffff), (int)(sourceTime >> 32) };
+	pChunk = serializer.allocate(sizeof(btIntIndexData), SOURCE_CHUNK_INTS);
+	btIntIndexData* pStamp = (btIntIndexData*)pChunk->m_oldPtr;
+	for (int i = 0; i < SOURCE_CHUNK_INTS; ++i) {
+		pStamp[i].m_value = stamp[i];
+	}
+	serializer.finalizeChunk(pChunk, "btIntIndexData", SOURCE_CHUNK_CODE, (void*)stamp);
+	serializer.finishSerialization();
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "Error: Failed to write " << path << std::endl;
+		return false;
+	}
+	file.write((const char*)serializer.getBufferPointer(), serializer.getCurrentBufferSize());
+	return file.good();
+}
+
+bool MazePhysics::Load(const std::string& path, const std::string& sourcePath) {
+	MazeBulletFile file(path.c_str());
+	if (!file.ok()) {
+		std::cerr << "Error: Failed to read " << path << std::endl;
+		return false;
+	}
+	// no world: the objects are added by AddToWorld like built ones
+	btBulletWorldImporter* pImporter = new btBulletWorldImporter(nullptr);
+	btCollisionObject* pMazeObject = nullptr;
+	btCollisionObject* pGroundObject = nullptr;
+	const btIntIndexData* pWalls = nullptr;
+	const btIntIndexData* pStamp = nullptr;
+	int wallInts = 0, stampInts = 0;
+	if (pImporter->loadFileFromMemory(&file)) {
+		// the importer makes static rigid bodies of collision objects
+		pMazeObject = pImporter->getRigidBodyByName("maze");
+		pGroundObject = pImporter->getRigidBodyByName("ground");
+		pWalls = (const btIntIndexData*)file.FindChunk(WALL_CHUNK_CODE, wallInts);
+		pStamp = (const btIntIndexData*)file.FindChunk(SOURCE_CHUNK_CODE, stampInts);
+	}
+	if (!pMazeObject || !pGroundObject || !pWalls || wallInts == 0 || wallInts % WALL_CHUNK_INTS != 0
+		|| pMazeObject->getCollisionShape()->getShapeType() != TRIANGLE_MESH_SHAPE_PROXYTYPE) {
+		std::cerr << "Error: " << path << " is not a baked maze" << std::endl;
+		pImporter->deleteAllData();
+		delete pImporter;
+		return false;
+	}
+
+	// baked from another version of the collider OBJ, or before the stamp was saved
+	long long sourceSize, sourceTime;
+	bool upToDate = pStamp && stampInts == SOURCE_CHUNK_INTS && GetSourceStamp(sourcePath, sourceSize, sourceTime)
+		&& (((long long)pStamp[1].m_value << 32) | (unsigned int)pStamp[0].m_value) == sourceSize
+		&& (((long long)pStamp[3].m_value << 32) | (unsigned int)pStamp[2].m_value) == sourceTime;
+	if (!upToDate) {
+		std::cerr << path << " is out of date with " << sourcePath << ", bake it again with --bake physics" << std::endl;
+		pImporter->deleteAllData();
+		delete pImporter;
+		return false;
+	}
+
+	Clear();
+	for (int i = 0; i < wallInts; i += WALL_CHUNK_INTS) {
+		WallPart part;
+		part.collider = pWalls[i + 0].m_value;
+		part.firstIndex = pWalls[i + 1].m_value;
+		part.triangleCount = pWalls[i + 2].m_value;
+		part.firstVertex = pWalls[i + 3].m_value;
+		part.vertexCount = pWalls[i + 4].m_value;
+		// the parts follow each other in the index array
+		m_triangleWalls.resize(part.firstIndex / 3 + part.triangleCount, -1);
+		std::fill(m_triangleWalls.begin() + part.firstIndex / 3, m_triangleWalls.end(), (int)m_wallParts.size());
+		m_wallParts.push_back(part);
+	}
+
+	m_pImporter = pImporter;
+	m_pMazeObject = pMazeObject;
+	m_pMazeShape = (btBvhTriangleMeshShape*)pMazeObject->getCollisionShape();
+	m_pGroundObject = pGroundObject;
+	m_pGroundShape = pGroundObject->getCollisionShape();
+	// flags and activation aren't in the importer's objects
+	m_pMazeObject->setCollisionFlags(btCollisionObject::CF_STATIC_OBJECT);
+	m_pMazeObject->setActivationState(ISLAND_SLEEPING);
+	m_pGroundObject->setCollisionFlags(btCollisionObject::CF_STATIC_OBJECT);
+	m_pGroundObject->setActivationState(ISLAND_SLEEPING);
+
+	btVector3 aabbMin, aabbMax;
+	m_pMazeShape->getMeshInterface()->calculateAabbBruteForce(aabbMin, aabbMax);
+	m_bounds = AABB();
+	m_bounds.Extend(glm::vec3(aabbMin.x(), aabbMin.y(), aabbMin.z()));
+	m_bounds.Extend(glm::vec3(aabbMax.x(), aabbMax.y(), aabbMax.z()));
+	return true;
+}
+
+void MazePhysics::AddToWorld(btDynamicsWorld* pWorld) {
+	if (!m_pMazeObject) return;
+	pWorld->addCollisionObject(m_pMazeObject, btBroadphaseProxy::StaticFilter, btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter);
+	pWorld->addCollisionObject(m_pGroundObject, btBroadphaseProxy::StaticFilter, btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter);
+}
+
+void MazePhysics::RemoveFromWorld(btDynamicsWorld* pWorld) {
+	if (!m_pMazeObject) return;
+	pWorld->removeCollisionObject(m_pMazeObject);
+	pWorld->removeCollisionObject(m_pGroundObject);
+}
+
+void MazePhysics::AddBodies(btDynamicsWorld* pWorld, int count, float radius, float mass) {
+	if (!m_pBodyShape) {
+		m_pBodyShape = new btSphereShape(radius);
+	}
+	btVector3 inertia(0.0f, 0.0f, 0.0f);
+	m_pBodyShape->calculateLocalInertia(mass, inertia);
+
+	// a regular grid over the maze, stacked in layers above the walls
+	float spacing = radius * 3.0f;
+	int columns = std::max(1, (int)((m_bounds.max.x - m_bounds.min.x) / spacing));
+	int rows = std::max(1, (int)((m_bounds.max.z - m_bounds.min.z) / spacing));
+	for (int i = 0; i < count; ++i) {
+		int cell = i % (columns * rows), layer = i / (columns * rows);
+		btVector3 position(m_bounds.min.x + (cell % columns + 0.5f) * spacing,
+			m_bounds.max.y + radius + layer * spacing,
+			m_bounds.min.z + (cell / columns + 0.5f) * spacing);
+
+		btDefaultMotionState* pMotionState = new btDefaultMotionState(btTransform(btQuaternion::getIdentity(), position));
+		btRigidBody::btRigidBodyConstructionInfo info(mass, pMotionState, m_pBodyShape, inertia);
+		btRigidBody* pBody = new btRigidBody(info);
+		pWorld->addRigidBody(pBody);
+		m_bodies.push_back(pBody);
+	}
+}
+
+void MazePhysics::RemoveBodies(btDynamicsWorld* pWorld) {
+	for (size_t i = 0; i < m_bodies.size(); ++i) {
+		pWorld->removeRigidBody(m_bodies[i]);
+		delete m_bodies[i]->getMotionState();
+		delete m_bodies[i];
+	}
+	m_bodies.clear();
+}
@@ -0,0 +1,97 @@
+#ifndef BULLETOPENGL_MAZEPHYSICS_H
+#define BULLETOPENGL_MAZEPHYSICS_H
+
+#include <vector>
+#include <string>
+
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "Frustum.h"
+
+class btBulletWorldImporter;
+
+// the static collision geometry of the maze, plus dynamic bodies to fill it.
+// All the collider walls (from ObjWGroupsLoader) go into one triangle mesh,
+// and every triangle remembers its wall, so contacts and ray hits tell which
+// wall they touch (GetWallOfTriangle with LocalShapeInfo::m_triangleIndex).
+// A box under the maze stands for the ground.
+//
+// Used by the physics benchmarks and anything that needs the maze without
+// the rendering side.
+//
+// The built maze can be saved to a .bullet file: the mesh with its BVH, the
+// maze and ground objects, and the walls in a chunk of their own. Loading
+// it goes through btBulletWorldImporter, which keeps the BVH as it was
+// saved instead of building it again from the collider OBJ. The file keeps
+// the size and modification time of that OBJ, and Load refuses it once the
+// OBJ has changed so the caller builds the maze again.
+class MazePhysics {
+public:
+	MazePhysics();
+	~MazePhysics();
+
+	// build the wall mesh from the collider groups, in world space. Replaces
+	// the maze built or loaded before, which must be out of the world
+	bool Build(const std::vector<Mesh>& colliders, const glm::mat4& transform);
+
+	// the built maze to a .bullet file, and back in place of Build. sourcePath
+	// is the collider OBJ it was built from, Load fails when it changed since
+	bool Save(const std::string& path, const std::string& sourcePath) const;
+	bool Load(const std::string& path, const std::string& sourcePath);
+
+	// static maze and ground objects
+	void AddToWorld(btDynamicsWorld* pWorld);
+	void RemoveFromWorld(btDynamicsWorld* pWorld);
+
+	// 'count' spheres spread in layers above the maze, they fall into the corridors
+	void AddBodies(btDynamicsWorld* pWorld, int count, float radius = 0.25f, float mass = 1.0f);
+	void RemoveBodies(btDynamicsWorld* pWorld);
+	const std::vector<btRigidBody*>& GetBodies() const { return m_bodies; }
+
+	int GetWallCount() const { return (int)m_wallParts.size(); }
+	// wall of a triangle of the maze shape, -1 if out of range
+	int GetWallOfTriangle(int triangle) const { return triangle >= 0 && triangle < (int)m_triangleWalls.size() ? m_triangleWalls[triangle] : -1; }
+	// index in the collider list of a wall, -1 if out of range
+	int GetColliderIndex(int wall) const { return wall >= 0 && wall < (int)m_wallParts.size() ? m_wallParts[wall].collider : -1; }
+	// world bounds of the walls
+	const AABB& GetBounds() const { return m_bounds; }
+	float GetWallTop() const { return m_bounds.max.y; }
+	float GetFloorHeight() const { return m_bounds.min.y; }
+
+	btCollisionObject* GetMazeObject() const { return m_pMazeObject; }
+	btCollisionObject* GetGroundObject() const { return m_pGroundObject; }
+
+private:
+	// delete the maze mesh, shapes and objects
+	void Clear();
+
+	struct WallPart {
+		int collider;
+		int firstIndex;
+		int triangleCount;
+		int firstVertex;
+		int vertexCount;
+	};
+
+	btAlignedObjectArray<btVector3> m_vertices;
+	std::vector<int> m_indices;
+	std::vector<WallPart> m_wallParts;
+	std::vector<int> m_triangleWalls;
+	AABB m_bounds;
+
+	btTriangleIndexVertexArray* m_pMeshArray;
+	btBvhTriangleMeshShape* m_pMazeShape;
+	btCollisionObject* m_pMazeObject;
+	btCollisionShape* m_pGroundShape;
+	btCollisionObject* m_pGroundObject;
+
+	// owns the objects above when the maze was loaded
+	btBulletWorldImporter* m_pImporter;
+
+	btCollisionShape* m_pBodyShape;
+	std::vector<btRigidBody*> m_bodies;
+};
+
+#endif //BULLETOPENGL_MAZEPHYSICS_H
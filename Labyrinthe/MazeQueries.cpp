@@ -0,0 +1,135 @@
+#include "MazeQueries.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// the closest hit, and the maze triangle it is on
+class ClosestTriangleRayCallback : public btCollisionWorld::ClosestRayResultCallback {
+public:
+	ClosestTriangleRayCallback(const btVector3& from, const btVector3& to) : ClosestRayResultCallback(from, to), m_triangle(-1) {}
+
+	virtual btScalar addSingleResult(btCollisionWorld::LocalRayResult& rayResult, bool normalInWorldSpace) {
+		// only called with hits closer than the last one
+		m_triangle = rayResult.m_localShapeInfo ? rayResult.m_localShapeInfo->m_triangleIndex : -1;
+		return ClosestRayResultCallback::addSingleResult(rayResult, normalInWorldSpace);
+	}
+
+	int m_triangle;
+};
+
+class ClosestTriangleConvexCallback : public btCollisionWorld::ClosestConvexResultCallback {
+public:
+	ClosestTriangleConvexCallback(const btVector3& from, const btVector3& to) : ClosestConvexResultCallback(from, to), m_triangle(-1) {}
+
+	virtual btScalar addSingleResult(btCollisionWorld::LocalConvexResult& convexResult, bool normalInWorldSpace) {
+		m_triangle = convexResult.m_localShapeInfo ? convexResult.m_localShapeInfo->m_triangleIndex : -1;
+		return ClosestConvexResultCallback::addSingleResult(convexResult, normalInWorldSpace);
+	}
+
+	int m_triangle;
+};
+
+MazeQueries::MazeQueries(const MazePhysics& maze, int threads) :
+	m_maze(maze),
+	m_threads(1),
+	m_blockSize(256)
+{
+	SetThreadCount(threads);
+}
+
+void MazeQueries::SetThreadCount(int threads) {
+	m_threads = threads > 0 ? threads : std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+template <typename Body>
+void MazeQueries::ParallelFor(int count, const Body& body) const {
+	int blocks = (count + m_blockSize - 1) / m_blockSize;
+	int threads = std::min(m_threads, blocks);
+	if (threads <= 1) {
+		body(0, count);
+		return;
+	}
+
+	// the threads take the next block until none is left
+	std::atomic<int> next(0);
+	auto work = [&]() {
+		for (int block = next++; block < blocks; block = next++) {
+			body(block * m_blockSize, std::min(count, (block + 1) * m_blockSize));
+		}
+	};
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threads; ++i) {
+		workers.push_back(std::thread(work));
+	}
+	work();
+	for (size_t i = 0; i < workers.size(); ++i) {
+		workers[i].join();
+	}
+}
+
+void MazeQueries::RayTest(const btVector3* from, const btVector3* to, int count, const MazeQueryResults& results) const {
+	ParallelFor(count, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			CastRay(from[i], to[i], i, results);
+		}
+	});
+}
+
+void MazeQueries::ConvexSweep(const btConvexShape* pShape, const btTransform* from, const btTransform* to, int count,
+	const MazeQueryResults& results) const {
+	ParallelFor(count, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			CastShape(pShape, from[i], to[i], i, results);
+		}
+	});
+}
+
+void MazeQueries::CastRay(const btVector3& from, const btVector3& to, int index, const MazeQueryResults& results) const {
+	btTransform fromTransform(btQuaternion::getIdentity(), from);
+	btTransform toTransform(btQuaternion::getIdentity(), to);
+	ClosestTriangleRayCallback callback(from, to);
+
+	// the ground only counts where it is closer than the walls
+	btCollisionObject* pMaze = m_maze.GetMazeObject();
+	btCollisionObject* pGround = m_maze.GetGroundObject();
+	btCollisionWorld::rayTestSingle(fromTransform, toTransform, pMaze, pMaze->getCollisionShape(), pMaze->getWorldTransform(), callback);
+	if (pGround) {
+		btCollisionWorld::rayTestSingle(fromTransform, toTransform, pGround, pGround->getCollisionShape(), pGround->getWorldTransform(), callback);
+	}
+
+	bool hit = callback.hasHit();
+	if (results.distances) {
+		results.distances[index] = hit ? callback.m_closestHitFraction * (to - from).length() : -1.0f;
+	}
+	if (results.normals) {
+		results.normals[index] = hit ? callback.m_hitNormalWorld : btVector3(0.0f, 0.0f, 0.0f);
+	}
+	if (results.walls) {
+		results.walls[index] = hit && callback.m_collisionObject == pMaze ? m_maze.GetWallOfTriangle(callback.m_triangle) : -1;
+	}
+}
+
+void MazeQueries::CastShape(const btConvexShape* pShape, const btTransform& from, const btTransform& to, int index,
+	const MazeQueryResults& results) const {
+	ClosestTriangleConvexCallback callback(from.getOrigin(), to.getOrigin());
+
+	btCollisionObject* pMaze = m_maze.GetMazeObject();
+	btCollisionObject* pGround = m_maze.GetGroundObject();
+	btCollisionWorld::objectQuerySingle(pShape, from, to, pMaze, pMaze->getCollisionShape(), pMaze->getWorldTransform(), callback, 0.0f);
+	if (pGround) {
+		btCollisionWorld::objectQuerySingle(pShape, from, to, pGround, pGround->getCollisionShape(), pGround->getWorldTransform(), callback, 0.0f);
+	}
+
+	bool hit = callback.hasHit();
+	if (results.distances) {
+		results.distances[index] = hit ? callback.m_closestHitFraction * (to.getOrigin() - from.getOrigin()).length() : -1.0f;
+	}
+	if (results.normals) {
+		results.normals[index] = hit ? callback.m_hitNormalWorld : btVector3(0.0f, 0.0f, 0.0f);
+	}
+	if (results.walls) {
+		results.walls[index] = hit && callback.m_hitCollisionObject == pMaze ? m_maze.GetWallOfTriangle(callback.m_triangle) : -1;
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef BULLETOPENGL_MAZEQUERIES_H
+#define BULLETOPENGL_MAZEQUERIES_H
+
+#include <Bullet/btBulletCollisionCommon.h>
+
+#include "MazePhysics.h"
+
+// where a batch of queries writes its results, one entry per query. The
+// arrays belong to the caller, and any of them can be null when it isn't
+// needed
+struct MazeQueryResults {
+	float* distances;   // from the start to the hit, -1 when nothing is hit
+	btVector3* normals; // world space normal at the hit
+	int* walls;         // MazePhysics wall that was hit, -1 for the ground or no hit
+
+	MazeQueryResults() : distances(nullptr), normals(nullptr), walls(nullptr) {}
+	MazeQueryResults(float* pDistances, btVector3* pNormals, int* pWalls) : distances(pDistances), normals(pNormals), walls(pWalls) {}
+};
+
+// Batched rays and convex sweeps against the maze, for the AI and the
+// agents' sensors (thousands of queries per call).
+//
+// The queries go straight to the maze objects with the BVH of the wall
+// mesh (btCollisionWorld::rayTestSingle / objectQuerySingle), without the
+// broadphase or the world: only the maze and the ground are hit, never the
+// agents or the bodies. Nothing is written to the shapes during a query,
+// so the batch is split into blocks that worker threads take in turn; the
+// calling thread works too. The maze must not change during a call.
+class MazeQueries {
+public:
+	// threads 0 uses one per hardware thread
+	explicit MazeQueries(const MazePhysics& maze, int threads = 0);
+
+	void SetThreadCount(int threads);
+	int GetThreadCount() const { return m_threads; }
+	// queries per block handed to a thread
+	void SetBlockSize(int queries) { m_blockSize = queries > 0 ? queries : 1; }
+
+	// ray i from from[i] to to[i], the closest hit
+	void RayTest(const btVector3* from, const btVector3* to, int count, const MazeQueryResults& results) const;
+
+	// the convex shape moved from from[i] to to[i], the first contact. The
+	// distance is how far its origin goes before it touches
+	void ConvexSweep(const btConvexShape* pShape, const btTransform* from, const btTransform* to, int count,
+		const MazeQueryResults& results) const;
+
+private:
+	// runs body(begin, end) over [0, count) in blocks, on m_threads threads
+	template <typename Body>
+	void ParallelFor(int count, const Body& body) const;
+
+	void CastRay(const btVector3& from, const btVector3& to, int index, const MazeQueryResults& results) const;
+	void CastShape(const btConvexShape* pShape, const btTransform& from, const btTransform& to, int index,
+		const MazeQueryResults& results) const;
+
+	const MazePhysics& m_maze;
+	int m_threads;
+	int m_blockSize;
+};
+
+#endif //BULLETOPENGL_MAZEQUERIES_H
@@ -0,0 +1,353 @@
+#include "MazeVisibility.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+// size of the uniform grid used to find the walls crossed by a ray while baking
+#define WALL_GRID_CELL_SIZE 1.0f
+
+// sample points per cell axis. Each cell pair is tested with up to
+// PVS_SAMPLES^4 rays, and is visible as soon as one of them is unblocked
+#define PVS_SAMPLES 5
+
+static const char PVS_MAGIC[4] = { 'P', 'V', 'S', '1' };
+
+static float cross2(const glm::vec2& a, const glm::vec2& b) {
+	return a.x * b.y - a.y * b.x;
+}
+
+MazeVisibility::MazeVisibility() :
+	m_columns(0),
+	m_rows(0),
+	m_cellSize(1.0f),
+	m_origin(0.0f),
+	m_wallTop(0.0f),
+	m_rowBytes(0),
+	m_worldToModel(1.0f),
+	m_wallGridColumns(0),
+	m_wallGridRows(0),
+	m_wallGridCellSize(WALL_GRID_CELL_SIZE)
+{
+}
+
+void MazeVisibility::SetTransform(const glm::mat4& transform) {
+	m_worldToModel = glm::inverse(transform);
+}
+
+void MazeVisibility::Bake(const std::vector<Mesh>& colliders, float cellSize) {
+	m_walls.clear();
+	m_cellSize = cellSize;
+
+	glm::vec2 minBounds(FLT_MAX), maxBounds(-FLT_MAX);
+	m_wallTop = -FLT_MAX;
+
+	// every vertical triangle of the colliders becomes a wall segment on the XZ plane
+	for (const Mesh& mesh : colliders) {
+		std::vector<glm::vec3> vertices;
+		for (const std::string& line : mesh.data) {
+			if (line.substr(0, 2) == "v ") {
+				std::istringstream iss(line.substr(2));
+				glm::vec3 v;
+				iss >> v.x >> v.y >> v.z;
+				vertices.push_back(v);
+
+				minBounds = glm::min(minBounds, glm::vec2(v.x, v.z));
+				maxBounds = glm::max(maxBounds, glm::vec2(v.x, v.z));
+				m_wallTop = std::max(m_wallTop, v.y);
+			}
+		}
+
+		// face values are 1-based indices into the mesh's own vertices
+		for (size_t i = 0; i + 2 < mesh.facesValues.size(); i += 3) {
+			int i0 = mesh.facesValues[i] - 1, i1 = mesh.facesValues[i + 1] - 1, i2 = mesh.facesValues[i + 2] - 1;
+			if (i0 < 0 || i1 < 0 || i2 < 0 || i0 >= (int)vertices.size() || i1 >= (int)vertices.size() || i2 >= (int)vertices.size()) {
+				continue;
+			}
+			const glm::vec3& p0 = vertices[i0];
+			const glm::vec3& p1 = vertices[i1];
+			const glm::vec3& p2 = vertices[i2];
+
+			// skip the horizontal faces (tops of the walls)
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(normal);
+			if (length <= 0.0f || std::fabs(normal.y) > 0.5f * length) {
+				continue;
+			}
+
+			// a vertical triangle projects to a segment, keep its two farthest points
+			glm::vec2 points[3] = { glm::vec2(p0.x, p0.z), glm::vec2(p1.x, p1.z), glm::vec2(p2.x, p2.z) };
+			WallSegment wall = { points[0], points[1] };
+			float best = glm::length(points[1] - points[0]);
+			if (glm::length(points[2] - points[0]) > best) { best = glm::length(points[2] - points[0]); wall.b = points[2]; }
+			if (glm::length(points[2] - points[1]) > best) { best = glm::length(points[2] - points[1]); wall.a = points[1]; wall.b = points[2]; }
+			if (best > 1e-4f) {
+				m_walls.push_back(wall);
+			}
+		}
+	}
+
+	if (m_walls.empty()) {
+		std::cerr << "Error: no walls found to bake the visibility" << std::endl;
+		m_columns = m_rows = 0;
+		return;
+	}
+
+	m_origin = minBounds;
+	m_columns = std::max(1, (int)std::ceil((maxBounds.x - minBounds.x) / cellSize));
+	m_rows = std::max(1, (int)std::ceil((maxBounds.y - minBounds.y) / cellSize));
+	int cellCount = m_columns * m_rows;
+	m_rowBytes = (cellCount + 7) / 8;
+
+	BuildWallGrid();
+
+	// test every pair once, spreading the source cells over the threads
+	std::vector<uint8_t> visible(cellCount * cellCount, 0);
+	std::atomic<int> nextCell(0);
+	unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < threadCount; ++t) {
+		threads.push_back(std::thread([&]() {
+			for (int a = nextCell++; a < cellCount; a = nextCell++) {
+				for (int b = a; b < cellCount; ++b) {
+					visible[a * cellCount + b] = AreCellsVisible(a, b) ? 1 : 0;
+				}
+			}
+		}));
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	// mirror the pairs, then grow every visible cell by its neighbours:
+	// point sampling can miss thin lines of sight
+	for (int a = 0; a < cellCount; ++a) {
+		for (int b = 0; b < a; ++b) {
+			visible[a * cellCount + b] = visible[b * cellCount + a];
+		}
+	}
+
+	m_bits.assign(cellCount * m_rowBytes, 0);
+	for (int a = 0; a < cellCount; ++a) {
+		for (int b = 0; b < cellCount; ++b) {
+			if (!visible[a * cellCount + b]) {
+				continue;
+			}
+			int column = b % m_columns, row = b / m_columns;
+			for (int y = std::max(0, row - 1); y <= std::min(m_rows - 1, row + 1); ++y) {
+				for (int x = std::max(0, column - 1); x <= std::min(m_columns - 1, column + 1); ++x) {
+					int neighbour = y * m_columns + x;
+					m_bits[a * m_rowBytes + (neighbour >> 3)] |= 1 << (neighbour & 7);
+				}
+			}
+		}
+	}
+
+	// the walls are not needed at runtime
+	m_walls.clear();
+	m_wallGrid.clear();
+}
+
+void MazeVisibility::BuildWallGrid() {
+	m_wallGridCellSize = WALL_GRID_CELL_SIZE;
+	m_wallGridColumns = (int)std::ceil(m_columns * m_cellSize / m_wallGridCellSize) + 1;
+	m_wallGridRows = (int)std::ceil(m_rows * m_cellSize / m_wallGridCellSize) + 1;
+	m_wallGrid.assign(m_wallGridColumns * m_wallGridRows, std::vector<int>());
+
+	// register every wall in all the grid cells its bounds touch
+	for (size_t i = 0; i < m_walls.size(); ++i) {
+		glm::vec2 minPoint = (glm::min(m_walls[i].a, m_walls[i].b) - m_origin) / m_wallGridCellSize;
+		glm::vec2 maxPoint = (glm::max(m_walls[i].a, m_walls[i].b) - m_origin) / m_wallGridCellSize;
+		int x0 = std::max(0, (int)std::floor(minPoint.x)), x1 = std::min(m_wallGridColumns - 1, (int)std::floor(maxPoint.x));
+		int y0 = std::max(0, (int)std::floor(minPoint.y)), y1 = std::min(m_wallGridRows - 1, (int)std::floor(maxPoint.y));
+		for (int y = y0; y <= y1; ++y) {
+			for (int x = x0; x <= x1; ++x) {
+				m_wallGrid[y * m_wallGridColumns + x].push_back((int)i);
+			}
+		}
+	}
+}
+
+bool MazeVisibility::IsSegmentBlocked(const glm::vec2& from, const glm::vec2& to) const {
+	glm::vec2 start = (from - m_origin) / m_wallGridCellSize;
+	glm::vec2 end = (to - m_origin) / m_wallGridCellSize;
+	glm::vec2 direction = end - start;
+
+	// walk the grid cells crossed by the segment (Amanatides & Woo)
+	int x = (int)std::floor(start.x), y = (int)std::floor(start.y);
+	int endX = (int)std::floor(end.x), endY = (int)std::floor(end.y);
+	int stepX = direction.x > 0 ? 1 : -1, stepY = direction.y > 0 ? 1 : -1;
+	float tDeltaX = direction.x != 0.0f ? std::fabs(1.0f / direction.x) : FLT_MAX;
+	float tDeltaY = direction.y != 0.0f ? std::fabs(1.0f / direction.y) : FLT_MAX;
+	float tMaxX = direction.x != 0.0f ? ((stepX > 0 ? x + 1 - start.x : start.x - x) * tDeltaX) : FLT_MAX;
+	float tMaxY = direction.y != 0.0f ? ((stepY > 0 ? y + 1 - start.y : start.y - y) * tDeltaY) : FLT_MAX;
+
+	glm::vec2 segment = to - from;
+	for (;;) {
+		if (x >= 0 && y >= 0 && x < m_wallGridColumns && y < m_wallGridRows) {
+			for (int wallIndex : m_wallGrid[y * m_wallGridColumns + x]) {
+				const WallSegment& wall = m_walls[wallIndex];
+				// proper segment/segment intersection, touching doesn't block
+				glm::vec2 wallDirection = wall.b - wall.a;
+				float d1 = cross2(wallDirection, from - wall.a);
+				float d2 = cross2(wallDirection, to - wall.a);
+				float d3 = cross2(segment, wall.a - from);
+				float d4 = cross2(segment, wall.b - from);
+				if (d1 * d2 < 0.0f && d3 * d4 < 0.0f) {
+					return true;
+				}
+			}
+		}
+
+		if (x == endX && y == endY) break;
+		if (tMaxX < tMaxY) {
+			if (tMaxX > 1.0f) break;
+			tMaxX += tDeltaX;
+			x += stepX;
+		}
+		else {
+			if (tMaxY > 1.0f) break;
+			tMaxY += tDeltaY;
+			y += stepY;
+		}
+	}
+	return false;
+}
+
+bool MazeVisibility::AreCellsVisible(int cellA, int cellB) const {
+	int columnA = cellA % m_columns, rowA = cellA / m_columns;
+	int columnB = cellB % m_columns, rowB = cellB / m_columns;
+
+	// a cell always sees itself and its neighbours, so nothing pops in
+	// right next to the camera
+	if (std::abs(columnA - columnB) <= 1 && std::abs(rowA - rowB) <= 1) {
+		return true;
+	}
+
+	// sample points inset from the cell borders, since walls usually lie on them
+	const float offsets[PVS_SAMPLES] = { 0.1f, 0.3f, 0.5f, 0.7f, 0.9f };
+	glm::vec2 cornerA = m_origin + glm::vec2(columnA, rowA) * m_cellSize;
+	glm::vec2 cornerB = m_origin + glm::vec2(columnB, rowB) * m_cellSize;
+
+	for (int ax = 0; ax < PVS_SAMPLES; ++ax) {
+		for (int ay = 0; ay < PVS_SAMPLES; ++ay) {
+			glm::vec2 from = cornerA + glm::vec2(offsets[ax], offsets[ay]) * m_cellSize;
+			for (int bx = 0; bx < PVS_SAMPLES; ++bx) {
+				for (int by = 0; by < PVS_SAMPLES; ++by) {
+					glm::vec2 to = cornerB + glm::vec2(offsets[bx], offsets[by]) * m_cellSize;
+					if (!IsSegmentBlocked(from, to)) {
+						return true;
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
+bool MazeVisibility::Save(const std::string& path) const {
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Error: could not write " << path << std::endl;
+		return false;
+	}
+
+	file.write(PVS_MAGIC, sizeof(PVS_MAGIC));
+	file.write((const char*)&m_columns, sizeof(m_columns));
+	file.write((const char*)&m_rows, sizeof(m_rows));
+	file.write((const char*)&m_cellSize, sizeof(m_cellSize));
+	file.write((const char*)&m_origin.x, sizeof(float));
+	file.write((const char*)&m_origin.y, sizeof(float));
+	file.write((const char*)&m_wallTop, sizeof(m_wallTop));
+	file.write((const char*)&m_bits[0], m_bits.size());
+	return file.good();
+}
+
+bool MazeVisibility::Load(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Error: could not open " << path << std::endl;
+		return false;
+	}
+
+	char magic[4];
+	int columns = 0, rows = 0;
+	file.read(magic, sizeof(magic));
+	file.read((char*)&columns, sizeof(columns));
+	file.read((char*)&rows, sizeof(rows));
+	file.read((char*)&m_cellSize, sizeof(m_cellSize));
+	file.read((char*)&m_origin.x, sizeof(float));
+	file.read((char*)&m_origin.y, sizeof(float));
+	file.read((char*)&m_wallTop, sizeof(m_wallTop));
+	if (!file || !std::equal(magic, magic + 4, PVS_MAGIC) || columns <= 0 || rows <= 0) {
+		std::cerr << "Error: " << path << " is not a valid visibility file" << std::endl;
+		return false;
+	}
+
+	int cellCount = columns * rows;
+	m_rowBytes = (cellCount + 7) / 8;
+	m_bits.resize(cellCount * m_rowBytes);
+	file.read((char*)&m_bits[0], m_bits.size());
+	if (!file) {
+		std::cerr << "Error: " << path << " is truncated" << std::endl;
+		m_columns = m_rows = 0;
+		return false;
+	}
+
+	m_columns = columns;
+	m_rows = rows;
+	return true;
+}
+
+int MazeVisibility::GetCell(const glm::vec3& worldPosition) const {
+	if (!IsLoaded()) return -1;
+
+	glm::vec3 local = glm::vec3(m_worldToModel * glm::vec4(worldPosition, 1.0f));
+	// from above the walls everything can be seen
+	if (local.y > m_wallTop) return -1;
+
+	int column = (int)std::floor((local.x - m_origin.x) / m_cellSize);
+	int row = (int)std::floor((local.z - m_origin.y) / m_cellSize);
+	if (column < 0 || row < 0 || column >= m_columns || row >= m_rows) return -1;
+
+	return row * m_columns + column;
+}
+
+bool MazeVisibility::IsVisible(int fromCell, const AABB& worldBounds) const {
+	if (fromCell < 0) return true;
+
+	AABB local = worldBounds.Transformed(m_worldToModel);
+	int x0 = (int)std::floor((local.min.x - m_origin.x) / m_cellSize);
+	int x1 = (int)std::floor((local.max.x - m_origin.x) / m_cellSize);
+	int y0 = (int)std::floor((local.min.z - m_origin.y) / m_cellSize);
+	int y1 = (int)std::floor((local.max.z - m_origin.y) / m_cellSize);
+
+	// boxes completely outside of the maze are never hidden by it, the
+	// others are clipped to the maze (its outer walls hide what is beyond)
+	if (x1 < 0 || y1 < 0 || x0 >= m_columns || y0 >= m_rows) return true;
+	x0 = std::max(x0, 0);
+	y0 = std::max(y0, 0);
+	x1 = std::min(x1, m_columns - 1);
+	y1 = std::min(y1, m_rows - 1);
+
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			if (IsCellVisible(fromCell, y * m_columns + x)) return true;
+		}
+	}
+	return false;
+}
+
+int MazeVisibility::GetVisibleCellCount(int fromCell) const {
+	if (fromCell < 0) return GetCellCount();
+
+	int count = 0;
+	for (int cell = 0; cell < GetCellCount(); ++cell) {
+		if (IsCellVisible(fromCell, cell)) count++;
+	}
+	return count;
+}
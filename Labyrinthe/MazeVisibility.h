@@ -0,0 +1,81 @@
+#ifndef BULLETOPENGL_MAZEVISIBILITY_H
+#define BULLETOPENGL_MAZEVISIBILITY_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "Frustum.h"
+
+// a potentially visible set (PVS) for the maze. The XZ plane of the maze is
+// cut into square cells, and for every cell we store the set of cells that can
+// be seen from it at eye level (below the top of the walls). The walls are
+// taken from the collider groups loaded by ObjWGroupsLoader.
+//
+// The set is baked offline (see AssetBaker) and loaded at startup, so the
+// runtime cost is a cell lookup and a few bit tests.
+class MazeVisibility {
+public:
+	MazeVisibility();
+
+	// compute the visibility of every cell pair from the collider walls.
+	// Runs on all hardware threads.
+	void Bake(const std::vector<Mesh>& colliders, float cellSize);
+
+	// read/write the baked data (.pvs file)
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	bool IsLoaded() const { return m_columns > 0; }
+
+	// world transform of the maze model (the PVS is stored in model space)
+	void SetTransform(const glm::mat4& transform);
+
+	// cell containing a world space position, -1 when the position is outside
+	// of the maze or above the walls (the set is only valid at eye level)
+	int GetCell(const glm::vec3& worldPosition) const;
+
+	// is any cell covered by the world space box visible from 'fromCell'.
+	// Everything is visible from cell -1.
+	bool IsVisible(int fromCell, const AABB& worldBounds) const;
+
+	int GetCellCount() const { return m_columns * m_rows; }
+	int GetVisibleCellCount(int fromCell) const;
+
+private:
+	struct WallSegment {
+		glm::vec2 a;
+		glm::vec2 b;
+	};
+
+	bool IsCellVisible(int fromCell, int toCell) const {
+		return (m_bits[fromCell * m_rowBytes + (toCell >> 3)] >> (toCell & 7)) & 1;
+	}
+
+	// baking helpers
+	void BuildWallGrid();
+	bool IsSegmentBlocked(const glm::vec2& from, const glm::vec2& to) const;
+	bool AreCellsVisible(int cellA, int cellB) const;
+
+	int m_columns;
+	int m_rows;
+	float m_cellSize;
+	glm::vec2 m_origin;  // model space XZ corner of cell 0
+	float m_wallTop;     // model space height of the top of the walls
+	int m_rowBytes;      // bytes per visibility row
+	std::vector<uint8_t> m_bits;
+
+	glm::mat4 m_worldToModel;
+
+	// walls and a uniform grid over them, only used while baking
+	std::vector<WallSegment> m_walls;
+	std::vector<std::vector<int> > m_wallGrid;
+	int m_wallGridColumns;
+	int m_wallGridRows;
+	float m_wallGridCellSize;
+};
+
+#endif //BULLETOPENGL_MAZEVISIBILITY_H
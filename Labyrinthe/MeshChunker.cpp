@@ -0,0 +1,88 @@
+#include "MeshChunker.h"
+#include <algorithm>
+#include <cmath>
+
+/*
+    Computes the model space bounds of an interleaved vertex buffer
+*/
+AABB MeshChunker::computeBounds(const std::vector<float>& vertexBuffer) {
+    AABB bounds;
+    for (size_t i = 0; i + 2 < vertexBuffer.size(); i += VERTEX_STRIDE) {
+        bounds.Extend(glm::vec3(vertexBuffer[i], vertexBuffer[i + 1], vertexBuffer[i + 2]));
+    }
+    return bounds;
+}
+
+/*
+    Sorts the triangles of the buffer into a grid of chunkSize x chunkSize cells
+    (based on the triangle centroid) and returns one chunk per non empty cell
+*/
+std::vector<MeshChunk> MeshChunker::splitIntoChunks(std::vector<float>& vertexBuffer, float chunkSize) {
+    std::vector<MeshChunk> chunks;
+
+    const size_t triangleFloats = 3 * VERTEX_STRIDE;
+    size_t triangleCount = vertexBuffer.size() / triangleFloats;
+    if (triangleCount == 0) {
+        return chunks;
+    }
+
+    AABB bounds = computeBounds(vertexBuffer);
+
+    // number of cells along x and z
+    int columns = 1, rows = 1;
+    if (chunkSize > 0.0f) {
+        columns = std::max(1, (int)std::ceil((bounds.max.x - bounds.min.x) / chunkSize));
+        rows = std::max(1, (int)std::ceil((bounds.max.z - bounds.min.z) / chunkSize));
+    }
+
+    // find the cell of every triangle
+    std::vector<int> triangleCells(triangleCount);
+    std::vector<size_t> cellSizes(columns * rows, 0);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const float* v = &vertexBuffer[t * triangleFloats];
+        float cx = (v[0] + v[VERTEX_STRIDE] + v[2 * VERTEX_STRIDE]) / 3.0f;
+        float cz = (v[2] + v[VERTEX_STRIDE + 2] + v[2 * VERTEX_STRIDE + 2]) / 3.0f;
+
+        int column = 0, row = 0;
+        if (chunkSize > 0.0f) {
+            column = std::min(columns - 1, std::max(0, (int)((cx - bounds.min.x) / chunkSize)));
+            row = std::min(rows - 1, std::max(0, (int)((cz - bounds.min.z) / chunkSize)));
+        }
+        triangleCells[t] = row * columns + column;
+        cellSizes[triangleCells[t]]++;
+    }
+
+    // prefix sum gives the first triangle of each cell
+    std::vector<size_t> cellStarts(cellSizes.size(), 0);
+    for (size_t c = 1; c < cellSizes.size(); ++c) {
+        cellStarts[c] = cellStarts[c - 1] + cellSizes[c - 1];
+    }
+
+    // counting sort of the triangles into a new buffer
+    std::vector<float> sorted(triangleCount * triangleFloats);
+    std::vector<size_t> cursor = cellStarts;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        size_t destination = cursor[triangleCells[t]]++;
+        std::copy(vertexBuffer.begin() + t * triangleFloats,
+            vertexBuffer.begin() + (t + 1) * triangleFloats,
+            sorted.begin() + destination * triangleFloats);
+    }
+    vertexBuffer.swap(sorted);
+
+    // one chunk per non empty cell
+    for (size_t c = 0; c < cellSizes.size(); ++c) {
+        if (cellSizes[c] == 0) {
+            continue;
+        }
+        MeshChunk chunk;
+        chunk.first = (GLint)(cellStarts[c] * 3);
+        chunk.count = (GLsizei)(cellSizes[c] * 3);
+        for (GLsizei i = 0; i < chunk.count; ++i) {
+            const float* v = &vertexBuffer[(chunk.first + i) * VERTEX_STRIDE];
+            chunk.bounds.Extend(glm::vec3(v[0], v[1], v[2]));
+        }
+        chunks.push_back(chunk);
+    }
+
+    return chunks;
+}
@@ -0,0 +1,38 @@
+/*
+    The MeshChunker splits an interleaved vertex buffer (as produced by
+    ObjLoader::loadModel with sorted = true) into square spatial chunks on the
+    XZ plane. Triangles are reordered in place so that every chunk is a
+    contiguous range that can be drawn with a single glDrawArrays call.
+*/
+
+#ifndef MESHCHUNKER_H_INCLUDED
+#define MESHCHUNKER_H_INCLUDED
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "Frustum.h"
+
+// size of the square XZ cells used to split meshes into chunks. Meshes
+// smaller than this end up as a single chunk. Also the cell size of the
+// baked maze visibility, so chunks can be hidden cell by cell
+#define MESH_CHUNK_SIZE 5.0f
+
+struct MeshChunk {
+    GLint first;   // first vertex of the chunk in the buffer
+    GLsizei count; // number of vertices of the chunk
+    AABB bounds;   // bounds of the chunk in model space
+};
+
+class MeshChunker {
+public:
+    // number of floats per vertex: position (3), uv (2), normal (3)
+    static const int VERTEX_STRIDE = 8;
+
+    static std::vector<MeshChunk> splitIntoChunks(std::vector<float>& vertexBuffer, float chunkSize);
+
+    // bounds of the whole vertex buffer
+    static AABB computeBounds(const std::vector<float>& vertexBuffer);
+};
+
+#endif // MESHCHUNKER_H_INCLUDED
@@ -0,0 +1,79 @@
+#include "MeshRegistry.h"
+#include "ObjLoader.h"
+#include "VertexFormat.h"
+
+SharedMesh::SharedMesh(const std::string& objPath) :
+	m_path(objPath),
+	m_vertexCount(0),
+	m_VAO(0),
+	m_VBO(0)
+{
+	m_vertices = ObjLoader::loadModel(objPath, true).second;
+	// reorder the triangles into spatial chunks before uploading
+	m_chunks = MeshChunker::splitIntoChunks(m_vertices, MESH_CHUNK_SIZE);
+	m_vertexCount = (GLsizei)(m_vertices.size() / MeshChunker::VERTEX_STRIDE);
+}
+
+SharedMesh::~SharedMesh() {
+	if (m_VAO) glDeleteVertexArrays(1, &m_VAO);
+	if (m_VBO) glDeleteBuffers(1, &m_VBO);
+}
+
+void SharedMesh::Bind() {
+	if (m_VAO) {
+		glBindVertexArray(m_VAO);
+		return;
+	}
+	glGenVertexArrays(1, &m_VAO);
+	glBindVertexArray(m_VAO);
+	glGenBuffers(1, &m_VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+	// upload with the configured vertex layout and describe the attributes
+	VertexFormat::uploadVertexBuffer(m_vertices, m_path);
+	std::vector<float>().swap(m_vertices);
+}
+
+MeshRegistry::MeshRegistry() :
+	m_sharedAcquires(0),
+	m_loadedMeshes(0)
+{
+}
+
+MeshRegistry::~MeshRegistry() {
+	for (std::unordered_map<std::string, Entry>::iterator it = m_meshes.begin(); it != m_meshes.end(); ++it) {
+		delete it->second.pMesh;
+	}
+}
+
+SharedMesh* MeshRegistry::Acquire(const std::string& objPath) {
+	std::unordered_map<std::string, Entry>::iterator it = m_meshes.find(objPath);
+	if (it != m_meshes.end()) {
+		++it->second.references;
+		++m_sharedAcquires;
+		return it->second.pMesh;
+	}
+	Entry entry = { new SharedMesh(objPath), 1 };
+	m_meshes[objPath] = entry;
+	++m_loadedMeshes;
+	return entry.pMesh;
+}
+
+bool MeshRegistry::Release(SharedMesh* pMesh) {
+	if (!pMesh) return false;
+	std::unordered_map<std::string, Entry>::iterator it = m_meshes.find(pMesh->GetPath());
+	if (it == m_meshes.end() || it->second.pMesh != pMesh) return false;
+	if (--it->second.references <= 0) {
+		m_meshes.erase(it);
+		delete pMesh;
+	}
+	return true;
+}
+
+void MeshRegistry::PrintStats(std::ostream& out) const {
+	int references = 0;
+	for (std::unordered_map<std::string, Entry>::const_iterator it = m_meshes.begin(); it != m_meshes.end(); ++it) {
+		references += it->second.references;
+	}
+	out << "Mesh registry: " << m_meshes.size() << " meshes for " << references << " references, "
+		<< m_loadedMeshes << " loaded, " << m_sharedAcquires << " shared" << std::endl;
+}
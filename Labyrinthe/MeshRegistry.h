@@ -0,0 +1,71 @@
+#ifndef BULLETOPENGL_MESHREGISTRY_H
+#define BULLETOPENGL_MESHREGISTRY_H
+
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <GL/glew.h>
+
+#include "MeshChunker.h"
+
+// The vertices of an OBJ model cut into chunks, and their GL buffers. The
+// VAO and VBO are only made on the first draw, so spawning an object never
+// needs the GL context, and the CPU copy goes once they are uploaded.
+class SharedMesh {
+public:
+	explicit SharedMesh(const std::string& objPath);
+	// the GL objects too, the context must still be alive if they exist
+	~SharedMesh();
+
+	const std::string& GetPath() const { return m_path; }
+	const std::vector<MeshChunk>& GetChunks() const { return m_chunks; }
+	GLsizei GetVertexCount() const { return m_vertexCount; }
+	bool IsUploaded() const { return m_VAO != 0; }
+
+	// binds the VAO, uploading the vertices the first time
+	void Bind();
+
+private:
+	std::string m_path;
+	std::vector<float> m_vertices; // until the upload
+	std::vector<MeshChunk> m_chunks;
+	GLsizei m_vertexCount;
+	GLuint m_VAO;
+	GLuint m_VBO;
+};
+
+// One SharedMesh per model for all the objects drawn with it, like the
+// shapes of the ShapeRegistry: counted by their users and freed, GL
+// buffers included, with the last one. A crowd of agents parses the OBJ
+// and uploads its vertices once.
+class MeshRegistry {
+public:
+	MeshRegistry();
+	// meshes still referenced are destroyed with the registry
+	~MeshRegistry();
+
+	// one more reference to the model's mesh, loaded the first time
+	SharedMesh* Acquire(const std::string& objPath);
+	// one reference less, the last one destroys the mesh. False when the
+	// mesh isn't from the registry
+	bool Release(SharedMesh* pMesh);
+
+	int GetMeshCount() const { return (int)m_meshes.size(); }
+	unsigned long long GetSharedAcquires() const { return m_sharedAcquires; }
+	unsigned long long GetLoadedMeshes() const { return m_loadedMeshes; }
+	void PrintStats(std::ostream& out) const;
+
+private:
+	struct Entry {
+		SharedMesh* pMesh;
+		int references;
+	};
+
+	std::unordered_map<std::string, Entry> m_meshes;
+	unsigned long long m_sharedAcquires;
+	unsigned long long m_loadedMeshes;
+};
+
+#endif //BULLETOPENGL_MESHREGISTRY_H
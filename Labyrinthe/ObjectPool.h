@@ -0,0 +1,120 @@
+#ifndef BULLETOPENGL_OBJECTPOOL_H
+#define BULLETOPENGL_OBJECTPOOL_H
+
+#include <vector>
+#include <new>
+#include <utility>
+
+#include <Bullet/LinearMath/btAlignedAllocator.h>
+
+// what a pool did since it was created (or its counters were reset)
+struct PoolStats {
+	unsigned long long allocations;     // objects handed out
+	unsigned long long frees;           // objects given back
+	unsigned long long slabAllocations; // calls to the heap, one per slab
+	int live;                           // objects handed out right now
+	int peak;
+
+	PoolStats() : allocations(0), frees(0), slabAllocations(0), live(0), peak(0) {}
+};
+
+// Blocks for objects of one type, cut from slabs of 'slabSize' blocks.
+// Given back blocks go on a free list and are handed out first. Once the
+// pool has grown to the peak count, creating and destroying objects never
+// calls the heap. The slabs are 16 byte aligned, as Bullet's types need,
+// and they are only released with the pool.
+//
+// Not thread safe: objects are created and destroyed by whoever owns the
+// world, between steps.
+template <typename T>
+class ObjectPool {
+public:
+	explicit ObjectPool(int slabSize = 256) : m_slabSize(slabSize > 0 ? slabSize : 1), m_pFree(nullptr) {}
+
+	~ObjectPool() {
+		// objects still alive are not destroyed, only their memory goes
+		for (size_t i = 0; i < m_slabs.size(); ++i) {
+			btAlignedFree(m_slabs[i]);
+		}
+	}
+
+	template <typename... Args>
+	T* Create(Args&&... args) {
+		return new (Allocate()) T(std::forward<Args>(args)...);
+	}
+
+	void Destroy(T* pObject) {
+		if (!pObject) return;
+		pObject->~T();
+		Free(pObject);
+	}
+
+	// whether the object's memory comes from this pool
+	bool Owns(const void* pObject) const {
+		const char* p = (const char*)pObject;
+		for (size_t i = 0; i < m_slabs.size(); ++i) {
+			if (p >= m_slabs[i] && p < m_slabs[i] + m_slabSize * BLOCK_SIZE) return true;
+		}
+		return false;
+	}
+
+	// grows the pool to hold 'count' objects without calling the heap again
+	void Reserve(int count) {
+		while ((int)m_slabs.size() * m_slabSize < count) {
+			AddSlab();
+		}
+	}
+
+	int GetCapacity() const { return (int)m_slabs.size() * m_slabSize; }
+	const PoolStats& GetStats() const { return m_stats; }
+	// counts from now on, the live objects stay counted
+	void ResetStats() {
+		int live = m_stats.live;
+		m_stats = PoolStats();
+		m_stats.live = live;
+		m_stats.peak = live;
+	}
+
+private:
+	union Block {
+		Block* pNext;
+		char storage[sizeof(T)];
+	};
+	static const size_t BLOCK_SIZE = (sizeof(Block) + 15) & ~(size_t)15;
+
+	void AddSlab() {
+		char* pSlab = (char*)btAlignedAlloc(m_slabSize * BLOCK_SIZE, 16);
+		m_slabs.push_back(pSlab);
+		++m_stats.slabAllocations;
+		// in address order on the free list
+		for (int i = m_slabSize - 1; i >= 0; --i) {
+			Block* pBlock = (Block*)(pSlab + i * BLOCK_SIZE);
+			pBlock->pNext = m_pFree;
+			m_pFree = pBlock;
+		}
+	}
+
+	void* Allocate() {
+		if (!m_pFree) AddSlab();
+		Block* pBlock = m_pFree;
+		m_pFree = pBlock->pNext;
+		++m_stats.allocations;
+		if (++m_stats.live > m_stats.peak) m_stats.peak = m_stats.live;
+		return pBlock;
+	}
+
+	void Free(void* pObject) {
+		Block* pBlock = (Block*)pObject;
+		pBlock->pNext = m_pFree;
+		m_pFree = pBlock;
+		++m_stats.frees;
+		--m_stats.live;
+	}
+
+	int m_slabSize;
+	Block* m_pFree;
+	std::vector<char*> m_slabs;
+	PoolStats m_stats;
+};
+
+#endif //BULLETOPENGL_OBJECTPOOL_H
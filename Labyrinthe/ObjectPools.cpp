@@ -0,0 +1,98 @@
+#include "ObjectPools.h"
+
+template <typename T>
+static void PrintPoolStats(std::ostream& out, const char* name, const ObjectPool<T>& pool) {
+	const PoolStats& stats = pool.GetStats();
+	out << "  " << name << ": " << stats.live << " live, " << stats.peak << " peak, " << pool.GetCapacity() << " capacity, "
+		<< stats.allocations << " allocations, " << stats.frees << " frees, " << stats.slabAllocations << " heap calls" << std::endl;
+}
+
+ObjectPools::ObjectPools() :
+	m_gameObjects(128),
+	m_bodies(256),
+	m_motionStates(256),
+	m_boxShapes(64),
+	m_sphereShapes(64),
+	m_cylinderShapes(64),
+	m_shapes(*this)
+{
+}
+
+void ObjectPools::DestroyShape(btCollisionShape* pShape) {
+	if (!pShape) return;
+	switch (pShape->getShapeType()) {
+	case BOX_SHAPE_PROXYTYPE:
+		if (m_boxShapes.Owns(pShape)) {
+			m_boxShapes.Destroy((btBoxShape*)pShape);
+			return;
+		}
+		break;
+	case SPHERE_SHAPE_PROXYTYPE:
+		if (m_sphereShapes.Owns(pShape)) {
+			m_sphereShapes.Destroy((btSphereShape*)pShape);
+			return;
+		}
+		break;
+	case CYLINDER_SHAPE_PROXYTYPE:
+		if (m_cylinderShapes.Owns(pShape)) {
+			m_cylinderShapes.Destroy((btCylinderShape*)pShape);
+			return;
+		}
+		break;
+	case COMPOUND_SHAPE_PROXYTYPE:
+	{
+		// the compounds made here (convex decompositions) own their children
+		btCompoundShape* pCompound = (btCompoundShape*)pShape;
+		for (int i = pCompound->getNumChildShapes() - 1; i >= 0; --i) {
+			btCollisionShape* pChild = pCompound->getChildShape(i);
+			pCompound->removeChildShapeByIndex(i);
+			DestroyShape(pChild);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	delete pShape;
+}
+
+const std::string& ObjectPools::InternPath(const char* path) {
+	// found without making a string, only a new path allocates
+	std::set<std::string, std::less<> >::const_iterator it = m_paths.find(path);
+	if (it == m_paths.end()) {
+		it = m_paths.insert(path).first;
+	}
+	return *it;
+}
+
+void ObjectPools::Reserve(int count) {
+	m_gameObjects.Reserve(count);
+	m_bodies.Reserve(count);
+	m_motionStates.Reserve(count);
+}
+
+unsigned long long ObjectPools::GetSlabAllocations() const {
+	return m_gameObjects.GetStats().slabAllocations + m_bodies.GetStats().slabAllocations + m_motionStates.GetStats().slabAllocations
+		+ m_boxShapes.GetStats().slabAllocations + m_sphereShapes.GetStats().slabAllocations + m_cylinderShapes.GetStats().slabAllocations;
+}
+
+void ObjectPools::ResetStats() {
+	m_gameObjects.ResetStats();
+	m_bodies.ResetStats();
+	m_motionStates.ResetStats();
+	m_boxShapes.ResetStats();
+	m_sphereShapes.ResetStats();
+	m_cylinderShapes.ResetStats();
+}
+
+void ObjectPools::PrintStats(std::ostream& out) const {
+	out << "Object pools:" << std::endl;
+	PrintPoolStats(out, "game objects", m_gameObjects);
+	PrintPoolStats(out, "rigid bodies", m_bodies);
+	PrintPoolStats(out, "motion states", m_motionStates);
+	PrintPoolStats(out, "box shapes", m_boxShapes);
+	PrintPoolStats(out, "sphere shapes", m_sphereShapes);
+	PrintPoolStats(out, "cylinder shapes", m_cylinderShapes);
+	m_shapes.PrintStats(out);
+	m_meshes.PrintStats(out);
+}
@@ -0,0 +1,75 @@
+#ifndef BULLETOPENGL_OBJECTPOOLS_H
+#define BULLETOPENGL_OBJECTPOOLS_H
+
+#include <iostream>
+#include <set>
+#include <string>
+#include <functional>
+
+#include <Bullet/btBulletDynamicsCommon.h>
+
+#include "ObjectPool.h"
+#include "OpenGLMotionState.h"
+#include "GameObject.h"
+#include "ShapeRegistry.h"
+#include "MeshRegistry.h"
+
+// The pools behind the per object state of the application: the game
+// objects, their rigid bodies and motion states, and the simple shapes.
+// Despawned agents leave their blocks behind for the next ones, so once
+// the pools have grown to the largest crowd, spawning makes no heap calls.
+// The shape registry hands out shared shapes made from the shape pools,
+// the mesh registry the models' vertices and GL buffers, and the texture
+// paths are kept once for all the objects using them.
+class ObjectPools {
+public:
+	ObjectPools();
+
+	ObjectPool<GameObject>& GetGameObjects() { return m_gameObjects; }
+
+	btRigidBody* CreateBody(const btRigidBody::btRigidBodyConstructionInfo& info) { return m_bodies.Create(info); }
+	void DestroyBody(btRigidBody* pBody) { m_bodies.Destroy(pBody); }
+
+	OpenGLMotionState* CreateMotionState(const btTransform& transform) { return m_motionStates.Create(transform); }
+	void DestroyMotionState(OpenGLMotionState* pMotionState) { m_motionStates.Destroy(pMotionState); }
+
+	btBoxShape* CreateBoxShape(const btVector3& halfExtents) { return m_boxShapes.Create(halfExtents); }
+	btSphereShape* CreateSphereShape(btScalar radius) { return m_sphereShapes.Create(radius); }
+	btCylinderShape* CreateCylinderShape(const btVector3& halfExtents) { return m_cylinderShapes.Create(halfExtents); }
+	// shapes from these pools go back to them, any other shape is deleted
+	void DestroyShape(btCollisionShape* pShape);
+
+	// shared shapes, counted by their users
+	ShapeRegistry& GetShapes() { return m_shapes; }
+	// shared meshes of the models, counted by their users
+	MeshRegistry& GetMeshes() { return m_meshes; }
+	// the one copy of this path, kept as long as the pools
+	const std::string& InternPath(const char* path);
+	// the registry's shapes lose a reference, the others are destroyed
+	void ReleaseShape(btCollisionShape* pShape) {
+		if (!m_shapes.Release(pShape)) DestroyShape(pShape);
+	}
+
+	// room for 'count' game objects with a body and a motion state each
+	void Reserve(int count);
+
+	// heap calls made by all the pools
+	unsigned long long GetSlabAllocations() const;
+	void ResetStats();
+	// one line per pool: live, peak, allocations and heap calls
+	void PrintStats(std::ostream& out) const;
+
+private:
+	ObjectPool<GameObject> m_gameObjects;
+	ObjectPool<btRigidBody> m_bodies;
+	ObjectPool<OpenGLMotionState> m_motionStates;
+	ObjectPool<btBoxShape> m_boxShapes;
+	ObjectPool<btSphereShape> m_sphereShapes;
+	ObjectPool<btCylinderShape> m_cylinderShapes;
+	MeshRegistry m_meshes;
+	std::set<std::string, std::less<> > m_paths;
+	// last, so it gives its shapes back before the pools go
+	ShapeRegistry m_shapes;
+};
+
+#endif //BULLETOPENGL_OBJECTPOOLS_H
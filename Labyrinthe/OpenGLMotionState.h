@@ -3,16 +3,63 @@
 #define BULLETOPENGL_OPENGLMOTIONSTATE_H
 
 #include <Bullet/btBulletCollisionCommon.h>
+#include <vector>
 
 class OpenGLMotionState : public btDefaultMotionState {
 public:
-	OpenGLMotionState(const btTransform& transform) : btDefaultMotionState(transform) {}
+	OpenGLMotionState(const btTransform& transform) :
+		btDefaultMotionState(transform), m_previousTransform(transform), m_pDirtyList(nullptr), m_slot(-1), m_dirty(false) {}
+
+	// called by Bullet for the bodies that moved during a step. The first
+	// call since ClearDirty() puts the slot on the dirty list (TransformSync)
+	virtual void setWorldTransform(const btTransform& centerOfMassWorldTrans) {
+		btDefaultMotionState::setWorldTransform(centerOfMassWorldTrans);
+		if (m_pDirtyList && !m_dirty) {
+			m_dirty = true;
+			m_pDirtyList->push_back(m_slot);
+		}
+	}
+
+	void SetDirtyList(std::vector<int>* pDirtyList, int slot) {
+		m_pDirtyList = pDirtyList;
+		m_slot = slot;
+		m_dirty = false;
+	}
+	void ClearDirty() { m_dirty = false; }
 
 	void GetWorldTransform(btScalar* transform) {
 		btTransform trans;
 		getWorldTransform(trans);
 		trans.getOpenGLMatrix(transform);
 	}
+
+	// called before each fixed step. Bodies that don't move during
+	// the step keep the same previous and current transform
+	void SavePreviousTransform() { m_previousTransform = m_graphicsWorldTrans; }
+
+	const btTransform& GetPreviousTransform() const { return m_previousTransform; }
+
+	// between the transform before the last step (alpha = 0) and after it (alpha = 1)
+	void GetInterpolatedTransform(btScalar alpha, btTransform& transform) const {
+		Interpolate(m_previousTransform, m_graphicsWorldTrans, alpha, transform);
+	}
+
+	void GetInterpolatedTransform(btScalar alpha, btScalar* transform) const {
+		btTransform trans;
+		GetInterpolatedTransform(alpha, trans);
+		trans.getOpenGLMatrix(transform);
+	}
+
+	static void Interpolate(const btTransform& from, const btTransform& to, btScalar alpha, btTransform& transform) {
+		transform.setOrigin(from.getOrigin().lerp(to.getOrigin(), alpha));
+		transform.setRotation(slerp(from.getRotation(), to.getRotation(), alpha));
+	}
+
+protected:
+	btTransform m_previousTransform;
+	std::vector<int>* m_pDirtyList;
+	int m_slot;
+	bool m_dirty;
 };
 
 #endif //BULLETOPENGL_OPENGLMOTIONSTATE_H
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "PhysicsBackend.h"
+#include "GridBroadphase.h"
+
+#include <Bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <Bullet/BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <Bullet/BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <Bullet/BulletCollision/CollisionDispatch/btGhostObject.h>
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+
+static const char* s_schedulerNames[SCHEDULER_COUNT] = { "sequential", "bullet", "openmp", "tbb", "ppl" };
+static const char* s_broadphaseNames[BROADPHASE_COUNT] = { "dbvt", "sweep", "grid" };
+
+PhysicsConfig PhysicsConfig::FromArgs(int argc, char* argv[]) {
+	PhysicsConfig config;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--physics-thread") {
+			config.ownThread = true;
+		}
+		else if (arg == "--physics-threads" && i + 1 < argc) {
+			config.multithreaded = true;
+			config.threadCount = std::max(0, std::atoi(argv[++i]));
+		}
+		else if (arg == "--physics-scheduler" && i + 1 < argc) {
+			if (!PhysicsBackend::ParseScheduler(argv[++i], config.scheduler)) {
+				std::cerr << "Unknown physics scheduler " << argv[i] << ", using " << PhysicsBackend::GetSchedulerName(config.scheduler) << std::endl;
+			}
+			config.multithreaded = true;
+		}
+		else if (arg == "--physics-tick-rate" && i + 1 < argc) {
+			config.tickRate = std::max(1.0f, (float)std::atof(argv[++i]));
+		}
+		else if (arg == "--physics-max-catchup" && i + 1 < argc) {
+			config.maxCatchUpSteps = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--physics-broadphase" && i + 1 < argc) {
+			if (!PhysicsBackend::ParseBroadphase(argv[++i], config.broadphase)) {
+				std::cerr << "Unknown physics broadphase " << argv[i] << ", using " << PhysicsBackend::GetBroadphaseName(config.broadphase) << std::endl;
+			}
+		}
+		else if (arg == "--physics-grid-cell" && i + 1 < argc) {
+			config.gridCellSize = std::max(0.1f, (float)std::atof(argv[++i]));
+		}
+		else if (arg == "--physics-deterministic") {
+			config.deterministic = true;
+		}
+	}
+	return config;
+}
+
+PhysicsBackend::PhysicsBackend() :
+	m_pCollisionConfiguration(nullptr),
+	m_pDispatcher(nullptr),
+	m_pBroadphase(nullptr),
+	m_pSolver(nullptr),
+	m_pSolverMt(nullptr),
+	m_pWorld(nullptr),
+	m_pGhostPairCallback(nullptr),
+	m_multithreaded(false)
+{
+}
+
+PhysicsBackend::~PhysicsBackend() {
+	Destroy();
+}
+
+btDiscreteDynamicsWorld* PhysicsBackend::Create(const PhysicsConfig& config) {
+	if (m_pWorld) return nullptr;
+
+	btITaskScheduler* pScheduler = nullptr;
+	if (config.multithreaded) {
+		pScheduler = GetScheduler(config.scheduler);
+		if (!pScheduler) {
+			std::cerr << "Physics scheduler " << GetSchedulerName(config.scheduler)
+				<< " is not available (Bullet needs BT_THREADSAFE=1), using the single threaded world" << std::endl;
+		}
+	}
+
+	if (pScheduler) {
+		// the Mt classes read the global scheduler, it must be set before they are created
+		btSetTaskScheduler(pScheduler);
+		SetThreadCount(config.threadCount);
+
+		// the pools are shared by the threads, make room for many contacts
+		btDefaultCollisionConstructionInfo info;
+		info.m_defaultMaxPersistentManifoldPoolSize = 80000;
+		info.m_defaultMaxCollisionAlgorithmPoolSize = 80000;
+		m_pCollisionConfiguration = new btDefaultCollisionConfiguration(info);
+		m_pDispatcher = new btCollisionDispatcherMt(m_pCollisionConfiguration, 40);
+		m_pBroadphase = CreateBroadphase(config);
+
+		// one solver per thread for the small islands, a multithreaded one for the large ones
+		btConstraintSolverPoolMt* pSolverPool = new btConstraintSolverPoolMt(BT_MAX_THREAD_COUNT);
+		m_pSolver = pSolverPool;
+		m_pSolverMt = new btSequentialImpulseConstraintSolverMt();
+		m_pWorld = new btDiscreteDynamicsWorldMt(m_pDispatcher, m_pBroadphase, pSolverPool, m_pSolverMt, m_pCollisionConfiguration);
+		m_multithreaded = true;
+	}
+	else {
+		m_pCollisionConfiguration = new btDefaultCollisionConfiguration();
+		m_pDispatcher = new btCollisionDispatcher(m_pCollisionConfiguration);
+		m_pBroadphase = CreateBroadphase(config);
+		m_pSolver = new btSequentialImpulseConstraintSolver();
+		m_pWorld = new btDiscreteDynamicsWorld(m_pDispatcher, m_pBroadphase, m_pSolver, m_pCollisionConfiguration);
+		m_multithreaded = false;
+	}
+
+	// ghost objects (the character controllers) keep their own pair lists
+	m_pGhostPairCallback = new btGhostPairCallback();
+	m_pBroadphase->getOverlappingPairCache()->setInternalGhostPairCallback(m_pGhostPairCallback);
+	// the order the pairs were found in depends on the world's history, the ids don't
+	m_pWorld->getDispatchInfo().m_deterministicOverlappingPairs = config.deterministic;
+	return m_pWorld;
+}
+
+void PhysicsBackend::Destroy() {
+	delete m_pWorld;
+	delete m_pSolverMt;
+	delete m_pSolver;
+	delete m_pBroadphase;
+	delete m_pDispatcher;
+	delete m_pCollisionConfiguration;
+	delete m_pGhostPairCallback;
+	m_pWorld = nullptr;
+	m_pSolverMt = nullptr;
+	m_pSolver = nullptr;
+	m_pBroadphase = nullptr;
+	m_pDispatcher = nullptr;
+	m_pCollisionConfiguration = nullptr;
+	m_pGhostPairCallback = nullptr;
+	m_multithreaded = false;
+}
+
+void PhysicsBackend::SetThreadCount(int threadCount) {
+	btITaskScheduler* pScheduler = btGetTaskScheduler();
+	if (!pScheduler) return;
+	int maxThreads = pScheduler->getMaxNumThreads();
+	pScheduler->setNumThreads(threadCount <= 0 || threadCount > maxThreads ? maxThreads : threadCount);
+}
+
+int PhysicsBackend::GetThreadCount() const {
+	btITaskScheduler* pScheduler = btGetTaskScheduler();
+	return m_multithreaded && pScheduler ? pScheduler->getNumThreads() : 1;
+}
+
+const char* PhysicsBackend::GetSchedulerName() const {
+	btITaskScheduler* pScheduler = btGetTaskScheduler();
+	return m_multithreaded && pScheduler ? pScheduler->getName() : s_schedulerNames[SCHEDULER_SEQUENTIAL];
+}
+
+btITaskScheduler* PhysicsBackend::GetScheduler(PhysicsScheduler scheduler) {
+	// Bullet's own pool starts its threads, it is only created once and
+	// lives as long as the program, like the OpenMP / TBB / PPL singletons
+	static btITaskScheduler* s_pBulletScheduler = nullptr;
+
+	switch (scheduler) {
+	case SCHEDULER_SEQUENTIAL:
+		return btGetSequentialTaskScheduler();
+	case SCHEDULER_BULLET:
+		if (!s_pBulletScheduler) {
+			s_pBulletScheduler = btCreateDefaultTaskScheduler();
+		}
+		return s_pBulletScheduler;
+	case SCHEDULER_OPENMP:
+		return btGetOpenMPTaskScheduler();
+	case SCHEDULER_TBB:
+		return btGetTBBTaskScheduler();
+	case SCHEDULER_PPL:
+		return btGetPPLTaskScheduler();
+	default:
+		return nullptr;
+	}
+}
+
+const char* PhysicsBackend::GetSchedulerName(PhysicsScheduler scheduler) {
+	return scheduler >= 0 && scheduler < SCHEDULER_COUNT ? s_schedulerNames[scheduler] : "unknown";
+}
+
+btBroadphaseInterface* PhysicsBackend::CreateBroadphase(const PhysicsConfig& config) {
+	switch (config.broadphase) {
+	case BROADPHASE_SWEEP:
+		// 16 bit handles stop at 32767
+		if (config.maxProxies > 32766) {
+			return new bt32BitAxisSweep3(config.worldMin, config.worldMax, config.maxProxies);
+		}
+		return new btAxisSweep3(config.worldMin, config.worldMax, (unsigned short)std::max(2, config.maxProxies));
+	case BROADPHASE_GRID:
+		return new GridBroadphase(config.worldMin, config.worldMax, config.gridCellSize);
+	default:
+		return new btDbvtBroadphase();
+	}
+}
+
+const char* PhysicsBackend::GetBroadphaseName(PhysicsBroadphase broadphase) {
+	return broadphase >= 0 && broadphase < BROADPHASE_COUNT ? s_broadphaseNames[broadphase] : "unknown";
+}
+
+bool PhysicsBackend::ParseBroadphase(const std::string& name, PhysicsBroadphase& broadphase) {
+	for (int i = 0; i < BROADPHASE_COUNT; ++i) {
+		if (name == s_broadphaseNames[i]) {
+			broadphase = (PhysicsBroadphase)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool PhysicsBackend::ParseScheduler(const std::string& name, PhysicsScheduler& scheduler) {
+	for (int i = 0; i < SCHEDULER_COUNT; ++i) {
+		if (name == s_schedulerNames[i]) {
+			scheduler = (PhysicsScheduler)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+int PhysicsBackend::CountAwakeBodies(const btCollisionWorld* pWorld) {
+	if (!pWorld) return 0;
+	// static and kinematic objects never sleep, and the ghost objects of the
+	// characters are moved by their controllers, not simulated
+	int awake = 0;
+	const btCollisionObjectArray& objects = pWorld->getCollisionObjectArray();
+	for (int i = 0; i < objects.size(); ++i) {
+		const btCollisionObject* pObject = objects[i];
+		if (pObject->isActive() && !pObject->isStaticOrKinematicObject() && btRigidBody::upcast(pObject)) {
+			++awake;
+		}
+	}
+	return awake;
+}
@@ -0,0 +1,120 @@
+
+#ifndef BULLETOPENGL_PHYSICSBACKEND_H
+#define BULLETOPENGL_PHYSICSBACKEND_H
+
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <Bullet/LinearMath/btThreads.h>
+#include <string>
+
+// who runs the parallel loops of the multithreaded world
+enum PhysicsScheduler {
+	SCHEDULER_SEQUENTIAL = 0, // everything on the calling thread
+	SCHEDULER_BULLET,         // Bullet's own thread pool (Win32 / pthreads)
+	SCHEDULER_OPENMP,
+	SCHEDULER_TBB,
+	SCHEDULER_PPL,
+	SCHEDULER_COUNT
+};
+
+// who finds the overlapping pairs
+enum PhysicsBroadphase {
+	BROADPHASE_DBVT = 0,  // btDbvtBroadphase, two dynamic AABB trees
+	BROADPHASE_SWEEP,     // btAxisSweep3 sweep and prune, inside the world bounds
+	BROADPHASE_GRID,      // GridBroadphase, uniform XZ cells over the world bounds
+	BROADPHASE_COUNT
+};
+
+struct PhysicsConfig {
+	bool multithreaded;         // btDiscreteDynamicsWorldMt instead of btDiscreteDynamicsWorld
+	bool ownThread;             // step the world on a thread of its own, not in the frame
+	PhysicsScheduler scheduler;
+	int threadCount;            // 0 uses every thread the scheduler has
+	float tickRate;             // fixed simulation steps per second
+	int maxCatchUpSteps;        // most steps run in one frame, the rest of the time is dropped
+	PhysicsBroadphase broadphase;
+	btVector3 worldMin;         // bounds of the sweep and prune and grid broadphases,
+	btVector3 worldMax;         // the default holds the maze with room to spare
+	float gridCellSize;         // side of the grid broadphase cells
+	int maxProxies;             // objects the sweep and prune broadphase has room for
+	bool deterministic;         // pairs processed in proxy id order, a replay from a WorldSnapshot repeats exactly
+
+	PhysicsConfig() : multithreaded(false), ownThread(false), scheduler(SCHEDULER_BULLET), threadCount(0), tickRate(60.0f), maxCatchUpSteps(5),
+		broadphase(BROADPHASE_DBVT), worldMin(-100.0f, -50.0f, -100.0f), worldMax(100.0f, 50.0f, 100.0f), gridCellSize(2.0f), maxProxies(16384),
+		deterministic(false) {}
+
+	// --physics-threads <n> (0 = all) turns the multithreaded world on,
+	// --physics-scheduler bullet|openmp|tbb|ppl|sequential picks who runs it,
+	// --physics-tick-rate <hz> and --physics-max-catchup <steps> set the fixed step,
+	// --physics-thread runs the steps on their own thread,
+	// --physics-broadphase dbvt|sweep|grid and --physics-grid-cell <size> pick the broadphase,
+	// --physics-deterministic sorts the pairs every step
+	static PhysicsConfig FromArgs(int argc, char* argv[]);
+};
+
+/*
+	Builds the Bullet world and the objects it needs from a PhysicsConfig.
+
+	The broadphase is the config's: btDbvtBroadphase suits any world,
+	btAxisSweep3 (bt32BitAxisSweep3 past 32k objects) and GridBroadphase
+	want the world bounds, and the grid is meant for flat worlds of many
+	small objects such as the maze agents.
+
+	The multithreaded world pairs btCollisionDispatcherMt with a
+	btConstraintSolverPoolMt (one sequential impulse solver per thread, each
+	island goes to a free one) and btSequentialImpulseConstraintSolverMt for
+	the islands too large for a single thread. Bullet only runs these in
+	parallel when it is compiled with BT_THREADSAFE=1; otherwise, or when the
+	scheduler isn't available, Create() falls back to the sequential world
+	and says so.
+*/
+class PhysicsBackend {
+public:
+	PhysicsBackend();
+	~PhysicsBackend();
+
+	// the world is empty, returns null if one already exists
+	btDiscreteDynamicsWorld* Create(const PhysicsConfig& config);
+
+	// deletes the world and its parts, not the bodies still in it
+	void Destroy();
+
+	// threads used by the scheduler, can be changed between steps
+	void SetThreadCount(int threadCount);
+	int GetThreadCount() const;
+
+	bool IsMultithreaded() const { return m_multithreaded; }
+	const char* GetSchedulerName() const;
+
+	btDiscreteDynamicsWorld* GetWorld() const { return m_pWorld; }
+	btBroadphaseInterface* GetBroadphase() const { return m_pBroadphase; }
+	btCollisionConfiguration* GetCollisionConfiguration() const { return m_pCollisionConfiguration; }
+	btCollisionDispatcher* GetDispatcher() const { return m_pDispatcher; }
+	btConstraintSolver* GetSolver() const { return m_pSolver; }
+
+	// the scheduler, created the first time it is asked for. Null when
+	// Bullet was built without it (or without BT_THREADSAFE)
+	static btITaskScheduler* GetScheduler(PhysicsScheduler scheduler);
+	static const char* GetSchedulerName(PhysicsScheduler scheduler);
+	static bool ParseScheduler(const std::string& name, PhysicsScheduler& scheduler);
+
+	// a broadphase of the given kind, owned by the caller
+	static btBroadphaseInterface* CreateBroadphase(const PhysicsConfig& config);
+	static const char* GetBroadphaseName(PhysicsBroadphase broadphase);
+	static bool ParseBroadphase(const std::string& name, PhysicsBroadphase& broadphase);
+
+	// the dynamic bodies not put to sleep by the island deactivation. With
+	// none, a step moves nothing until something wakes a body up
+	static int CountAwakeBodies(const btCollisionWorld* pWorld);
+
+protected:
+	btCollisionConfiguration* m_pCollisionConfiguration;
+	btCollisionDispatcher* m_pDispatcher;
+	btBroadphaseInterface* m_pBroadphase;
+	btConstraintSolver* m_pSolver;
+	btConstraintSolver* m_pSolverMt; // large islands of the multithreaded world
+	btDiscreteDynamicsWorld* m_pWorld;
+	btOverlappingPairCallback* m_pGhostPairCallback;
+	bool m_multithreaded;
+};
+
+#endif //BULLETOPENGL_PHYSICSBACKEND_H
@@ -0,0 +1,111 @@
+#include "PhysicsThread.h"
+#include "PhysicsBackend.h"
+
+#include <chrono>
+#include <algorithm>
+
+PhysicsThread::PhysicsThread() :
+	m_pWorld(nullptr),
+	m_running(false),
+	m_hasFrame(false)
+{
+}
+
+PhysicsThread::~PhysicsThread() {
+	Stop();
+}
+
+void PhysicsThread::Start(btDynamicsWorld* pWorld, const std::vector<OpenGLMotionState*>& motionStates, float tickRate, int maxCatchUpSteps) {
+	if (IsRunning() || !pWorld) return;
+	m_pWorld = pWorld;
+	m_motionStates = motionStates;
+	m_timestep.SetTickRate(tickRate);
+	m_timestep.SetMaxCatchUpSteps(maxCatchUpSteps);
+	m_timestep.Reset();
+
+	// every slot starts with the current transforms, so the first frames
+	// (and the objects added since the last run) don't jump
+	for (int slot = 0; slot < 3; ++slot) {
+		PhysicsFrame& frame = m_frames.GetSlot(slot);
+		frame.previous.resize(m_motionStates.size());
+		frame.current.resize(m_motionStates.size());
+		for (size_t i = 0; i < m_motionStates.size(); ++i) {
+			if (!m_motionStates[i]) continue;
+			frame.previous[i] = m_motionStates[i]->m_graphicsWorldTrans;
+			frame.current[i] = m_motionStates[i]->m_graphicsWorldTrans;
+		}
+		frame.publishSeconds = Now();
+	}
+	m_hasFrame = false;
+
+	m_running = true;
+	m_thread = std::thread(&PhysicsThread::Run, this);
+}
+
+void PhysicsThread::Stop() {
+	if (!IsRunning()) return;
+	m_running = false;
+	m_thread.join();
+}
+
+const PhysicsFrame* PhysicsThread::AcquireFrame() {
+	if (m_frames.Update()) {
+		m_hasFrame = true;
+	}
+	return m_hasFrame ? &m_frames.GetFront() : nullptr;
+}
+
+float PhysicsThread::GetAlpha(const PhysicsFrame& frame) const {
+	// one step behind the simulation: the frame is shown going from its
+	// previous to its current transforms during the step after it was published
+	double alpha = (Now() - frame.publishSeconds) / m_timestep.GetStepSize();
+	return (float)std::min(1.0, std::max(0.0, alpha));
+}
+
+double PhysicsThread::Now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PhysicsThread::Run() {
+	btClock clock;
+	while (m_running) {
+		// same fixed step loop as the render thread would run, on real time
+		double frameSeconds = clock.getTimeMicroseconds() * 0.000001;
+		clock.reset();
+		int steps = m_timestep.Advance(frameSeconds);
+
+		double stepMilliseconds = 0.0;
+		for (int s = 0; s < steps; ++s) {
+			btClock stepClock;
+			for (size_t i = 0; i < m_motionStates.size(); ++i) {
+				if (m_motionStates[i]) m_motionStates[i]->SavePreviousTransform();
+			}
+			m_pWorld->stepSimulation(m_timestep.GetStepSize(), 0, m_timestep.GetStepSize());
+			stepMilliseconds = stepClock.getTimeMicroseconds() * 0.001;
+		}
+		if (steps > 0) {
+			Publish(stepMilliseconds);
+		}
+
+		// sleep until the next step is due
+		double untilNextStep = (1.0 - m_timestep.GetAlpha()) * m_timestep.GetStepSize();
+		std::this_thread::sleep_for(std::chrono::microseconds((long long)(untilNextStep * 1000000.0)));
+	}
+}
+
+void PhysicsThread::Publish(double stepMilliseconds) {
+	PhysicsFrame& frame = m_frames.GetBack();
+	frame.previous.resize(m_motionStates.size());
+	frame.current.resize(m_motionStates.size());
+	for (size_t i = 0; i < m_motionStates.size(); ++i) {
+		if (!m_motionStates[i]) continue;
+		frame.previous[i] = m_motionStates[i]->GetPreviousTransform();
+		frame.current[i] = m_motionStates[i]->m_graphicsWorldTrans;
+	}
+	frame.tick = m_timestep.GetStats().steps;
+	frame.publishSeconds = Now();
+	frame.stepMilliseconds = stepMilliseconds;
+	frame.awakeBodies = PhysicsBackend::CountAwakeBodies(m_pWorld);
+	frame.stats = m_timestep.GetStats();
+	m_frames.Publish();
+}
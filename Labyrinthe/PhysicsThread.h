@@ -0,0 +1,70 @@
+#ifndef BULLETOPENGL_PHYSICSTHREAD_H
+#define BULLETOPENGL_PHYSICSTHREAD_H
+
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "OpenGLMotionState.h"
+#include "FixedTimestep.h"
+#include "TripleBuffer.h"
+
+// what the physics thread publishes after its steps: for every registered
+// motion state, its transform before and after the last step
+struct PhysicsFrame {
+	std::vector<btTransform> previous;
+	std::vector<btTransform> current;
+	unsigned long long tick;     // steps run so far
+	double publishSeconds;       // PhysicsThread::Now() when published
+	double stepMilliseconds;     // time spent in the last step
+	int awakeBodies;             // PhysicsBackend::CountAwakeBodies after the last step
+	FixedTimestepStats stats;
+
+	PhysicsFrame() : tick(0), publishSeconds(0.0), stepMilliseconds(0.0), awakeBodies(0) {}
+};
+
+// Runs a Bullet world on its own thread at a fixed rate, so rendering a
+// frame and simulating the next ticks overlap instead of adding up.
+//
+// The render thread never touches the world while the thread runs: it reads
+// the transforms from the latest PhysicsFrame (a lock-free triple buffer)
+// and interpolates between the last two steps from how long ago the frame
+// was published. Adding or removing bodies, debug drawing or anything else
+// using the world needs Stop() first.
+class PhysicsThread {
+public:
+	PhysicsThread();
+	~PhysicsThread();
+
+	// the motion states are published in this order, null entries are skipped
+	void Start(btDynamicsWorld* pWorld, const std::vector<OpenGLMotionState*>& motionStates, float tickRate, int maxCatchUpSteps);
+	// waits for the current step to finish
+	void Stop();
+	bool IsRunning() const { return m_thread.joinable(); }
+
+	// render thread: the latest frame, null before the first one
+	const PhysicsFrame* AcquireFrame();
+	// 0 on the previous step of the frame, 1 on its last step
+	float GetAlpha(const PhysicsFrame& frame) const;
+
+	float GetStepSize() const { return m_timestep.GetStepSize(); }
+
+	// seconds on the clock used for publishSeconds
+	static double Now();
+
+private:
+	void Run();
+	void Publish(double stepMilliseconds);
+
+	btDynamicsWorld* m_pWorld;
+	std::vector<OpenGLMotionState*> m_motionStates;
+	FixedTimestep m_timestep;
+
+	std::thread m_thread;
+	std::atomic<bool> m_running;
+	TripleBuffer<PhysicsFrame> m_frames;
+	bool m_hasFrame;
+};
+
+#endif //BULLETOPENGL_PHYSICSTHREAD_H
@@ -0,0 +1,111 @@
+#include "RenderBvh.h"
+#include <algorithm>
+
+// maximum number of items stored in a leaf. With a single item the leaf
+// bounds are the item bounds, so no item is accepted without its own test
+#define BVH_MAX_LEAF_ITEMS 1
+
+void RenderBvh::Build(const std::vector<AABB>& itemBounds) {
+	m_nodes.clear();
+	m_itemIndices.resize(itemBounds.size());
+	for (size_t i = 0; i < itemBounds.size(); ++i) {
+		m_itemIndices[i] = (int)i;
+	}
+
+	if (itemBounds.empty()) return;
+
+	// a binary tree has at most 2n - 1 nodes
+	m_nodes.reserve(itemBounds.size() * 2);
+	BuildNode(itemBounds, 0, (int)itemBounds.size());
+}
+
+int RenderBvh::BuildNode(const std::vector<AABB>& itemBounds, int firstItem, int itemCount) {
+	int nodeIndex = (int)m_nodes.size();
+	m_nodes.push_back(Node());
+
+	// bounds of the items, and of their centers to pick the split axis
+	AABB bounds, centerBounds;
+	for (int i = firstItem; i < firstItem + itemCount; ++i) {
+		const AABB& item = itemBounds[m_itemIndices[i]];
+		bounds.Extend(item);
+		centerBounds.Extend(item.GetCenter());
+	}
+
+	m_nodes[nodeIndex].bounds = bounds;
+	m_nodes[nodeIndex].rightChild = -1;
+	m_nodes[nodeIndex].firstItem = firstItem;
+	m_nodes[nodeIndex].itemCount = itemCount;
+
+	if (itemCount <= BVH_MAX_LEAF_ITEMS) {
+		return nodeIndex;
+	}
+
+	// split at the median along the longest axis of the centers
+	glm::vec3 size = centerBounds.max - centerBounds.min;
+	int axis = 0;
+	if (size.y > size[axis]) axis = 1;
+	if (size.z > size[axis]) axis = 2;
+
+	int half = itemCount / 2;
+	std::nth_element(m_itemIndices.begin() + firstItem,
+		m_itemIndices.begin() + firstItem + half,
+		m_itemIndices.begin() + firstItem + itemCount,
+		[&itemBounds, axis](int a, int b) {
+			return itemBounds[a].GetCenter()[axis] < itemBounds[b].GetCenter()[axis];
+		});
+
+	BuildNode(itemBounds, firstItem, half);
+	int rightChild = BuildNode(itemBounds, firstItem + half, itemCount - half);
+	m_nodes[nodeIndex].rightChild = rightChild;
+
+	return nodeIndex;
+}
+
+void RenderBvh::Refit(const std::vector<AABB>& itemBounds) {
+	// children are always stored after their parent, so walking
+	// the nodes backwards updates the children first
+	for (int i = (int)m_nodes.size() - 1; i >= 0; --i) {
+		Node& node = m_nodes[i];
+		if (node.rightChild < 0) {
+			node.bounds = AABB();
+			for (int j = node.firstItem; j < node.firstItem + node.itemCount; ++j) {
+				node.bounds.Extend(itemBounds[m_itemIndices[j]]);
+			}
+		}
+		else {
+			node.bounds = m_nodes[i + 1].bounds;
+			node.bounds.Extend(m_nodes[node.rightChild].bounds);
+		}
+	}
+}
+
+void RenderBvh::Query(const Frustum& frustum, std::vector<int>& visibleItems) const {
+	if (m_nodes.empty()) return;
+
+	// explicit stack, the tree depth is logarithmic in the item count
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		const Node& node = m_nodes[stack[--stackSize]];
+
+		Frustum::Result result = frustum.TestAABB(node.bounds);
+		if (result == Frustum::OUTSIDE) {
+			continue;
+		}
+
+		// fully visible subtrees and leaves are accepted without
+		// testing their children
+		if (result == Frustum::INSIDE || node.rightChild < 0) {
+			visibleItems.insert(visibleItems.end(),
+				m_itemIndices.begin() + node.firstItem,
+				m_itemIndices.begin() + node.firstItem + node.itemCount);
+			continue;
+		}
+
+		int nodeIndex = (int)(&node - &m_nodes[0]);
+		stack[stackSize++] = node.rightChild;
+		stack[stackSize++] = nodeIndex + 1;
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef BULLETOPENGL_RENDERBVH_H
+#define BULLETOPENGL_RENDERBVH_H
+
+#include <vector>
+#include "Frustum.h"
+
+// per frame culling statistics
+struct CullStats {
+	int visibleChunks;
+	int totalChunks;
+	long long submittedTriangles;
+	long long totalTriangles;
+	unsigned long long cullMicroseconds;
+
+	CullStats() : visibleChunks(0), totalChunks(0), submittedTriangles(0), totalTriangles(0), cullMicroseconds(0) {}
+};
+
+// a bounding volume hierarchy over renderable items (mesh chunks
+// and game objects), used to cull whole groups of items at once
+class RenderBvh {
+public:
+	// (re)build the tree over the given item bounds. Items are
+	// referenced by their index in the array.
+	void Build(const std::vector<AABB>& itemBounds);
+
+	// update the node bounds after items moved, without changing
+	// the topology of the tree
+	void Refit(const std::vector<AABB>& itemBounds);
+
+	// append the index of every item touching the frustum
+	void Query(const Frustum& frustum, std::vector<int>& visibleItems) const;
+
+	int GetNodeCount() const { return (int)m_nodes.size(); }
+	int GetItemCount() const { return (int)m_itemIndices.size(); }
+
+private:
+	struct Node {
+		AABB bounds;
+		int rightChild; // the left child always directly follows its parent, -1 for leaves
+		int firstItem;  // range of m_itemIndices covered by this subtree
+		int itemCount;
+	};
+
+	int BuildNode(const std::vector<AABB>& itemBounds, int firstItem, int itemCount);
+
+	std::vector<Node> m_nodes;
+	std::vector<int> m_itemIndices;
+};
+
+#endif //BULLETOPENGL_RENDERBVH_H
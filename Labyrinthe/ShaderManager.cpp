@@ -0,0 +1,307 @@
+#include "ShaderManager.h"
+#include "UniformBuffers.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+// first bytes of a cached program binary
+#define PROGRAM_BINARY_MAGIC 0x31424750 // "PGB1"
+
+namespace {
+	// 64 bit FNV-1a, used to key the binary cache
+	unsigned long long hashString(const std::string& text, unsigned long long hash = 14695981039346656037ULL) {
+		for (size_t i = 0; i < text.size(); ++i) {
+			hash ^= (unsigned char)text[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	std::string glString(GLenum name) {
+		const GLubyte* pString = glGetString(name);
+		return pString ? std::string((const char*)pString) : std::string();
+	}
+}
+
+ShaderManager::ShaderManager(const std::string& cacheDirectory) :
+	m_cacheDirectory(cacheDirectory),
+	m_boundProgram(0),
+	m_binarySupport(-1),
+	m_cacheHits(0),
+	m_cacheMisses(0)
+{
+}
+
+ShaderManager::~ShaderManager() {
+	Destroy();
+}
+
+void ShaderManager::Destroy() {
+	for (size_t i = 0; i < m_programs.size(); ++i) {
+		if (m_programs[i].program) glDeleteProgram(m_programs[i].program);
+	}
+	m_programs.clear();
+	m_boundProgram = 0;
+}
+
+int ShaderManager::LoadProgram(const std::string& name, const std::string& vertexPath, const std::string& fragmentPath) {
+	std::string vertexSource, fragmentSource;
+	if (!ReadFile(vertexPath, vertexSource) || !ReadFile(fragmentPath, fragmentSource)) {
+		return -1;
+	}
+
+	Program program;
+	program.name = name;
+	program.vertexPath = vertexPath;
+	program.fragmentPath = fragmentPath;
+	program.vertexTime = GetModificationTime(vertexPath);
+	program.fragmentTime = GetModificationTime(fragmentPath);
+	program.program = BuildProgram(name, vertexSource, fragmentSource);
+	if (!program.program) {
+		return -1;
+	}
+
+	m_programs.push_back(program);
+	return (int)m_programs.size() - 1;
+}
+
+GLuint ShaderManager::GetProgram(int id) const {
+	if (id < 0 || id >= (int)m_programs.size()) return 0;
+	return m_programs[id].program;
+}
+
+void ShaderManager::UseProgram(int id) {
+	GLuint program = GetProgram(id);
+	if (program == m_boundProgram) return;
+	glUseProgram(program);
+	m_boundProgram = program;
+}
+
+int ShaderManager::ReloadModifiedPrograms() {
+	int reloaded = 0;
+	for (size_t i = 0; i < m_programs.size(); ++i) {
+		Program& program = m_programs[i];
+		time_t vertexTime = GetModificationTime(program.vertexPath);
+		time_t fragmentTime = GetModificationTime(program.fragmentPath);
+		if (vertexTime == program.vertexTime && fragmentTime == program.fragmentTime) continue;
+
+		// don't retry a broken file until it changes again
+		program.vertexTime = vertexTime;
+		program.fragmentTime = fragmentTime;
+
+		std::string vertexSource, fragmentSource;
+		if (!ReadFile(program.vertexPath, vertexSource) || !ReadFile(program.fragmentPath, fragmentSource)) continue;
+
+		GLuint newProgram = BuildProgram(program.name, vertexSource, fragmentSource);
+		if (!newProgram) {
+			std::cerr << "Shader '" << program.name << "' not reloaded, keeping the previous version" << std::endl;
+			continue;
+		}
+
+		if (m_boundProgram == program.program) {
+			glUseProgram(newProgram);
+			m_boundProgram = newProgram;
+		}
+		glDeleteProgram(program.program);
+		program.program = newProgram;
+		std::cout << "Shader '" << program.name << "' reloaded" << std::endl;
+		reloaded++;
+	}
+	return reloaded;
+}
+
+GLuint ShaderManager::BuildProgram(const std::string& name, const std::string& vertexSource, const std::string& fragmentSource) {
+	std::string cachePath;
+	if (BinaryCacheSupported()) {
+		cachePath = GetCachePath(name, vertexSource, fragmentSource);
+		GLuint program = LoadBinary(cachePath);
+		if (program) {
+			m_cacheHits++;
+			SetupProgram(program);
+			return program;
+		}
+		m_cacheMisses++;
+	}
+
+	GLuint vertexShader = CompileShader(name, GL_VERTEX_SHADER, vertexSource);
+	GLuint fragmentShader = CompileShader(name, GL_FRAGMENT_SHADER, fragmentSource);
+	if (!vertexShader || !fragmentShader) {
+		if (vertexShader) glDeleteShader(vertexShader);
+		if (fragmentShader) glDeleteShader(fragmentShader);
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	if (!cachePath.empty()) {
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(program);
+
+	// the shaders are no longer needed once linked
+	glDetachShader(program, vertexShader);
+	glDetachShader(program, fragmentShader);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	GLint success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	GLint logLength = 0;
+	glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+	if (logLength > 1) {
+		std::vector<char> log(logLength);
+		glGetProgramInfoLog(program, logLength, nullptr, &log[0]);
+		std::cerr << "Shader '" << name << "' link " << (success ? "warnings" : "errors") << ":" << std::endl << &log[0] << std::endl;
+	}
+	if (!success) {
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	if (!cachePath.empty()) {
+		SaveBinary(cachePath, program);
+	}
+	SetupProgram(program);
+	return program;
+}
+
+GLuint ShaderManager::CompileShader(const std::string& name, GLenum type, const std::string& source) {
+	const char* pSource = source.c_str();
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &pSource, nullptr);
+	glCompileShader(shader);
+
+	GLint success = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	GLint logLength = 0;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+	if (logLength > 1) {
+		std::vector<char> log(logLength);
+		glGetShaderInfoLog(shader, logLength, nullptr, &log[0]);
+		std::cerr << "Shader '" << name << "' " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment")
+			<< " stage " << (success ? "warnings" : "errors") << ":" << std::endl << &log[0] << std::endl;
+	}
+	if (!success) {
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+bool ShaderManager::BinaryCacheSupported() {
+	if (m_binarySupport < 0) {
+		GLint formatCount = 0;
+		if (GLEW_ARB_get_program_binary) {
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		}
+		m_binarySupport = formatCount > 0 ? 1 : 0;
+
+		if (m_binarySupport) {
+#ifdef _WIN32
+			_mkdir(m_cacheDirectory.c_str());
+#else
+			mkdir(m_cacheDirectory.c_str(), 0755);
+#endif
+		}
+	}
+	return m_binarySupport == 1;
+}
+
+std::string ShaderManager::GetCachePath(const std::string& name, const std::string& vertexSource, const std::string& fragmentSource) {
+	// a binary is only valid for the exact sources and driver that produced it
+	unsigned long long hash = hashString(vertexSource);
+	hash = hashString(fragmentSource, hash);
+	hash = hashString(glString(GL_VENDOR), hash);
+	hash = hashString(glString(GL_RENDERER), hash);
+	hash = hashString(glString(GL_VERSION), hash);
+	hash = hashString(glString(GL_SHADING_LANGUAGE_VERSION), hash);
+
+	char hex[17];
+	std::snprintf(hex, sizeof(hex), "%016llx", hash);
+	return m_cacheDirectory + "/" + name + "-" + hex + ".bin";
+}
+
+GLuint ShaderManager::LoadBinary(const std::string& path) {
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file) return 0;
+
+	unsigned int magic = 0;
+	GLenum format = 0;
+	GLint length = 0;
+	file.read((char*)&magic, sizeof(magic));
+	file.read((char*)&format, sizeof(format));
+	file.read((char*)&length, sizeof(length));
+	if (!file || magic != PROGRAM_BINARY_MAGIC || length <= 0) return 0;
+
+	std::vector<char> binary(length);
+	file.read(&binary[0], length);
+	if (!file) return 0;
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, format, &binary[0], length);
+
+	// the driver rejects binaries it can't use anymore, we then fall back to the sources
+	GLint success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+void ShaderManager::SaveBinary(const std::string& path, GLuint program) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, &binary[0]);
+
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file) {
+		std::cerr << "Can't write the shader cache " << path << std::endl;
+		return;
+	}
+	unsigned int magic = PROGRAM_BINARY_MAGIC;
+	file.write((const char*)&magic, sizeof(magic));
+	file.write((const char*)&format, sizeof(format));
+	file.write((const char*)&length, sizeof(length));
+	file.write(&binary[0], length);
+}
+
+void ShaderManager::SetupProgram(GLuint program) {
+	BindUniformBlocks(program);
+}
+
+bool ShaderManager::ReadFile(const std::string& path, std::string& contents) {
+	std::ifstream file(path.c_str());
+	if (!file) {
+		std::cerr << "Can't open the shader " << path << std::endl;
+		return false;
+	}
+	std::stringstream stream;
+	stream << file.rdbuf();
+	contents = stream.str();
+	return true;
+}
+
+time_t ShaderManager::GetModificationTime(const std::string& path) {
+#ifdef _WIN32
+	struct _stat info;
+	if (_stat(path.c_str(), &info) != 0) return 0;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) return 0;
+#endif
+	return info.st_mtime;
+}
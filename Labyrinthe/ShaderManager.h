@@ -0,0 +1,77 @@
+#ifndef BULLETOPENGL_SHADERMANAGER_H
+#define BULLETOPENGL_SHADERMANAGER_H
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <GL/glew.h>
+
+// owns the GLSL programs of the application.
+//
+// Programs are built from source files. When the driver supports program
+// binaries (GL 4.1 / GL_ARB_get_program_binary), the linked binary is saved in
+// the cache directory, keyed by a hash of the sources and of the driver strings,
+// and loaded directly on the next start. Compile and link logs are always
+// reported on std::cerr.
+//
+// Programs are referenced by id rather than GL name, since hot reloading
+// replaces the GL program: call GetProgram/UseProgram every frame.
+class ShaderManager {
+public:
+	ShaderManager(const std::string& cacheDirectory = "shadercache");
+	~ShaderManager();
+
+	// build a program from a vertex and a fragment shader file.
+	// Returns the program id, or -1 on failure.
+	int LoadProgram(const std::string& name, const std::string& vertexPath, const std::string& fragmentPath);
+
+	GLuint GetProgram(int id) const;
+
+	// glUseProgram, skipped when the program is already bound
+	void UseProgram(int id);
+
+	// rebuild the programs whose source files changed on disk. A program that
+	// fails to compile keeps its previous version. Returns the number reloaded.
+	int ReloadModifiedPrograms();
+
+	// delete every program, must be called while the context is alive
+	void Destroy();
+
+	int GetCacheHits() const { return m_cacheHits; }
+	int GetCacheMisses() const { return m_cacheMisses; }
+
+private:
+	struct Program {
+		std::string name;
+		std::string vertexPath;
+		std::string fragmentPath;
+		time_t vertexTime;
+		time_t fragmentTime;
+		GLuint program;
+	};
+
+	// build (or load from the cache) a program from its sources, 0 on failure
+	GLuint BuildProgram(const std::string& name, const std::string& vertexSource, const std::string& fragmentSource);
+	GLuint CompileShader(const std::string& name, GLenum type, const std::string& source);
+
+	// binary cache
+	bool BinaryCacheSupported();
+	std::string GetCachePath(const std::string& name, const std::string& vertexSource, const std::string& fragmentSource);
+	GLuint LoadBinary(const std::string& path);
+	void SaveBinary(const std::string& path, GLuint program);
+
+	// called after every successful link or binary load
+	void SetupProgram(GLuint program);
+
+	static bool ReadFile(const std::string& path, std::string& contents);
+	static time_t GetModificationTime(const std::string& path);
+
+	std::string m_cacheDirectory;
+	std::vector<Program> m_programs;
+	GLuint m_boundProgram;
+	int m_binarySupport; // -1 unknown, 0 no, 1 yes
+	int m_cacheHits;
+	int m_cacheMisses;
+};
+
+#endif //BULLETOPENGL_SHADERMANAGER_H
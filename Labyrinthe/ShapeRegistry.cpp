@@ -0,0 +1,112 @@
+#include "ShapeRegistry.h"
+#include "ObjectPools.h"
+
+bool ShapeRegistry::Key::operator<(const Key& other) const {
+	if (type != other.type) return type < other.type;
+	if (x != other.x) return x < other.x;
+	if (y != other.y) return y < other.y;
+	if (z != other.z) return z < other.z;
+	return asset < other.asset;
+}
+
+ShapeRegistry::ShapeRegistry(ObjectPools& pools) :
+	m_pools(pools),
+	m_sharedAcquires(0),
+	m_createdShapes(0)
+{
+}
+
+ShapeRegistry::~ShapeRegistry() {
+	for (std::map<Key, btCollisionShape*>::iterator it = m_shapes.begin(); it != m_shapes.end(); ++it) {
+		m_pools.DestroyShape(it->second);
+	}
+}
+
+btBoxShape* ShapeRegistry::AcquireBox(const btVector3& halfExtents) {
+	Key key = { KEY_BOX, halfExtents.x(), halfExtents.y(), halfExtents.z(), std::string() };
+	btCollisionShape* pShape = Find(key);
+	if (!pShape) {
+		pShape = m_pools.CreateBoxShape(halfExtents);
+		Add(key, pShape);
+	}
+	return (btBoxShape*)pShape;
+}
+
+btSphereShape* ShapeRegistry::AcquireSphere(btScalar radius) {
+	Key key = { KEY_SPHERE, radius, 0.0f, 0.0f, std::string() };
+	btCollisionShape* pShape = Find(key);
+	if (!pShape) {
+		pShape = m_pools.CreateSphereShape(radius);
+		Add(key, pShape);
+	}
+	return (btSphereShape*)pShape;
+}
+
+btCylinderShape* ShapeRegistry::AcquireCylinder(const btVector3& halfExtents) {
+	Key key = { KEY_CYLINDER, halfExtents.x(), halfExtents.y(), halfExtents.z(), std::string() };
+	btCollisionShape* pShape = Find(key);
+	if (!pShape) {
+		pShape = m_pools.CreateCylinderShape(halfExtents);
+		Add(key, pShape);
+	}
+	return (btCylinderShape*)pShape;
+}
+
+btCollisionShape* ShapeRegistry::AcquireAsset(const std::string& assetId) {
+	Key key = { KEY_ASSET, 0.0f, 0.0f, 0.0f, assetId };
+	return Find(key);
+}
+
+bool ShapeRegistry::RegisterAsset(const std::string& assetId, btCollisionShape* pShape) {
+	Key key = { KEY_ASSET, 0.0f, 0.0f, 0.0f, assetId };
+	if (!pShape || m_shapes.count(key) || m_entries.count(pShape)) return false;
+	Add(key, pShape);
+	return true;
+}
+
+bool ShapeRegistry::AddReference(btCollisionShape* pShape) {
+	std::unordered_map<const btCollisionShape*, Entry>::iterator it = m_entries.find(pShape);
+	if (it == m_entries.end()) return false;
+	++it->second.references;
+	return true;
+}
+
+bool ShapeRegistry::Release(btCollisionShape* pShape) {
+	std::unordered_map<const btCollisionShape*, Entry>::iterator it = m_entries.find(pShape);
+	if (it == m_entries.end()) return false;
+	if (--it->second.references <= 0) {
+		m_shapes.erase(it->second.key);
+		m_entries.erase(it);
+		m_pools.DestroyShape(pShape);
+	}
+	return true;
+}
+
+int ShapeRegistry::GetReferenceCount(const btCollisionShape* pShape) const {
+	std::unordered_map<const btCollisionShape*, Entry>::const_iterator it = m_entries.find(pShape);
+	return it != m_entries.end() ? it->second.references : 0;
+}
+
+void ShapeRegistry::PrintStats(std::ostream& out) const {
+	int references = 0;
+	for (std::unordered_map<const btCollisionShape*, Entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+		references += it->second.references;
+	}
+	out << "Shape registry: " << m_entries.size() << " shapes for " << references << " references, "
+		<< m_createdShapes << " created, " << m_sharedAcquires << " shared" << std::endl;
+}
+
+btCollisionShape* ShapeRegistry::Find(const Key& key) {
+	std::map<Key, btCollisionShape*>::iterator it = m_shapes.find(key);
+	if (it == m_shapes.end()) return nullptr;
+	++m_entries[it->second].references;
+	++m_sharedAcquires;
+	return it->second;
+}
+
+void ShapeRegistry::Add(const Key& key, btCollisionShape* pShape) {
+	m_shapes[key] = pShape;
+	Entry entry = { key, 1 };
+	m_entries[pShape] = entry;
+	++m_createdShapes;
+}
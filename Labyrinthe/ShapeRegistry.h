@@ -0,0 +1,74 @@
+#ifndef BULLETOPENGL_SHAPEREGISTRY_H
+#define BULLETOPENGL_SHAPEREGISTRY_H
+
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <iostream>
+
+#include <Bullet/btBulletCollisionCommon.h>
+
+class ObjectPools;
+
+// One shape for all the bodies that need the same one. Simple shapes are
+// found by their parameters (box and cylinder half extents, sphere
+// radius), and shapes built elsewhere (triangle meshes, hulls) by an asset
+// id. Each shape keeps a count of its users and goes back to the pools
+// with the last one, so a crowd of identical agents shares a single shape
+// and Bullet's data cached in it.
+class ShapeRegistry {
+public:
+	explicit ShapeRegistry(ObjectPools& pools);
+	// shapes still referenced are destroyed with the registry
+	~ShapeRegistry();
+
+	// one more reference to the shape with these parameters, created the first time
+	btBoxShape* AcquireBox(const btVector3& halfExtents);
+	btSphereShape* AcquireSphere(btScalar radius);
+	btCylinderShape* AcquireCylinder(const btVector3& halfExtents);
+
+	// one more reference to the shape registered under this id, null if there is none
+	btCollisionShape* AcquireAsset(const std::string& assetId);
+	// the registry takes the shape over, the caller holds the first
+	// reference. False (and the shape stays the caller's) if the id is taken
+	bool RegisterAsset(const std::string& assetId, btCollisionShape* pShape);
+
+	// one more reference to a shape from the registry
+	bool AddReference(btCollisionShape* pShape);
+	// one reference less, the last one destroys the shape. False when the
+	// shape isn't from the registry
+	bool Release(btCollisionShape* pShape);
+
+	int GetShapeCount() const { return (int)m_entries.size(); }
+	int GetReferenceCount(const btCollisionShape* pShape) const;
+	// acquires that got an existing shape, and the ones that created it
+	unsigned long long GetSharedAcquires() const { return m_sharedAcquires; }
+	unsigned long long GetCreatedShapes() const { return m_createdShapes; }
+	void PrintStats(std::ostream& out) const;
+
+private:
+	enum KeyType { KEY_BOX, KEY_SPHERE, KEY_CYLINDER, KEY_ASSET };
+	struct Key {
+		KeyType type;
+		btScalar x, y, z;
+		std::string asset;
+
+		bool operator<(const Key& other) const;
+	};
+	struct Entry {
+		Key key;
+		int references;
+	};
+
+	// the shape for the key with one more reference, null if there is none
+	btCollisionShape* Find(const Key& key);
+	void Add(const Key& key, btCollisionShape* pShape);
+
+	ObjectPools& m_pools;
+	std::map<Key, btCollisionShape*> m_shapes;
+	std::unordered_map<const btCollisionShape*, Entry> m_entries;
+	unsigned long long m_sharedAcquires;
+	unsigned long long m_createdShapes;
+};
+
+#endif //BULLETOPENGL_SHAPEREGISTRY_H
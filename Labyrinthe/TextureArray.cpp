@@ -0,0 +1,164 @@
+#include "TextureArray.h"
+#include "TextureDecodePool.h"
+#include "DdsTexture.h"
+#include "HdrTexture.h"
+#include <iostream>
+#include <algorithm>
+#include <SOIL2/SOIL2.h>
+#include <SOIL2/image_helper.h>
+#include <SOIL2/stb_image.h>
+
+TextureArray::TextureArray() : texture(0), format(GL_RGBA8), layerSize(0), levelCount(0), uploadedCount(0) {
+}
+
+TextureArray::~TextureArray() {
+    destroy();
+}
+
+void TextureArray::destroy() {
+    if (texture) {
+        glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+    layers.clear();
+    format = GL_RGBA8;
+    layerSize = 0;
+    levelCount = 0;
+    uploadedCount = 0;
+}
+
+int TextureArray::build(const std::vector<std::string>& paths, TextureDecodePool& pool, int maxSize) {
+    destroy();
+
+    struct Image {
+        std::string path;
+        int width, height;
+        DdsImage baked; // levels only, from the header
+        bool isBaked;
+    };
+    std::vector<Image> images;
+
+    // only the sizes are read here, the pixels are decoded on the pool
+    for (const std::string& path : paths) {
+        if (layers.count(path)) continue;
+        if (HdrTexture::isHdrPath(path)) {
+            // decoded to half floats, they can't share the array
+            continue;
+        }
+
+        Image image;
+        image.path = path;
+        image.isBaked = pool.getUseCompressed() && DdsTexture::isSupported()
+            && DdsTexture::loadHeader(DdsTexture::getCompressedPath(path), image.baked);
+        if (image.isBaked) {
+            image.width = image.baked.getWidth();
+            image.height = image.baked.getHeight();
+        }
+        else {
+            int channels;
+            if (!stbi_info(path.c_str(), &image.width, &image.height, &channels)) {
+                std::cerr << "Failed to load texture: " << path << std::endl;
+                continue;
+            }
+        }
+        if (image.width > maxSize || image.height > maxSize) {
+            // too big to share a layer size with the others
+            continue;
+        }
+        layerSize = std::max(layerSize, std::max(image.width, image.height));
+        layers[path] = (int)images.size();
+        images.push_back(image);
+    }
+
+    if (images.empty()) {
+        return 0;
+    }
+
+    // the baked mip chains go in as they are when every layer has the same
+    // format and size, a single source image decodes the whole array
+    const DdsImage& first = images[0].baked;
+    bool compressed = true;
+    for (const Image& image : images) {
+        compressed = compressed && image.isBaked && image.width == layerSize && image.height == layerSize
+            && image.baked.format == first.format && image.baked.levels.size() == first.levels.size();
+    }
+
+    GLsizei layerCount = (GLsizei)images.size();
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (compressed) {
+        format = first.format;
+        levelCount = (int)first.levels.size();
+        for (int i = 0; i < levelCount; ++i) {
+            const DdsLevel& level = first.levels[i];
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, format, level.width, level.height, layerCount, 0, (GLsizei)(level.size * layerCount), nullptr);
+        }
+    }
+    else {
+        // the smaller levels are generated once the last layer is in
+        format = GL_RGBA8;
+        levelCount = 1;
+        for (int size = layerSize; size > 1; size /= 2) levelCount++;
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerSize, layerSize, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    for (size_t i = 0; i < images.size(); ++i) {
+        pool.requestLayer(images[i].path, this, (int)i, compressed);
+    }
+
+    std::cout << "Texture array: " << images.size() << " layers of " << layerSize << "x" << layerSize
+        << (compressed ? ", baked" : "") << std::endl;
+    return (int)images.size();
+}
+
+void TextureArray::uploadLayer(int layer, const unsigned char* pPixels, int width, int height, const DdsImage* pCompressed) {
+    if (!texture || layer < 0 || layer >= getLayerCount()) return;
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    if (isCompressed()) {
+        // the DDS file may have been baked again since build() read its header
+        if (pCompressed && pCompressed->format == format && pCompressed->getWidth() == layerSize
+            && pCompressed->getHeight() == layerSize && (int)pCompressed->levels.size() == levelCount) {
+            for (int i = 0; i < levelCount; ++i) {
+                const DdsLevel& level = pCompressed->levels[i];
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, level.width, level.height, 1, format, (GLsizei)level.size, &pCompressed->data[level.offset]);
+            }
+        }
+        else {
+            std::cerr << "Texture array layer " << layer << " doesn't match the baked layers, left empty" << std::endl;
+        }
+    }
+    else if (pPixels && width <= layerSize && height <= layerSize) {
+        std::vector<unsigned char> resized;
+        if (width != layerSize || height != layerSize) {
+            resized.resize((size_t)layerSize * layerSize * 4);
+            up_scale_image(pPixels, width, height, 4, &resized[0], layerSize, layerSize);
+            pPixels = &resized[0];
+        }
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, layerSize, layerSize, 1, GL_RGBA, GL_UNSIGNED_BYTE, pPixels);
+    }
+    else {
+        std::cerr << "Texture array layer " << layer << " failed to decode, left empty" << std::endl;
+    }
+
+    uploadedCount++;
+    if (!isCompressed() && isComplete()) {
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+int TextureArray::getLayer(const std::string& path) const {
+    std::map<std::string, int>::const_iterator it = layers.find(path);
+    return it != layers.end() ? it->second : -1;
+}
+
+void TextureArray::bind() const {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+}
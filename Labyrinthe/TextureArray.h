@@ -0,0 +1,68 @@
+/*
+    Packs small textures into the layers of a single GL_TEXTURE_2D_ARRAY.
+
+    Every object whose image is in the array samples it with its layer index
+    (ObjectData.textureLayer, see UniformBuffers.h), so all of them are drawn
+    with one program and one texture bind. Layers keep their own [0, 1] uv
+    space and wrap mode, so no uv needs rewriting and GL_REPEAT still works.
+
+    build() only reads the image sizes, the layers are decoded on the workers
+    of a TextureDecodePool and uploaded by its uploadFinished() as they come
+    in. When every image has a baked DDS file of the same format and size the
+    array is block compressed and takes their mip chains as they are,
+    otherwise the layers are decoded to RGBA8, images smaller than the layer
+    size are scaled up and larger ones are left out and keep their own texture.
+*/
+
+#ifndef TEXTUREARRAY_H_INCLUDED
+#define TEXTUREARRAY_H_INCLUDED
+
+#include <map>
+#include <vector>
+#include <string>
+#include <GL/glew.h>
+
+class TextureDecodePool;
+struct DdsImage;
+
+class TextureArray {
+public:
+    TextureArray();
+    ~TextureArray();
+
+    // allocate the array and queue the decoding of its layers on the pool.
+    // The layer size is the largest image no bigger than maxSize. Returns the
+    // layer count. The pool must be finished before the array is rebuilt or
+    // destroyed
+    int build(const std::vector<std::string>& paths, TextureDecodePool& pool, int maxSize = 1024);
+
+    // called by the pool on the render thread with a decoded layer, either
+    // RGBA pixels or a baked image. Both are null when the decoding failed
+    void uploadLayer(int layer, const unsigned char* pPixels, int width, int height, const DdsImage* pCompressed);
+
+    // layer of an image, -1 when it isn't in the array
+    int getLayer(const std::string& path) const;
+
+    GLuint getTexture() const { return texture; }
+    int getLayerCount() const { return (int)layers.size(); }
+    int getLayerSize() const { return layerSize; }
+    bool isCompressed() const { return format != GL_RGBA8; }
+
+    // every layer has been uploaded
+    bool isComplete() const { return uploadedCount == (int)layers.size(); }
+
+    void bind() const;
+
+    // delete the texture, must be called while the context is alive
+    void destroy();
+
+private:
+    GLuint texture;
+    GLenum format;
+    int layerSize;
+    int levelCount;
+    int uploadedCount;
+    std::map<std::string, int> layers;
+};
+
+#endif // TEXTUREARRAY_H_INCLUDED
@@ -0,0 +1,156 @@
+#include "TextureCache.h"
+#include "TextureDecodePool.h"
+#include "TextureLoader.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+TextureCache::TextureCache(TextureDecodePool* pool) : pool(pool) {
+}
+
+TextureCache::~TextureCache() {
+    clear();
+}
+
+GLuint TextureCache::acquire(const std::string& path) {
+    std::string key = normalizePath(path);
+    std::map<std::string, Entry>::iterator it = entries.find(key);
+    if (it != entries.end()) {
+        it->second.refCount++;
+        return it->second.texture;
+    }
+
+    Entry entry;
+    glGenTextures(1, &entry.texture);
+    entry.refCount = 1;
+    if (pool) {
+        pool->request(key, entry.texture);
+    }
+    else {
+        TextureLoader::loadTexture(key.c_str(), entry.texture);
+    }
+    entries[key] = entry;
+    return entry.texture;
+}
+
+void TextureCache::release(const std::string& path) {
+    std::map<std::string, Entry>::iterator it = entries.find(normalizePath(path));
+    if (it == entries.end() || it->second.refCount == 0) {
+        std::cerr << "TextureCache: release of a texture not acquired: " << path << std::endl;
+        return;
+    }
+    it->second.refCount--;
+}
+
+void TextureCache::release(GLuint texture) {
+    for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        if (it->second.texture == texture) {
+            release(it->first);
+            return;
+        }
+    }
+}
+
+bool TextureCache::evict(const std::string& path) {
+    std::map<std::string, Entry>::iterator it = entries.find(normalizePath(path));
+    if (it == entries.end()) return false;
+    if (it->second.refCount > 0) {
+        std::cerr << "TextureCache: " << path << " is still used " << it->second.refCount << " time(s), not evicted" << std::endl;
+        return false;
+    }
+    glDeleteTextures(1, &it->second.texture);
+    entries.erase(it);
+    return true;
+}
+
+size_t TextureCache::evictUnused() {
+    size_t freed = 0;
+    for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end();) {
+        if (it->second.refCount == 0) {
+            freed += getTextureBytes(it->second.texture);
+            glDeleteTextures(1, &it->second.texture);
+            it = entries.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    return freed;
+}
+
+void TextureCache::clear() {
+    for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        glDeleteTextures(1, &it->second.texture);
+    }
+    entries.clear();
+}
+
+size_t TextureCache::getResidentBytes() const {
+    size_t total = 0;
+    for (std::map<std::string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        total += getTextureBytes(it->second.texture);
+    }
+    return total;
+}
+
+void TextureCache::printMemoryReport() const {
+    std::cout << "texture, refs, size, KB" << std::endl;
+    size_t total = 0;
+    for (std::map<std::string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        GLint width = 0, height = 0;
+        glBindTexture(GL_TEXTURE_2D, it->second.texture);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        size_t bytes = getTextureBytes(it->second.texture);
+        total += bytes;
+        std::cout << it->first << ", " << it->second.refCount << ", " << width << "x" << height << ", "
+            << std::fixed << std::setprecision(1) << bytes / 1024.0 << std::endl;
+    }
+    std::cout << "# " << entries.size() << " resident textures, " << total / 1024.0 << " KB" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
+
+std::string TextureCache::normalizePath(const std::string& path) {
+    std::string key = path;
+    std::replace(key.begin(), key.end(), '\\', '/');
+    return key;
+}
+
+/*
+    Sums the size of every level the texture has. Uncompressed formats are
+    counted from their internal format, compressed ones as reported by GL
+*/
+size_t TextureCache::getTextureBytes(GLuint texture) {
+    size_t total = 0;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for (GLint level = 0;; ++level) {
+        GLint width = 0, height = 0, compressed = GL_FALSE, internalFormat = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+        if (width == 0 || height == 0) break;
+
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+        if (compressed) {
+            GLint size = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            total += size;
+        }
+        else {
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+            size_t bytesPerPixel = 4;
+            switch (internalFormat) {
+            case GL_RGB16F: bytesPerPixel = 6; break;
+            case GL_RGBA16F: bytesPerPixel = 8; break;
+            case GL_RGB32F: bytesPerPixel = 12; break;
+            case GL_RGBA32F: bytesPerPixel = 16; break;
+            case GL_RGB8: bytesPerPixel = 3; break;
+            }
+            total += (size_t)width * height * bytesPerPixel;
+        }
+        if (width == 1 && height == 1) break;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return total;
+}
@@ -0,0 +1,62 @@
+/*
+    Shares GL textures between everything that uses the same image file.
+
+    acquire() returns the texture of a path and takes a reference on it, only
+    the first call for a path creates the texture and queues its decoding on
+    the pool (or loads it right away when there is no pool). release() drops
+    the reference; unreferenced textures stay resident so they can be
+    acquired again for free, until evictUnused() (or evict()) deletes them.
+*/
+
+#ifndef TEXTURECACHE_H_INCLUDED
+#define TEXTURECACHE_H_INCLUDED
+
+#include <map>
+#include <string>
+#include <GL/glew.h>
+
+class TextureDecodePool;
+
+class TextureCache {
+public:
+    TextureCache(TextureDecodePool* pool = nullptr);
+    ~TextureCache();
+
+    // texture of the image file, with a new reference
+    GLuint acquire(const std::string& path);
+
+    // drop a reference taken by acquire()
+    void release(const std::string& path);
+    void release(GLuint texture);
+
+    // delete one texture, refused while it is still referenced
+    bool evict(const std::string& path);
+
+    // delete every texture that is no longer referenced, returns the bytes freed
+    size_t evictUnused();
+
+    // delete every texture, must be called while the context is alive
+    void clear();
+
+    int getTextureCount() const { return (int)entries.size(); }
+
+    // GPU memory used by the resident textures, queried from GL
+    size_t getResidentBytes() const;
+
+    // one line per resident texture with its size and reference count
+    void printMemoryReport() const;
+
+private:
+    struct Entry {
+        GLuint texture;
+        int refCount;
+    };
+
+    static std::string normalizePath(const std::string& path);
+    static size_t getTextureBytes(GLuint texture);
+
+    std::map<std::string, Entry> entries;
+    TextureDecodePool* pool;
+};
+
+#endif // TEXTURECACHE_H_INCLUDED
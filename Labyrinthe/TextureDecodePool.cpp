@@ -0,0 +1,191 @@
+#include "TextureDecodePool.h"
+#include "TextureLoader.h"
+#include "TextureArray.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+TextureDecodePool::TextureDecodePool(int threadCount) : pending(0), stopping(false), useCompressed(true), hdrRgbeDirect(true), start(Clock::now()) {
+    if (threadCount <= 0) {
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        workers.push_back(std::thread(&TextureDecodePool::workerLoop, this, i));
+    }
+}
+
+TextureDecodePool::~TextureDecodePool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAdded.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+
+    // images that were never uploaded
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        if (decoded[i].pPixels) SOIL_free_image_data(decoded[i].pPixels);
+    }
+}
+
+void TextureDecodePool::request(const std::string& path, GLuint texture) {
+    queue(path, texture, nullptr, -1, useCompressed);
+}
+
+void TextureDecodePool::requestLayer(const std::string& path, TextureArray* pArray, int layer, bool compressed) {
+    queue(path, 0, pArray, layer, compressed);
+}
+
+void TextureDecodePool::queue(const std::string& path, GLuint texture, TextureArray* pArray, int layer, bool compressed) {
+    Job job;
+    job.path = path;
+    job.texture = texture;
+    job.pArray = pArray;
+    job.layer = layer;
+    job.width = job.height = 0;
+    job.pPixels = nullptr;
+    job.isCompressed = false;
+    job.isHdr = false;
+    job.hdrRgbeDirect = hdrRgbeDirect;
+    // agent.dds is baked from agent.jpg, never from the .hdr next to it
+    if (compressed && DdsTexture::isSupported() && !HdrTexture::isHdrPath(path)) {
+        job.compressedPath = DdsTexture::getCompressedPath(path);
+    }
+    job.thread = -1;
+    job.queuedMs = elapsedMs();
+    job.decodeStartMs = job.decodeEndMs = job.uploadEndMs = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(std::move(job));
+        pending++;
+    }
+    jobAdded.notify_one();
+}
+
+void TextureDecodePool::workerLoop(int thread) {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAdded.wait(lock, [this] { return stopping || !queued.empty(); });
+            if (stopping) return;
+            job = std::move(queued.front());
+            queued.pop_front();
+        }
+
+        // the slow part, outside of the lock
+        job.thread = thread;
+        job.decodeStartMs = elapsedMs();
+        if (!job.compressedPath.empty() && DdsTexture::load(job.compressedPath, job.compressed)) {
+            // baked texture, nothing to decode
+            job.isCompressed = true;
+            job.width = job.compressed.getWidth();
+            job.height = job.compressed.getHeight();
+        }
+        else if (HdrTexture::isHdrPath(job.path)) {
+            // kept in floating point, converted to halves here rather than by the driver
+            job.isHdr = HdrTexture::decode(job.path, job.hdr, job.hdrRgbeDirect);
+            job.width = job.isHdr ? job.hdr.width : 0;
+            job.height = job.isHdr ? job.hdr.height : 0;
+        }
+        else {
+            int channels;
+            job.pPixels = SOIL_load_image(job.path.c_str(), &job.width, &job.height, &channels, SOIL_LOAD_RGBA);
+        }
+        job.decodeEndMs = elapsedMs();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(std::move(job));
+        }
+        jobDecoded.notify_all();
+    }
+}
+
+int TextureDecodePool::uploadFinished() {
+    std::vector<Job> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(decoded);
+    }
+
+    for (size_t i = 0; i < ready.size(); ++i) {
+        Job& job = ready[i];
+        if (job.pArray) {
+            // the array reports its own failures
+            job.pArray->uploadLayer(job.layer, job.pPixels, job.width, job.height, job.isCompressed ? &job.compressed : nullptr);
+            if (job.pPixels) SOIL_free_image_data(job.pPixels);
+            job.pPixels = nullptr;
+            job.compressed = DdsImage();
+            job.hdr = HdrImage();
+        }
+        else if (job.isCompressed) {
+            DdsTexture::upload(job.texture, job.compressed);
+            // only the timings are kept
+            job.compressed = DdsImage();
+        }
+        else if (job.isHdr) {
+            HdrTexture::upload(job.texture, job.hdr);
+            job.hdr = HdrImage();
+        }
+        else if (job.pPixels) {
+            TextureLoader::uploadTexture(job.texture, job.width, job.height, job.pPixels);
+            SOIL_free_image_data(job.pPixels);
+            job.pPixels = nullptr;
+        }
+        else {
+            std::cerr << "Failed to load texture: " << job.path << std::endl;
+        }
+        job.uploadEndMs = elapsedMs();
+        completed.push_back(std::move(job));
+    }
+
+    if (!ready.empty()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending -= (int)ready.size();
+    }
+    return (int)ready.size();
+}
+
+void TextureDecodePool::finish() {
+    for (;;) {
+        uploadFinished();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (pending == 0) return;
+        // sleep until a worker hands over a new image
+        jobDecoded.wait(lock, [this] { return !decoded.empty(); });
+    }
+}
+
+int TextureDecodePool::getPendingCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending;
+}
+
+void TextureDecodePool::printTimings() {
+    if (completed.empty()) return;
+
+    double firstQueued = completed[0].queuedMs, lastUpload = 0.0, decodeSum = 0.0;
+    std::cout << "texture, thread, queued ms, decode start ms, decode end ms, upload end ms, size" << std::endl;
+    for (size_t i = 0; i < completed.size(); ++i) {
+        const Job& job = completed[i];
+        std::cout << std::fixed << std::setprecision(1)
+            << job.path << ", " << job.thread << ", " << job.queuedMs << ", " << job.decodeStartMs << ", "
+            << job.decodeEndMs << ", " << job.uploadEndMs << ", " << job.width << "x" << job.height
+            << (job.isCompressed ? " dds" : job.isHdr ? " hdr" : "") << std::endl;
+        firstQueued = std::min(firstQueued, job.queuedMs);
+        lastUpload = std::max(lastUpload, job.uploadEndMs);
+        decodeSum += job.decodeEndMs - job.decodeStartMs;
+    }
+    std::cout << "# " << completed.size() << " textures on " << workers.size() << " threads: "
+        << lastUpload - firstQueued << " ms from first request to last upload, "
+        << decodeSum << " ms of decoding in total" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
+
+double TextureDecodePool::elapsedMs() {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
@@ -0,0 +1,107 @@
+/*
+    Decodes image files on a pool of worker threads.
+
+    Decoding a JPEG or PNG is pure CPU work and doesn't need the GL context, so
+    request() only queues the file and returns. The decoded pixels wait in the
+    pool until the render thread calls uploadFinished() (or finish()), which
+    does the glTexImage2D calls. Textures requested together decode in parallel,
+    and in parallel with whatever the render thread does in the meantime.
+
+    When a baked DDS file sits next to the source image (see DdsTexture) the
+    workers only read it from disk, and the upload skips glGenerateMipmap.
+    Radiance .hdr files are converted to half floats on the workers too (see
+    HdrTexture) and uploaded as GL_RGB16F.
+
+    The layers of a TextureArray go through the pool as well, requestLayer()
+    hands the decoded image to the array instead of a texture of its own.
+*/
+
+#ifndef TEXTUREDECODEPOOL_H_INCLUDED
+#define TEXTUREDECODEPOOL_H_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <GL/glew.h>
+
+#include "DdsTexture.h"
+#include "HdrTexture.h"
+
+class TextureArray;
+
+class TextureDecodePool {
+public:
+    // 0 threads uses one per hardware thread
+    TextureDecodePool(int threadCount = 0);
+    ~TextureDecodePool();
+
+    // queue a file to decode into the given texture
+    void request(const std::string& path, GLuint texture);
+
+    // queue a file to decode into a layer of the array, compressed picks the
+    // baked DDS file over the source image
+    void requestLayer(const std::string& path, TextureArray* pArray, int layer, bool compressed);
+
+    // upload the images decoded so far, on the render thread.
+    // Returns the number of textures uploaded
+    int uploadFinished();
+
+    // wait for every queued request and upload it
+    void finish();
+
+    // use baked DDS files when they exist, on by default
+    void setUseCompressed(bool enabled) { useCompressed = enabled; }
+    bool getUseCompressed() const { return useCompressed; }
+
+    // convert .hdr pixels from RGBE straight to halves (default), or through stb floats
+    void setHdrRgbeDirect(bool enabled) { hdrRgbeDirect = enabled; }
+
+    // requests not uploaded yet
+    int getPendingCount();
+
+    // decode and upload times of every texture since the pool was created
+    void printTimings();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Job {
+        std::string path;
+        std::string compressedPath; // empty when compressed textures are off
+        GLuint texture;
+        TextureArray* pArray; // decoded into one of its layers instead of the texture
+        int layer;
+        int width, height;
+        unsigned char* pPixels;
+        DdsImage compressed;
+        bool isCompressed;
+        HdrImage hdr;
+        bool isHdr;
+        bool hdrRgbeDirect;
+        int thread;
+        double queuedMs, decodeStartMs, decodeEndMs, uploadEndMs;
+    };
+
+    void queue(const std::string& path, GLuint texture, TextureArray* pArray, int layer, bool compressed);
+    void workerLoop(int thread);
+    double elapsedMs();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobAdded;
+    std::condition_variable jobDecoded;
+    std::deque<Job> queued;
+    std::vector<Job> decoded;
+    std::vector<Job> completed;
+    int pending;
+    bool stopping;
+    bool useCompressed;
+    bool hdrRgbeDirect;
+    Clock::time_point start;
+};
+
+#endif // TEXTUREDECODEPOOL_H_INCLUDED
@@ -7,18 +7,23 @@
 #include <GL/glew.h>
 #include <SOIL2/SOIL2.h>
 
+#include "DdsTexture.h"
+#include "HdrTexture.h"
+
 class TextureLoader {
 public:
     static GLuint loadTexture(const char* path, GLuint texture) {
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        // Set the texture wrapping parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        // HDR images stay in floating point
+        if (HdrTexture::isHdrPath(path)) {
+            HdrImage hdr;
+            return HdrTexture::decode(path, hdr) ? HdrTexture::upload(texture, hdr) : 0;
+        }
 
-        // Set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // Use the baked version of the texture when there is one
+        DdsImage compressed;
+        if (DdsTexture::isSupported() && DdsTexture::load(DdsTexture::getCompressedPath(path), compressed)) {
+            return DdsTexture::upload(texture, compressed);
+        }
 
         // Load image using SOIL2
         int width, height, channels;
@@ -30,15 +35,35 @@ public:
             return 0;
         }
 
+        uploadTexture(texture, width, height, image);
+
+        // Free image data
+        SOIL_free_image_data(image);
+
+        return texture;
+    }
+
+    /*
+        Uploads decoded RGBA pixels to the texture and builds its mipmaps,
+        must be called on the thread that owns the GL context
+    */
+    static GLuint uploadTexture(GLuint texture, int width, int height, const unsigned char* image) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+
+        // Set the texture wrapping parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        // Set texture filtering parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
         // Upload image data to OpenGL
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
 
         // Generate mipmaps
         glGenerateMipmap(GL_TEXTURE_2D);
 
-        // Free image data
-        SOIL_free_image_data(image);
-
         glBindTexture(GL_TEXTURE_2D, 0);
 
         return texture;
@@ -0,0 +1,433 @@
+#include "TextureStreamer.h"
+#include "DdsTexture.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <SOIL2/SOIL2.h>
+#include <SOIL2/image_helper.h>
+
+// frames a level stays resident after the camera stopped needing it
+static const unsigned KEEP_FRAMES = 120;
+
+TextureStreamer::TextureStreamer(size_t budgetBytes) : budget(budgetBytes), frame(0), uploadCount(0), evictionCount(0), stopping(false) {
+    worker = std::thread(&TextureStreamer::workerLoop, this);
+}
+
+TextureStreamer::~TextureStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAdded.notify_all();
+    worker.join();
+}
+
+GLuint TextureStreamer::add(const std::string& path, int startSize) {
+    GLuint existing = getTexture(path);
+    if (existing) return existing;
+
+    Entry entry;
+    entry.path = path;
+    glGenTextures(1, &entry.texture);
+    entry.format = GL_RGBA;
+    entry.compressed = false;
+    entry.ready = false;
+    entry.failed = false;
+    entry.residentBase = 0;
+    entry.startBase = 0;
+    entry.wantedBase = entry.targetBase = 0;
+    entry.finestBase = 0;
+    entry.loadingLevel = -1;
+    entry.startSize = startSize;
+    entry.lastDemandFrame = entry.keepUntilFrame = 0;
+
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    DdsImage header;
+    std::string ddsPath = DdsTexture::getCompressedPath(path);
+    if (DdsTexture::isSupported() && DdsTexture::loadHeader(ddsPath, header)) {
+        // only the small levels at the end of the file are read now
+        entry.ddsPath = ddsPath;
+        entry.format = header.format;
+        entry.compressed = true;
+        entry.levels.resize(header.levels.size());
+        for (size_t i = 0; i < header.levels.size(); ++i) {
+            entry.levels[i].width = header.levels[i].width;
+            entry.levels[i].height = header.levels[i].height;
+            entry.levels[i].size = header.levels[i].size;
+            entry.levels[i].offset = header.levels[i].offset;
+        }
+        entry.startBase = getStartBase(entry.levels, startSize);
+        entry.residentBase = (int)entry.levels.size();
+        for (int i = entry.startBase; i < (int)entry.levels.size(); ++i) {
+            if (!DdsTexture::readLevel(ddsPath, header.levels[i], entry.levels[i].data)) {
+                std::cerr << "Truncated DDS file: " << ddsPath << std::endl;
+                break;
+            }
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)entry.levels.size() - 1);
+        for (int i = (int)entry.levels.size() - 1; i >= entry.startBase && !entry.levels[i].data.empty(); --i) {
+            uploadLevel(entry, i);
+        }
+        entry.ready = true;
+    }
+    else {
+        // a grey texel until the worker has decoded the image
+        const unsigned char grey[4] = { 128, 128, 128, 255 };
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    entries.push_back(std::move(entry));
+    if (!entries.back().ready) {
+        queueJob((int)entries.size() - 1, -1);
+    }
+    return entries.back().texture;
+}
+
+GLuint TextureStreamer::getTexture(const std::string& path) const {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].path == path) return entries[i].texture;
+    }
+    return 0;
+}
+
+bool TextureStreamer::isStreamed(GLuint texture) const {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].texture == texture) return true;
+    }
+    return false;
+}
+
+bool TextureStreamer::isSettled() const {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const Entry& entry = entries[i];
+        if (entry.failed) continue;
+        if (!entry.ready || entry.loadingLevel >= 0 || entry.targetBase < entry.residentBase) return false;
+    }
+    return true;
+}
+
+void TextureStreamer::beginFrame() {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i].demand.clear();
+    }
+}
+
+void TextureStreamer::addDemand(GLuint texture, const AABB& worldBounds) {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].texture == texture) {
+            entries[i].demand.push_back(worldBounds);
+            return;
+        }
+    }
+}
+
+void TextureStreamer::update(const glm::vec3& eye, float pixelsPerUnit) {
+    applyFinishedJobs();
+    chooseLevels(eye, pixelsPerUnit);
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry& entry = entries[i];
+        if (!entry.ready) continue;
+
+        // over budget or not needed anymore, drop the finest levels
+        while (entry.residentBase < entry.targetBase) {
+            dropLevel(entry, entry.residentBase);
+        }
+
+        // one finer level per frame, the worker reads the next one meanwhile
+        if (entry.targetBase < entry.residentBase) {
+            int next = entry.residentBase - 1;
+            if (!entry.levels[next].data.empty()) {
+                uploadLevel(entry, next);
+            }
+            next = entry.residentBase - 1;
+            if (entry.targetBase <= next && entry.levels[next].data.empty() && entry.loadingLevel < 0) {
+                queueJob((int)i, next);
+            }
+        }
+    }
+    frame++;
+}
+
+/*
+    The finest level the screen can show: one level 0 texel per pixel at the
+    point of the bounds closest to the camera. Then the budget is shared
+    between the textures, the ones needed most recently first
+*/
+void TextureStreamer::chooseLevels(const glm::vec3& eye, float pixelsPerUnit) {
+    std::vector<int> order;
+    size_t startBytes = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry& entry = entries[i];
+        if (!entry.ready) continue;
+
+        int wanted = entry.startBase;
+        const Level& top = entry.levels[0];
+        for (size_t d = 0; d < entry.demand.size(); ++d) {
+            const AABB& bounds = entry.demand[d];
+            glm::vec3 size = bounds.max - bounds.min;
+            float worldSize = std::max(size.x, std::max(size.y, size.z));
+            if (worldSize <= 0.0f) continue;
+
+            glm::vec3 closest = glm::clamp(eye, bounds.min, bounds.max);
+            float distance = std::max(glm::length(eye - closest), 0.01f);
+            float pixels = worldSize * pixelsPerUnit / distance;
+            int level = (int)std::floor(std::log2(std::max(top.width, top.height) / std::max(pixels, 1.0f)));
+            wanted = std::min(wanted, std::max(level, 0));
+        }
+        if (!entry.demand.empty()) {
+            entry.lastDemandFrame = frame;
+        }
+        // nothing finer than a level that failed to read
+        wanted = std::max(wanted, entry.finestBase);
+
+        // keep the finer levels a little while before letting them go
+        if (wanted <= entry.residentBase) {
+            entry.keepUntilFrame = frame + KEEP_FRAMES;
+        }
+        else if (frame < entry.keepUntilFrame) {
+            wanted = entry.residentBase;
+        }
+        entry.wantedBase = wanted;
+
+        startBytes += getLevelBytes(entry, entry.startBase);
+        order.push_back((int)i);
+    }
+
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        if (entries[a].lastDemandFrame != entries[b].lastDemandFrame) {
+            return entries[a].lastDemandFrame > entries[b].lastDemandFrame;
+        }
+        return entries[a].wantedBase < entries[b].wantedBase;
+    });
+
+    // the start levels are always resident, the rest of the budget goes
+    // to the textures seen last, the others lose their finest levels
+    size_t remaining = budget > startBytes ? budget - startBytes : 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        Entry& entry = entries[order[i]];
+        size_t startCost = getLevelBytes(entry, entry.startBase);
+        int target = entry.wantedBase;
+        while (target < entry.startBase && getLevelBytes(entry, target) - startCost > remaining) {
+            target++;
+        }
+        // the start levels may be out of reach too after a failed read
+        remaining -= target < entry.startBase ? getLevelBytes(entry, target) - startCost : 0;
+        entry.targetBase = target;
+    }
+}
+
+void TextureStreamer::uploadLevel(Entry& entry, int level) {
+    Level& info = entry.levels[level];
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    if (entry.compressed) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, entry.format, info.width, info.height, 0, (GLsizei)info.size, &info.data[0]);
+    }
+    else {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, info.width, info.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &info.data[0]);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    entry.residentBase = level;
+    uploadCount++;
+
+    // a DDS level can be read again, the decoded chain can't
+    if (!entry.ddsPath.empty()) {
+        std::vector<unsigned char>().swap(info.data);
+    }
+}
+
+void TextureStreamer::dropLevel(Entry& entry, int level) {
+    // a zero sized image releases the memory of the level
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    entry.residentBase = level + 1;
+    evictionCount++;
+}
+
+size_t TextureStreamer::getLevelBytes(const Entry& entry, int base) const {
+    size_t total = 0;
+    for (int i = base; i < (int)entry.levels.size(); ++i) {
+        total += entry.levels[i].size;
+    }
+    return total;
+}
+
+int TextureStreamer::getStartBase(const std::vector<Level>& levels, int startSize) {
+    for (int i = 0; i < (int)levels.size(); ++i) {
+        if (levels[i].width <= startSize && levels[i].height <= startSize) return i;
+    }
+    return (int)levels.size() - 1;
+}
+
+void TextureStreamer::queueJob(int entry, int level) {
+    Job job;
+    job.entry = entry;
+    job.level = level;
+    job.ok = false;
+    if (level < 0) {
+        job.path = entries[entry].path;
+        job.offset = job.size = 0;
+    }
+    else {
+        const Level& info = entries[entry].levels[level];
+        job.path = entries[entry].ddsPath;
+        job.offset = info.offset;
+        job.size = info.size;
+        entries[entry].loadingLevel = level;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(std::move(job));
+    }
+    jobAdded.notify_one();
+}
+
+void TextureStreamer::workerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAdded.wait(lock, [this] { return stopping || !queued.empty(); });
+            if (stopping) return;
+            job = std::move(queued.front());
+            queued.pop_front();
+        }
+
+        if (job.level >= 0) {
+            DdsLevel info = { 0, 0, job.offset, job.size };
+            job.levels.resize(1);
+            job.ok = DdsTexture::readLevel(job.path, info, job.levels[0].data);
+        }
+        else {
+            // decode once and keep every level of the chain
+            int width, height, channels;
+            unsigned char* pPixels = SOIL_load_image(job.path.c_str(), &width, &height, &channels, SOIL_LOAD_RGBA);
+            if (pPixels) {
+                Level level;
+                level.width = width;
+                level.height = height;
+                level.size = (size_t)width * height * 4;
+                level.offset = 0;
+                level.data.assign(pPixels, pPixels + level.size);
+                SOIL_free_image_data(pPixels);
+                job.levels.push_back(std::move(level));
+
+                while (width > 1 || height > 1) {
+                    const Level& previous = job.levels.back();
+                    Level next;
+                    next.width = width > 1 ? width / 2 : 1;
+                    next.height = height > 1 ? height / 2 : 1;
+                    next.size = (size_t)next.width * next.height * 4;
+                    next.offset = 0;
+                    next.data.resize(next.size);
+                    mipmap_image(&previous.data[0], width, height, 4, &next.data[0], width > 1 ? 2 : 1, height > 1 ? 2 : 1);
+                    width = next.width;
+                    height = next.height;
+                    job.levels.push_back(std::move(next));
+                }
+                job.ok = true;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.push_back(std::move(job));
+    }
+}
+
+void TextureStreamer::applyFinishedJobs() {
+    std::vector<Job> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(finished);
+    }
+
+    for (size_t i = 0; i < ready.size(); ++i) {
+        Job& job = ready[i];
+        if (job.entry >= (int)entries.size()) continue; // cleared meanwhile
+        Entry& entry = entries[job.entry];
+
+        // reported once: the level, or the whole image, isn't asked for again
+        if (!job.ok) {
+            std::cerr << "Failed to stream texture: " << job.path << std::endl;
+            if (job.level >= 0) {
+                entry.loadingLevel = -1;
+                entry.finestBase = std::max(entry.finestBase, job.level + 1);
+                entry.targetBase = std::max(entry.targetBase, entry.finestBase);
+            }
+            else {
+                entry.failed = true;
+            }
+            continue;
+        }
+
+        if (job.level >= 0) {
+            entry.levels[job.level].data.swap(job.levels[0].data);
+            entry.loadingLevel = -1;
+            continue;
+        }
+
+        // the decoded image replaces the grey texel, from its start levels
+        entry.levels.swap(job.levels);
+        entry.startBase = getStartBase(entry.levels, entry.startSize);
+        entry.residentBase = (int)entry.levels.size();
+        glBindTexture(GL_TEXTURE_2D, entry.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)entry.levels.size() - 1);
+        for (int level = (int)entry.levels.size() - 1; level >= entry.startBase; --level) {
+            uploadLevel(entry, level);
+        }
+        entry.ready = true;
+    }
+}
+
+size_t TextureStreamer::getResidentBytes() const {
+    size_t total = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].ready) total += getLevelBytes(entries[i], entries[i].residentBase);
+    }
+    return total;
+}
+
+void TextureStreamer::printStats() const {
+    std::cout << "streamed texture, resident, wanted, KB" << std::endl;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const Entry& entry = entries[i];
+        if (!entry.ready) {
+            std::cout << entry.path << (entry.failed ? ", failed" : ", loading") << std::endl;
+            continue;
+        }
+        const Level& resident = entry.levels[std::min(entry.residentBase, (int)entry.levels.size() - 1)];
+        const Level& wanted = entry.levels[entry.wantedBase];
+        std::cout << std::fixed << std::setprecision(1) << entry.path << ", "
+            << resident.width << "x" << resident.height << ", " << wanted.width << "x" << wanted.height << ", "
+            << getLevelBytes(entry, entry.residentBase) / 1024.0 << std::endl;
+    }
+    std::cout << "# " << getResidentBytes() / 1024.0 << " KB of " << budget / 1024.0 << " KB budget, "
+        << uploadCount << " levels uploaded, " << evictionCount << " dropped" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
+
+void TextureStreamer::clear() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.clear();
+        finished.clear();
+    }
+    for (size_t i = 0; i < entries.size(); ++i) {
+        glDeleteTextures(1, &entries[i].texture);
+    }
+    entries.clear();
+}
@@ -0,0 +1,147 @@
+/*
+    Streams the mip levels of large textures (ground.jpg) on demand.
+
+    add() only uploads the small levels of the image (no larger than startSize)
+    so the texture is usable right away. Every frame the objects drawn with a
+    streamed texture report their world bounds with addDemand(); update() turns
+    the closest distance to the camera into the finest level the screen can
+    show, assuming the image is stretched once across the longest side of the
+    bounds, and refines the texture one level per frame toward it. The next
+    level is read from disk on a worker thread while the previous one is
+    drawn, so the render thread only does the glCompressedTexImage2D.
+
+    The resident levels are [base, last]: the levels above the base are never
+    specified and GL_TEXTURE_BASE_LEVEL keeps the texture complete, so a level
+    is added or dropped without touching the others. The budget caps the GPU
+    memory of all the streamed textures; when the levels wanted by this frame
+    don't fit, the textures used least recently lose their finest levels first
+    (a texture never drops below its start levels). Levels no longer needed
+    are only dropped after a delay, so a camera going back and forth doesn't
+    upload the same level over and over.
+
+    Baked DDS files (--bake textures) are streamed level by level from disk.
+    Without one the image is decoded once on the worker and the CPU keeps the
+    whole mip chain, the GPU side is streamed the same way.
+*/
+
+#ifndef TEXTURESTREAMER_H_INCLUDED
+#define TEXTURESTREAMER_H_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+
+class TextureStreamer {
+public:
+    TextureStreamer(size_t budgetBytes = 64 * 1024 * 1024);
+    ~TextureStreamer();
+
+    // create the streamed texture of an image, the levels up to startSize
+    // texels are loaded before it returns
+    GLuint add(const std::string& path, int startSize = 256);
+
+    // texture streamed for this image, 0 when it isn't streamed
+    GLuint getTexture(const std::string& path) const;
+    bool isStreamed(GLuint texture) const;
+
+    // the demand of the previous frame is forgotten
+    void beginFrame();
+
+    // an object drawn with the texture covers these world bounds
+    void addDemand(GLuint texture, const AABB& worldBounds);
+
+    // pick the levels within budget, upload what the worker read and queue
+    // the next reads. pixelsPerUnit is the size on screen of one world unit
+    // at distance 1: projection[1][1] * viewport height / 2
+    void update(const glm::vec3& eye, float pixelsPerUnit);
+
+    void setBudget(size_t bytes) { budget = bytes; }
+    size_t getBudget() const { return budget; }
+
+    // every texture has the levels the last update() wanted and none is
+    // being read: without new demand, further updates change nothing.
+    // Levels and images that failed to read are never retried
+    bool isSettled() const;
+
+    // GPU memory of the resident levels
+    size_t getResidentBytes() const;
+
+    // levels uploaded and dropped since the start
+    int getUploadCount() const { return uploadCount; }
+    int getEvictionCount() const { return evictionCount; }
+
+    // one line per texture with its resident and wanted size
+    void printStats() const;
+
+    // delete the textures, must be called while the context is alive
+    void clear();
+
+private:
+    struct Level {
+        int width, height;
+        size_t size;
+        size_t offset; // in the DDS file
+        std::vector<unsigned char> data; // empty until read, or once uploaded from a DDS file
+    };
+
+    struct Entry {
+        std::string path;
+        std::string ddsPath; // empty when the levels come from the decoded image
+        GLuint texture;
+        GLenum format; // compressed format, or GL_RGBA
+        bool compressed;
+        bool ready; // the level sizes are known
+        bool failed; // the image couldn't be decoded, it stays grey
+        std::vector<Level> levels;
+        int residentBase; // levels.size() when nothing is resident
+        int startBase; // always resident
+        int wantedBase; // from the demand of this frame
+        int targetBase; // wanted, clamped to the budget
+        int finestBase; // below the last level that failed to read, never wanted past it
+        int loadingLevel; // level the worker is reading, -1 when idle
+        int startSize;
+        unsigned lastDemandFrame;
+        unsigned keepUntilFrame; // the finest levels are kept until then
+        std::vector<AABB> demand;
+    };
+
+    struct Job {
+        int entry;
+        int level; // -1 decodes the whole image
+        std::string path;
+        size_t offset, size;
+        // results
+        bool ok;
+        std::vector<Level> levels;
+    };
+
+    void workerLoop();
+    void queueJob(int entry, int level);
+    void applyFinishedJobs();
+    void chooseLevels(const glm::vec3& eye, float pixelsPerUnit);
+    void uploadLevel(Entry& entry, int level);
+    void dropLevel(Entry& entry, int level);
+    size_t getLevelBytes(const Entry& entry, int base) const;
+    static int getStartBase(const std::vector<Level>& levels, int startSize);
+
+    std::vector<Entry> entries;
+    size_t budget;
+    unsigned frame;
+    int uploadCount, evictionCount;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable jobAdded;
+    std::deque<Job> queued;
+    std::vector<Job> finished;
+    bool stopping;
+};
+
+#endif // TEXTURESTREAMER_H_INCLUDED
@@ -0,0 +1,149 @@
+#include "TransformSync.h"
+
+#include <algorithm>
+
+TransformSync::TransformSync() :
+	m_syncCount(1),
+	m_changedCount(0)
+{
+}
+
+int TransformSync::Add(OpenGLMotionState* pMotionState, const glm::mat4& model, const glm::mat4& bodyToModel) {
+	int slot;
+	if (!m_freeSlots.empty()) {
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else {
+		slot = (int)m_matrices.size();
+		m_matrices.push_back(model);
+		m_bodyToModel.push_back(bodyToModel);
+		m_motionStates.push_back(nullptr);
+		m_changedSync.push_back(0);
+		m_inMotion.push_back(0);
+	}
+	m_matrices[slot] = model;
+	m_bodyToModel[slot] = bodyToModel;
+	m_motionStates[slot] = pMotionState;
+	// its first matrix counts as a change of this sync
+	if (m_changedSync[slot] != m_syncCount) {
+		m_changedSync[slot] = m_syncCount;
+		++m_changedCount;
+	}
+	m_inMotion[slot] = 0;
+	if (pMotionState) {
+		pMotionState->SetDirtyList(&m_dirty, slot);
+	}
+	return slot;
+}
+
+void TransformSync::Remove(int slot) {
+	if (slot < 0 || slot >= (int)m_motionStates.size()) return;
+	if (m_motionStates[slot]) {
+		m_motionStates[slot]->SetDirtyList(nullptr, -1);
+	}
+	// off the dirty lists too, or the next object in the slot would be
+	// written from them before its body ever moved
+	m_dirty.erase(std::remove(m_dirty.begin(), m_dirty.end(), slot), m_dirty.end());
+	m_settled.erase(std::remove(m_settled.begin(), m_settled.end(), slot), m_settled.end());
+	m_motionStates[slot] = nullptr;
+	m_freeSlots.push_back(slot);
+}
+
+void TransformSync::BeginStep() {
+	for (size_t i = 0; i < m_dirty.size(); ++i) {
+		OpenGLMotionState* pMotionState = m_motionStates[m_dirty[i]];
+		if (!pMotionState) continue;
+		pMotionState->SavePreviousTransform();
+		pMotionState->ClearDirty();
+		m_settled.push_back(m_dirty[i]);
+	}
+	m_dirty.clear();
+}
+
+void TransformSync::Reset() {
+	m_dirty.clear();
+	m_settled.clear();
+	for (size_t slot = 0; slot < m_motionStates.size(); ++slot) {
+		OpenGLMotionState* pMotionState = m_motionStates[slot];
+		if (!pMotionState) continue;
+		pMotionState->SavePreviousTransform();
+		pMotionState->ClearDirty();
+		m_inMotion[slot] = 0;
+		m_settled.push_back((int)slot);
+	}
+}
+
+void TransformSync::Sync(float alpha) {
+	++m_syncCount;
+	m_changedCount = 0;
+
+	// bodies that stopped: their previous transform is now the current one
+	for (size_t i = 0; i < m_settled.size(); ++i) {
+		int slot = m_settled[i];
+		if (m_motionStates[slot]) {
+			Write(slot, m_motionStates[slot]->m_graphicsWorldTrans);
+		}
+	}
+	m_settled.clear();
+
+	// and the ones moving in the last step
+	for (size_t i = 0; i < m_dirty.size(); ++i) {
+		int slot = m_dirty[i];
+		OpenGLMotionState* pMotionState = m_motionStates[slot];
+		if (pMotionState) {
+			WriteInterpolated(slot, pMotionState->GetPreviousTransform(), pMotionState->m_graphicsWorldTrans, alpha);
+		}
+	}
+}
+
+void TransformSync::SyncFrom(const std::vector<btTransform>& previous, const std::vector<btTransform>& current, float alpha) {
+	++m_syncCount;
+	m_changedCount = 0;
+
+	// every slot is published, only the moving ones and those that just stopped are written
+	size_t count = std::min(m_matrices.size(), std::min(previous.size(), current.size()));
+
+	// and the ones Reset placed, even if they don't move again
+	for (size_t i = 0; i < m_settled.size(); ++i) {
+		int slot = m_settled[i];
+		if (slot < (int)count && m_motionStates[slot]) {
+			Write(slot, current[slot]);
+		}
+	}
+	m_settled.clear();
+	for (size_t slot = 0; slot < count; ++slot) {
+		if (!m_motionStates[slot]) continue;
+		if (!(previous[slot] == current[slot])) {
+			WriteInterpolated((int)slot, previous[slot], current[slot], alpha);
+			m_inMotion[slot] = 1;
+		}
+		else if (m_inMotion[slot]) {
+			Write((int)slot, current[slot]);
+			m_inMotion[slot] = 0;
+		}
+	}
+}
+
+void TransformSync::Write(int slot, const btTransform& body) {
+	// the basis columns and the origin straight into the matrix
+	const btMatrix3x3& basis = body.getBasis();
+	const btVector3& origin = body.getOrigin();
+	glm::mat4 bodyMatrix(
+		basis[0].x(), basis[1].x(), basis[2].x(), 0.0f,
+		basis[0].y(), basis[1].y(), basis[2].y(), 0.0f,
+		basis[0].z(), basis[1].z(), basis[2].z(), 0.0f,
+		origin.x(), origin.y(), origin.z(), 1.0f);
+	m_matrices[slot] = bodyMatrix * m_bodyToModel[slot];
+
+	if (m_changedSync[slot] != m_syncCount) {
+		m_changedSync[slot] = m_syncCount;
+		++m_changedCount;
+	}
+}
+
+void TransformSync::WriteInterpolated(int slot, const btTransform& previous, const btTransform& current, float alpha) {
+	btTransform body;
+	OpenGLMotionState::Interpolate(previous, current, alpha, body);
+	Write(slot, body);
+}
@@ -0,0 +1,80 @@
+#ifndef BULLETOPENGL_TRANSFORMSYNC_H
+#define BULLETOPENGL_TRANSFORMSYNC_H
+
+#include <vector>
+
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <glm/glm.hpp>
+
+#include "OpenGLMotionState.h"
+
+// The model matrices of the game objects, one contiguous array the renderer
+// reads, kept up to date from the physics.
+//
+// Bullet only calls setWorldTransform for bodies that moved during a step,
+// and OpenGLMotionState puts those on a dirty list. After the steps of a
+// frame, Sync() converts just these transforms to glm::mat4, interpolated
+// between the last two steps. Sleeping and static bodies cost nothing.
+//
+// BeginStep() and the dirty list belong to whoever steps the world; with
+// the physics thread running, the render side uses SyncFrom() instead.
+class TransformSync {
+public:
+	TransformSync();
+
+	// a slot for the object: its matrix starts at 'model', then follows the
+	// body with 'bodyToModel' as the offset. The motion state may be null
+	int Add(OpenGLMotionState* pMotionState, const glm::mat4& model, const glm::mat4& bodyToModel);
+	// the slot is reused by a later Add
+	void Remove(int slot);
+
+	// before each fixed step: the bodies that moved in the previous step
+	// start this one from where they are
+	void BeginStep();
+
+	// after the bodies were moved outside of a step (snapshot restore):
+	// they start again from where they are, and the next sync writes every
+	// one of them, moving or not
+	void Reset();
+
+	// after the steps of a frame: writes the matrices of the bodies that
+	// moved, between their previous (alpha = 0) and current (1) transform
+	void Sync(float alpha);
+
+	// same from transforms published by the physics thread, in slot order
+	void SyncFrom(const std::vector<btTransform>& previous, const std::vector<btTransform>& current, float alpha);
+
+	const glm::mat4& GetMatrix(int slot) const { return m_matrices[slot]; }
+	const glm::mat4* GetMatrices() const { return m_matrices.data(); }
+	int GetSlotCount() const { return (int)m_matrices.size(); }
+
+	// whether the last sync changed this slot
+	bool WasChanged(int slot) const { return m_changedSync[slot] == m_syncCount; }
+	int GetChangedCount() const { return m_changedCount; }
+
+	// in slot order, null for free slots and objects without a body
+	const std::vector<OpenGLMotionState*>& GetMotionStates() const { return m_motionStates; }
+
+private:
+	void Write(int slot, const btTransform& body);
+	void WriteInterpolated(int slot, const btTransform& previous, const btTransform& current, float alpha);
+
+	std::vector<glm::mat4> m_matrices;
+	std::vector<glm::mat4> m_bodyToModel;
+	std::vector<OpenGLMotionState*> m_motionStates;
+	std::vector<int> m_freeSlots;
+
+	// set by the motion states during a step
+	std::vector<int> m_dirty;
+	// moved before the last step but not during it, written once more at
+	// rest. Both syncs consume it
+	std::vector<int> m_settled;
+
+	// stamp of the last sync that changed each slot
+	std::vector<unsigned int> m_changedSync;
+	std::vector<unsigned char> m_inMotion;
+	unsigned int m_syncCount;
+	int m_changedCount;
+};
+
+#endif //BULLETOPENGL_TRANSFORMSYNC_H
@@ -0,0 +1,43 @@
+#ifndef BULLETOPENGL_TRIPLEBUFFER_H
+#define BULLETOPENGL_TRIPLEBUFFER_H
+
+#include <atomic>
+
+// one writer thread hands complete values to one reader thread without
+// locks or waiting. The writer fills its back slot and swaps it with the
+// middle one; the reader swaps its front slot with the middle one when the
+// middle holds something newer. Neither side ever touches the slot the
+// other one owns, and the reader always gets the latest complete value.
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() : m_back(0), m_middle(1), m_front(2) {}
+
+	// writer side: the slot to fill, then Publish() it
+	T& GetBack() { return m_slots[m_back]; }
+	void Publish() {
+		m_back = m_middle.exchange(m_back | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// reader side: takes the latest published value if there is one,
+	// returns false when the front slot is still the newest
+	bool Update() {
+		if (!(m_middle.load(std::memory_order_relaxed) & FRESH_BIT)) return false;
+		m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+	const T& GetFront() const { return m_slots[m_front]; }
+
+	// only while neither thread is using the buffer
+	T& GetSlot(int index) { return m_slots[index]; }
+
+private:
+	enum { INDEX_MASK = 3, FRESH_BIT = 4 };
+
+	T m_slots[3];
+	int m_back;
+	std::atomic<int> m_middle;
+	int m_front;
+};
+
+#endif //BULLETOPENGL_TRIPLEBUFFER_H
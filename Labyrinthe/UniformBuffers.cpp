@@ -0,0 +1,248 @@
+#include "UniformBuffers.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+
+void BindUniformBlocks(GLuint program) {
+	GLuint frameBlock = glGetUniformBlockIndex(program, "FrameData");
+	if (frameBlock != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, frameBlock, FRAME_DATA_BINDING);
+	}
+	GLuint objectBlock = glGetUniformBlockIndex(program, "ObjectData");
+	if (objectBlock != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, objectBlock, OBJECT_DATA_BINDING);
+	}
+}
+
+FrameUniformBuffer::FrameUniformBuffer() :
+	m_buffer(0),
+	m_projection(1.0f),
+	m_view(1.0f),
+	m_projectionDirty(true),
+	m_viewDirty(true),
+	m_uploadCount(0),
+	m_elidedCount(0)
+{
+}
+
+FrameUniformBuffer::~FrameUniformBuffer() {
+	Destroy();
+}
+
+void FrameUniformBuffer::Destroy() {
+	if (m_buffer) {
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+	}
+}
+
+void FrameUniformBuffer::Create() {
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, m_buffer);
+	m_projectionDirty = m_viewDirty = true;
+}
+
+void FrameUniformBuffer::SetProjection(const glm::mat4& projection) {
+	if (projection != m_projection) {
+		m_projection = projection;
+		m_projectionDirty = true;
+	}
+}
+
+void FrameUniformBuffer::SetView(const glm::mat4& view) {
+	if (view != m_view) {
+		m_view = view;
+		m_viewDirty = true;
+	}
+}
+
+void FrameUniformBuffer::Upload() {
+	if (!m_projectionDirty && !m_viewDirty) {
+		m_elidedCount++;
+		return;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	// the block layout is { projection, view }
+	if (m_projectionDirty) {
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(m_projection));
+	}
+	if (m_viewDirty) {
+		glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(m_view));
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	m_projectionDirty = m_viewDirty = false;
+	m_uploadCount++;
+}
+
+TransformRingBuffer::TransformRingBuffer() :
+	m_buffer(0),
+	m_stride(OBJECT_DATA_SIZE),
+	m_capacity(0),
+	m_frameCount(0),
+	m_frame(0),
+	m_count(0),
+	m_boundSlot(-1),
+	m_pMapped(nullptr),
+	m_bindCount(0),
+	m_elidedCount(0),
+	m_residentBuffer(0),
+	m_residentDirtyMin(0),
+	m_residentDirtyMax(-1),
+	m_residentWriteCount(0)
+{
+}
+
+TransformRingBuffer::~TransformRingBuffer() {
+	Destroy();
+}
+
+void TransformRingBuffer::Destroy() {
+	for (size_t i = 0; i < m_fences.size(); ++i) {
+		if (m_fences[i]) glDeleteSync(m_fences[i]);
+	}
+	m_fences.clear();
+	if (m_buffer) {
+		if (m_pMapped) {
+			glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			m_pMapped = nullptr;
+		}
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+	}
+	if (m_residentBuffer) {
+		glDeleteBuffers(1, &m_residentBuffer);
+		m_residentBuffer = 0;
+	}
+	m_resident.clear();
+}
+
+void TransformRingBuffer::Create(int maxTransformsPerFrame, int frameCount, int residentCount) {
+	m_capacity = maxTransformsPerFrame;
+	m_frameCount = frameCount;
+	m_fences.assign(frameCount, (GLsync)0);
+
+	// every bound range has to start on an aligned offset
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_stride = ((OBJECT_DATA_SIZE + alignment - 1) / alignment) * alignment;
+
+	GLsizeiptr size = m_stride * m_capacity * m_frameCount;
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	if (GLEW_ARB_buffer_storage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+		m_pMapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+	}
+	if (!m_pMapped) {
+		// no persistent mapping, stage one segment on the CPU instead
+		glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+		m_staging.resize(m_stride * m_capacity);
+	}
+
+	// resident slots change rarely, a plain buffer updated with
+	// glBufferSubData lets the driver order the writes with the draws
+	if (residentCount > 0) {
+		glGenBuffers(1, &m_residentBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_residentBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, m_stride * residentCount, nullptr, GL_DYNAMIC_DRAW);
+		m_residentStaging.assign(m_stride * residentCount, 0);
+		m_resident.assign(residentCount, 0);
+		m_residentDirtyMin = residentCount;
+		m_residentDirtyMax = -1;
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void TransformRingBuffer::BeginFrame() {
+	m_frame = (m_frame + 1) % m_frameCount;
+	m_count = 0;
+	m_boundSlot = -1;
+
+	// wait until the GPU is done with the segment we are about to overwrite
+	if (m_fences[m_frame]) {
+		glClientWaitSync(m_fences[m_frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(m_fences[m_frame]);
+		m_fences[m_frame] = 0;
+	}
+}
+
+int TransformRingBuffer::Push(const glm::mat4& model, int textureLayer) {
+	if (m_count >= m_capacity) {
+		std::cerr << "TransformRingBuffer is full (" << m_capacity << " transforms)" << std::endl;
+		return -1;
+	}
+
+	unsigned char* pSegment = m_pMapped ? m_pMapped + m_frame * m_capacity * m_stride : &m_staging[0];
+	Write(pSegment + m_count * m_stride, model, textureLayer);
+	return m_count++;
+}
+
+int TransformRingBuffer::SetResident(int index, const glm::mat4& model, int textureLayer) {
+	if (index < 0 || index >= (int)m_resident.size()) return -1;
+
+	Write(&m_residentStaging[index * m_stride], model, textureLayer);
+	m_resident[index] = 1;
+	m_residentDirtyMin = std::min(m_residentDirtyMin, index);
+	m_residentDirtyMax = std::max(m_residentDirtyMax, index);
+	m_residentWriteCount++;
+	return GetResidentSlot(index);
+}
+
+void TransformRingBuffer::Write(unsigned char* pDestination, const glm::mat4& model, int textureLayer) {
+	int layer[4] = { textureLayer, 0, 0, 0 };
+	std::memcpy(pDestination, glm::value_ptr(model), sizeof(glm::mat4));
+	std::memcpy(pDestination + sizeof(glm::mat4), layer, sizeof(layer));
+}
+
+void TransformRingBuffer::Upload() {
+	// the resident slots written since the last upload, as one range
+	if (m_residentDirtyMin <= m_residentDirtyMax) {
+		glBindBuffer(GL_UNIFORM_BUFFER, m_residentBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, m_residentDirtyMin * m_stride, (m_residentDirtyMax - m_residentDirtyMin + 1) * m_stride,
+			&m_residentStaging[m_residentDirtyMin * m_stride]);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		m_residentDirtyMin = (int)m_resident.size();
+		m_residentDirtyMax = -1;
+	}
+
+	// coherent persistent mappings need no upload
+	if (m_pMapped || m_count == 0) return;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, m_frame * m_capacity * m_stride, m_count * m_stride, &m_staging[0]);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void TransformRingBuffer::Bind(int slot) {
+	if (slot < 0) return;
+	if (slot == m_boundSlot) {
+		m_elidedCount++;
+		return;
+	}
+
+	if (slot >= m_capacity) {
+		glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_DATA_BINDING, m_residentBuffer, (slot - m_capacity) * m_stride, OBJECT_DATA_SIZE);
+	}
+	else {
+		GLintptr offset = (m_frame * m_capacity + slot) * m_stride;
+		glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_DATA_BINDING, m_buffer, offset, OBJECT_DATA_SIZE);
+	}
+	m_boundSlot = slot;
+	m_bindCount++;
+}
+
+void TransformRingBuffer::EndFrame() {
+	if (m_pMapped) {
+		m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
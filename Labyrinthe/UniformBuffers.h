@@ -0,0 +1,134 @@
+#ifndef BULLETOPENGL_UNIFORMBUFFERS_H
+#define BULLETOPENGL_UNIFORMBUFFERS_H
+
+#include <vector>
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+// uniform block binding points shared by every program. The shaders declare:
+//   layout(std140) uniform FrameData { mat4 projection; mat4 view; };
+//   layout(std140) uniform ObjectData { mat4 model; int textureLayer; };
+#define FRAME_DATA_BINDING 0
+#define OBJECT_DATA_BINDING 1
+
+// std140 size of the ObjectData block: a mat4 and an int padded to a vec4
+#define OBJECT_DATA_SIZE (sizeof(glm::mat4) + 4 * sizeof(int))
+
+// attach the FrameData/ObjectData blocks of a linked program to their
+// binding points (GLSL 330 has no layout(binding = n))
+void BindUniformBlocks(GLuint program);
+
+// per frame camera matrices, shared by every program through a single UBO.
+// A shadow copy of the matrices is kept so unchanged values are never re-uploaded,
+// and since the data lives in a buffer it doesn't matter which program is bound.
+class FrameUniformBuffer {
+public:
+	FrameUniformBuffer();
+	~FrameUniformBuffer();
+
+	void Create();
+	// release the buffer, must be called while the context is alive
+	void Destroy();
+
+	void SetProjection(const glm::mat4& projection);
+	void SetView(const glm::mat4& view);
+
+	// upload the matrices that changed since the last call
+	void Upload();
+
+	const glm::mat4& GetProjection() const { return m_projection; }
+	const glm::mat4& GetView() const { return m_view; }
+
+	int GetUploadCount() const { return m_uploadCount; }
+	int GetElidedCount() const { return m_elidedCount; }
+
+private:
+	GLuint m_buffer;
+	glm::mat4 m_projection;
+	glm::mat4 m_view;
+	bool m_projectionDirty;
+	bool m_viewDirty;
+	int m_uploadCount;
+	int m_elidedCount;
+};
+
+// per object model matrices for the current frame. The buffer is split in
+// 'frameCount' segments used in turn, so the CPU writes one segment while the GPU
+// still reads the previous ones. Where GL_ARB_buffer_storage is available the
+// buffer is persistently mapped and written in place, otherwise the segment is
+// staged in memory and uploaded once per frame.
+//
+// Usage per frame: BeginFrame, Push every transform, Upload, then Bind(slot)
+// before each draw, and EndFrame after the last draw.
+//
+// Objects that don't move (static, or asleep in the physics) can keep their
+// transform in a resident slot instead, in a second buffer that isn't
+// rewritten every frame: SetResident once, then bind GetResidentSlot(index)
+// for as long as the transform holds. Changed resident slots go up with the
+// next Upload.
+class TransformRingBuffer {
+public:
+	TransformRingBuffer();
+	~TransformRingBuffer();
+
+	void Create(int maxTransformsPerFrame, int frameCount = 3, int residentCount = 0);
+	// release the buffer, must be called while the context is alive
+	void Destroy();
+
+	void BeginFrame();
+
+	// store a transform (and the layer of the object in the texture array,
+	// if it uses one) for this frame, returns its slot (-1 when full)
+	int Push(const glm::mat4& model, int textureLayer = 0);
+
+	// keep this transform in resident slot 'index' (the caller's numbering,
+	// below residentCount) and return the slot to bind, -1 when out of range
+	int SetResident(int index, const glm::mat4& model, int textureLayer = 0);
+	// whether SetResident was called since the last ReleaseResident
+	bool IsResident(int index) const { return index >= 0 && index < (int)m_resident.size() && m_resident[index]; }
+	int GetResidentSlot(int index) const { return m_capacity + index; }
+	// the transform of 'index' is outdated, the next SetResident writes it again
+	void ReleaseResident(int index) { if (IsResident(index)) m_resident[index] = 0; }
+	void ReleaseResidents() { m_resident.assign(m_resident.size(), 0); }
+
+	// make the pushed transforms and the changed resident ones visible to the GPU
+	void Upload();
+
+	// bind a slot to the ObjectData block, redundant binds are skipped
+	void Bind(int slot);
+
+	void EndFrame();
+
+	bool IsPersistent() const { return m_pMapped != nullptr; }
+	int GetBindCount() const { return m_bindCount; }
+	int GetElidedCount() const { return m_elidedCount; }
+	// transforms written to resident slots since the start
+	int GetResidentWriteCount() const { return m_residentWriteCount; }
+
+private:
+	void Write(unsigned char* pDestination, const glm::mat4& model, int textureLayer);
+
+	GLuint m_buffer;
+	GLsizeiptr m_stride;       // OBJECT_DATA_SIZE rounded up to the UBO offset alignment
+	int m_capacity;            // transforms per segment
+	int m_frameCount;
+	int m_frame;               // segment written this frame
+	int m_count;               // transforms pushed this frame
+	int m_boundSlot;
+	unsigned char* m_pMapped;  // persistent mapping of the whole buffer
+	std::vector<unsigned char> m_staging;
+	std::vector<GLsync> m_fences;
+	int m_bindCount;
+	int m_elidedCount;
+
+	// slots past m_capacity are resident, in their own buffer
+	GLuint m_residentBuffer;
+	std::vector<unsigned char> m_residentStaging;
+	std::vector<unsigned char> m_resident;
+	int m_residentDirtyMin;    // range of slots to upload, empty when min > max
+	int m_residentDirtyMax;
+	int m_residentWriteCount;
+};
+
+#endif //BULLETOPENGL_UNIFORMBUFFERS_H
@@ -0,0 +1,244 @@
+#include "VertexFormat.h"
+#include "MeshChunker.h"
+#include <iostream>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+// largest accepted error on a decoded uv, relative to max(1, |uv|).
+// A half float keeps 11 significant bits, so the rounding error is below 1/2048
+#define UV_TOLERANCE 1e-3f
+// largest accepted error on a decoded normal component. 10 bit snorm values are
+// 1/511 apart, and GL 3.3 drivers may decode them with the older (2c + 1) / 1023 rule
+#define NORMAL_TOLERANCE 4e-3f
+
+VertexFormat::Type VertexFormat::defaultFormat = VertexFormat::FLOAT32;
+bool VertexFormat::validation = false;
+
+void VertexFormat::setDefault(Type format) {
+    defaultFormat = format;
+}
+
+VertexFormat::Type VertexFormat::getDefault() {
+    return defaultFormat;
+}
+
+void VertexFormat::setValidation(bool enabled) {
+    validation = enabled;
+}
+
+bool VertexFormat::getValidation() {
+    return validation;
+}
+
+GLsizei VertexFormat::getStride(Type format) {
+    return format == COMPACT ? sizeof(PackedVertex) : MeshChunker::VERTEX_STRIDE * sizeof(float);
+}
+
+VertexFormat::Type VertexFormat::uploadVertexBuffer(const std::vector<float>& vertexBuffer, const std::string& name) {
+    return uploadVertexBuffer(vertexBuffer, name, defaultFormat);
+}
+
+/*
+    Uploads the buffer with the requested layout, falls back to FLOAT32 when
+    validation is enabled and the packed vertices are out of tolerance
+*/
+VertexFormat::Type VertexFormat::uploadVertexBuffer(const std::vector<float>& vertexBuffer, const std::string& name, Type format) {
+    if (vertexBuffer.empty()) {
+        setupAttributes(format);
+        return format;
+    }
+
+    if (format == COMPACT) {
+        std::vector<PackedVertex> packed = pack(vertexBuffer);
+        if (!validation || validate(vertexBuffer, packed, name)) {
+            glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), &packed[0], GL_STATIC_DRAW);
+            setupAttributes(COMPACT);
+            return COMPACT;
+        }
+        std::cerr << name << ": packed vertices out of tolerance, using the float layout" << std::endl;
+    }
+
+    glBufferData(GL_ARRAY_BUFFER, vertexBuffer.size() * sizeof(float), &vertexBuffer[0], GL_STATIC_DRAW);
+    setupAttributes(FLOAT32);
+    return FLOAT32;
+}
+
+void VertexFormat::setupAttributes(Type format) {
+    GLsizei stride = getStride(format);
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    if (format == COMPACT) {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, position));
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, uv));
+        glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(PackedVertex, normal));
+    }
+    else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(5 * sizeof(float)));
+    }
+}
+
+std::vector<PackedVertex> VertexFormat::pack(const std::vector<float>& vertexBuffer) {
+    const int stride = MeshChunker::VERTEX_STRIDE;
+    std::vector<PackedVertex> packed(vertexBuffer.size() / stride);
+    for (size_t i = 0; i < packed.size(); ++i) {
+        const float* v = &vertexBuffer[i * stride];
+        PackedVertex& p = packed[i];
+        p.position[0] = v[0];
+        p.position[1] = v[1];
+        p.position[2] = v[2];
+        p.uv[0] = floatToHalf(v[3]);
+        p.uv[1] = floatToHalf(v[4]);
+        p.normal = packNormal(v[5], v[6], v[7]);
+    }
+    return packed;
+}
+
+/*
+    Decodes a packed vertex back to the 8 floats of the loader layout
+*/
+void VertexFormat::unpack(const PackedVertex& vertex, float* pOut) {
+    pOut[0] = vertex.position[0];
+    pOut[1] = vertex.position[1];
+    pOut[2] = vertex.position[2];
+    pOut[3] = halfToFloat(vertex.uv[0]);
+    pOut[4] = halfToFloat(vertex.uv[1]);
+    unpackNormal(vertex.normal, pOut + 5);
+}
+
+bool VertexFormat::validate(const std::vector<float>& vertexBuffer, const std::vector<PackedVertex>& packed, const std::string& name) {
+    const int stride = MeshChunker::VERTEX_STRIDE;
+    float maxPositionError = 0.0f, maxUvError = 0.0f, maxNormalError = 0.0f;
+    size_t failures = 0;
+
+    for (size_t i = 0; i < packed.size(); ++i) {
+        const float* v = &vertexBuffer[i * stride];
+        float decoded[8];
+        unpack(packed[i], decoded);
+
+        bool failed = false;
+        for (int c = 0; c < 3; ++c) {
+            float error = std::fabs(decoded[c] - v[c]);
+            maxPositionError = std::max(maxPositionError, error);
+            failed |= error != 0.0f;
+        }
+        for (int c = 3; c < 5; ++c) {
+            float error = std::fabs(decoded[c] - v[c]) / std::max(1.0f, std::fabs(v[c]));
+            maxUvError = std::max(maxUvError, error);
+            failed |= error > UV_TOLERANCE;
+        }
+        for (int c = 5; c < 8; ++c) {
+            float error = std::fabs(decoded[c] - v[c]);
+            maxNormalError = std::max(maxNormalError, error);
+            failed |= error > NORMAL_TOLERANCE;
+        }
+        if (failed) {
+            failures++;
+        }
+    }
+
+    std::cout << name << ": " << packed.size() << " vertices, "
+        << packed.size() * getStride(FLOAT32) / 1024 << " KB -> " << packed.size() * getStride(COMPACT) / 1024 << " KB, "
+        << "max error position " << maxPositionError << " uv " << maxUvError << " normal " << maxNormalError
+        << ", " << failures << " vertices out of tolerance" << std::endl;
+
+    return failures == 0;
+}
+
+/*
+    Rounds a float to the nearest half float (ties to even), out of range values
+    become infinities and tiny ones half subnormals or zero
+*/
+uint16_t VertexFormat::floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t floatExponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    // infinity and NaN
+    if (floatExponent == 0xff) {
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+
+    int exponent = (int)floatExponent - 127 + 15;
+    if (exponent >= 31) {
+        return (uint16_t)(sign | 0x7c00);
+    }
+
+    if (exponent <= 0) {
+        // below the smallest half subnormal
+        if (exponent < -10) {
+            return (uint16_t)sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) {
+            half++;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    // a carry out of the mantissa correctly bumps the exponent
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return (uint16_t)half;
+}
+
+float VertexFormat::halfToFloat(uint16_t value) {
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    if (exponent == 0) {
+        // zero and subnormals
+        float result = std::ldexp((float)mantissa, -24);
+        return sign ? -result : result;
+    }
+
+    uint32_t bits;
+    if (exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/*
+    Signed normalized 10 bit x, y and z, in the GL_INT_2_10_10_10_REV bit order
+*/
+uint32_t VertexFormat::packNormal(float x, float y, float z) {
+    const float components[3] = { x, y, z };
+    uint32_t packed = 0;
+    for (int c = 0; c < 3; ++c) {
+        float clamped = std::min(1.0f, std::max(-1.0f, components[c]));
+        int value = (int)std::floor(clamped * 511.0f + 0.5f);
+        packed |= ((uint32_t)value & 0x3ff) << (10 * c);
+    }
+    return packed;
+}
+
+void VertexFormat::unpackNormal(uint32_t packed, float* pOut) {
+    for (int c = 0; c < 3; ++c) {
+        // sign extend the 10 bit component
+        int value = (int)(packed << (22 - 10 * c)) >> 22;
+        pOut[c] = std::max(-1.0f, value / 511.0f);
+    }
+}
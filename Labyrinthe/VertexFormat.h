@@ -0,0 +1,68 @@
+/*
+    GPU vertex layouts for the interleaved buffers produced by ObjLoader.
+
+    FLOAT32 is the layout of the loader itself: position (3 floats), uv (2 floats),
+    normal (3 floats), 32 bytes per vertex.
+    COMPACT keeps the position as 3 floats but stores the uv as 2 half floats and
+    the normal as a signed normalized 10_10_10_2 integer, 20 bytes per vertex.
+
+    The CPU side always keeps the float buffer (chunking, bounds, colliders),
+    only what is uploaded to the VBO changes. In validation mode every packed
+    buffer is decoded again and compared to the original, and a mesh that is out
+    of tolerance is uploaded as FLOAT32 instead.
+*/
+
+#ifndef VERTEXFORMAT_H_INCLUDED
+#define VERTEXFORMAT_H_INCLUDED
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <GL/glew.h>
+
+struct PackedVertex {
+    float position[3];
+    uint16_t uv[2];  // half floats
+    uint32_t normal; // GL_INT_2_10_10_10_REV, w unused
+};
+
+class VertexFormat {
+public:
+    enum Type { FLOAT32, COMPACT };
+
+    // layout used by uploadVertexBuffer when none is given, FLOAT32 by default
+    static void setDefault(Type format);
+    static Type getDefault();
+
+    // decode and check every packed buffer before it is uploaded
+    static void setValidation(bool enabled);
+    static bool getValidation();
+
+    static GLsizei getStride(Type format);
+
+    // upload an interleaved float buffer to the bound GL_ARRAY_BUFFER and describe
+    // attributes 0 (position), 1 (uv) and 2 (normal) of the bound VAO.
+    // Returns the layout actually used
+    static Type uploadVertexBuffer(const std::vector<float>& vertexBuffer, const std::string& name);
+    static Type uploadVertexBuffer(const std::vector<float>& vertexBuffer, const std::string& name, Type format);
+
+    // attribute pointers of the bound VAO for the vertices in the bound VBO
+    static void setupAttributes(Type format);
+
+    static std::vector<PackedVertex> pack(const std::vector<float>& vertexBuffer);
+    static void unpack(const PackedVertex& vertex, float* pOut);
+
+    // compare a packed buffer to its source, prints the largest errors
+    static bool validate(const std::vector<float>& vertexBuffer, const std::vector<PackedVertex>& packed, const std::string& name);
+
+    static uint16_t floatToHalf(float value);
+    static float halfToFloat(uint16_t value);
+    static uint32_t packNormal(float x, float y, float z);
+    static void unpackNormal(uint32_t packed, float* pOut);
+
+private:
+    static Type defaultFormat;
+    static bool validation;
+};
+
+#endif // VERTEXFORMAT_H_INCLUDED
@@ -0,0 +1,90 @@
+#include "WorldSnapshot.h"
+
+// drops the contact manifolds and algorithms of every pair in one pass,
+// cleanProxyFromPairs would walk all the pairs for each object. Pairs
+// whose objects don't overlap in the restored state go: the islands are
+// built from the pairs, so they would change how the next step solves
+class CleanPairsCallback : public btOverlapCallback {
+public:
+	CleanPairsCallback(btOverlappingPairCache* pPairCache, btBroadphaseInterface* pBroadphase, btDispatcher* pDispatcher) :
+		m_pPairCache(pPairCache), m_pBroadphase(pBroadphase), m_pDispatcher(pDispatcher) {}
+
+	virtual bool processOverlap(btBroadphasePair& pair) {
+		btVector3 min0, max0, min1, max1;
+		m_pBroadphase->getAabb(pair.m_pProxy0, min0, max0);
+		m_pBroadphase->getAabb(pair.m_pProxy1, min1, max1);
+		if (!TestAabbAgainstAabb2(min0, max0, min1, max1)) return true;
+		m_pPairCache->cleanOverlappingPair(pair, m_pDispatcher);
+		return false;
+	}
+
+private:
+	btOverlappingPairCache* m_pPairCache;
+	btBroadphaseInterface* m_pBroadphase;
+	btDispatcher* m_pDispatcher;
+};
+
+void WorldSnapshot::Capture(const btCollisionWorld* pWorld) {
+	const btCollisionObjectArray& objects = pWorld->getCollisionObjectArray();
+	m_states.resize(objects.size());
+	for (int i = 0; i < objects.size(); ++i) {
+		const btCollisionObject* pObject = objects[i];
+		ObjectState& state = m_states[i];
+		state.pObject = pObject;
+		pObject->getWorldTransform().serializeFloat(state.transform);
+		const btRigidBody* pBody = btRigidBody::upcast(pObject);
+		btVector3 zero(0.0f, 0.0f, 0.0f);
+		(pBody ? pBody->getLinearVelocity() : zero).serializeFloat(state.linearVelocity);
+		(pBody ? pBody->getAngularVelocity() : zero).serializeFloat(state.angularVelocity);
+		state.activationState = pObject->getActivationState();
+		state.deactivationTime = (float)pObject->getDeactivationTime();
+	}
+}
+
+bool WorldSnapshot::Restore(btDynamicsWorld* pWorld) const {
+	btCollisionObjectArray& objects = pWorld->getCollisionObjectArray();
+	if (objects.size() != (int)m_states.size()) return false;
+	for (int i = 0; i < objects.size(); ++i) {
+		if (objects[i] != m_states[i].pObject) return false;
+	}
+
+	for (int i = 0; i < objects.size(); ++i) {
+		btCollisionObject* pObject = objects[i];
+		const ObjectState& state = m_states[i];
+		btTransform transform;
+		transform.deSerializeFloat(state.transform);
+
+		btRigidBody* pBody = btRigidBody::upcast(pObject);
+		if (pBody) {
+			btVector3 linearVelocity, angularVelocity;
+			linearVelocity.deSerializeFloat(state.linearVelocity);
+			angularVelocity.deSerializeFloat(state.angularVelocity);
+			pBody->setLinearVelocity(linearVelocity);
+			pBody->setAngularVelocity(angularVelocity);
+			// also the interpolation transform and velocities, and the world inertia
+			pBody->setCenterOfMassTransform(transform);
+			pBody->clearForces();
+			// the renderer follows through the motion state
+			if (pBody->getMotionState()) {
+				pBody->getMotionState()->setWorldTransform(transform);
+			}
+		}
+		else {
+			pObject->setWorldTransform(transform);
+			pObject->setInterpolationWorldTransform(transform);
+		}
+		// forced: the disabled states can't be left with setActivationState
+		pObject->forceActivationState(state.activationState);
+		pObject->setDeactivationTime(state.deactivationTime);
+		pWorld->updateSingleAabb(pObject);
+	}
+
+	// no contact or warm starting impulse survives from the state left behind
+	btOverlappingPairCache* pPairCache = pWorld->getBroadphase()->getOverlappingPairCache();
+	CleanPairsCallback cleanPairs(pPairCache, pWorld->getBroadphase(), pWorld->getDispatcher());
+	pPairCache->processAllOverlappingPairs(&cleanPairs, pWorld->getDispatcher());
+	if (pWorld->getConstraintSolver()) {
+		pWorld->getConstraintSolver()->reset();
+	}
+	return true;
+}
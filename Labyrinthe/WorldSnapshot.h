@@ -0,0 +1,42 @@
+#ifndef BULLETOPENGL_WORLDSNAPSHOT_H
+#define BULLETOPENGL_WORLDSNAPSHOT_H
+
+#include <vector>
+
+#include <Bullet/btBulletDynamicsCommon.h>
+
+// The state of every object of a world in one flat buffer: transform,
+// velocities and activation, in the world's object order. Restoring
+// writes it back into the same objects in place, so a level resets (or a
+// run rolls back) without building any shape, body or BVH again.
+//
+// The contacts cached by the world are dropped on restore and rebuilt by
+// the next step, so every run from the same restore is the same.
+class WorldSnapshot {
+public:
+	// overwrites the snapshot with the objects of the world as they are now
+	void Capture(const btCollisionWorld* pWorld);
+
+	// puts the objects back where they were. False, with the world left
+	// alone, when it doesn't hold the same objects in the same order
+	bool Restore(btDynamicsWorld* pWorld) const;
+
+	bool IsEmpty() const { return m_states.empty(); }
+	int GetObjectCount() const { return (int)m_states.size(); }
+	size_t GetByteSize() const { return m_states.size() * sizeof(ObjectState); }
+
+private:
+	// plain data, the transforms in Bullet's serialized layout
+	struct ObjectState {
+		const btCollisionObject* pObject;
+		btTransformFloatData transform;
+		btVector3FloatData linearVelocity;
+		btVector3FloatData angularVelocity;
+		int activationState;
+		float deactivationTime;
+	};
+
+	std::vector<ObjectState> m_states;
+};
+
+#endif //BULLETOPENGL_WORLDSNAPSHOT_H
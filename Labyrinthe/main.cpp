@@ -6,6 +6,7 @@
 #include <sstream>
 #include <iterator>
 #include <algorithm>
+#include <cstdlib>
 #include <GL/glew.h>
 #define GLEW_STATIC
 #include <GLFW/glfw3.h>
@@ -21,6 +22,24 @@
 #include "OpenGLMotionState.h"
 #include "Mesh.h"
 #include "ObjWGroupsLoader.h"
+#include "MeshChunker.h"
+#include "RenderBvh.h"
+#include "MazeVisibility.h"
+#include "Benchmarks.h"
+#include "AssetBaker.h"
+#include "HeadlessSimulation.h"
+#include "UniformBuffers.h"
+#include "ShaderManager.h"
+#include "VertexFormat.h"
+#include "TextureDecodePool.h"
+#include "TextureCache.h"
+#include "TextureArray.h"
+#include "TextureStreamer.h"
+#include "PhysicsBackend.h"
+#include "MazePhysics.h"
+#include "CharacterController.h"
+#include "FixedTimestep.h"
+#include "GLFWCallBacks.h"
 
 
 GLuint WIDTH = 1280;
@@ -32,91 +51,19 @@ bool firstMouse = true;
 bool left = false, right = false, forward = false, backward = false;
 
 glm::vec3 agentPos(2.0f, -4.0f, -10.0f);
-float agentSpeed = 0.15f;
+float agentSpeed = 9.0f; // units per second
 
 Camera cam;
-GLint projLoc;
+glm::mat4 projection;
 
 GLuint VAO[4];
 GLuint VBO[4];
 GLuint textures[4];
 
-// Function to calculate the bounding box of a mesh
-std::pair<glm::vec3, glm::vec3> calculateBoundingBox(const Mesh& mesh) {
-    glm::vec3 minBounds(FLT_MAX);
-    glm::vec3 maxBounds(-FLT_MAX);
-
-    // Iterate over mesh data to find vertices
-    for (const std::string& line : mesh.data) {
-        // Process line to find vertices
-        if (line.substr(0, 2) == "v ") {
-            float x, y, z;
-            sscanf_s(line.c_str(), "v %f %f %f", &x, &y, &z);
-
-            // Update minBounds and maxBounds based on vertex coordinates
-            minBounds.x = std::min(minBounds.x, x);
-            minBounds.y = std::min(minBounds.y, y);
-            minBounds.z = std::min(minBounds.z, z);
-
-            maxBounds.x = std::max(maxBounds.x, x);
-            maxBounds.y = std::max(maxBounds.y, y);
-            maxBounds.z = std::max(maxBounds.z, z);
-        }
-    }
-
-    return { minBounds, maxBounds };
-}
-
-// Function to check for collision between two bounding boxes
-bool checkCollision(const glm::vec3& agentMinBounds, const glm::vec3& agentMaxBounds,
-    const glm::vec3& wallMinBounds, const glm::vec3& wallMaxBounds) {
-    // Check for intersection between bounding boxes
-    if (agentMaxBounds.x >= wallMinBounds.x && agentMinBounds.x <= wallMaxBounds.x &&
-        agentMaxBounds.y >= wallMinBounds.y && agentMinBounds.y <= wallMaxBounds.y &&
-        agentMaxBounds.z >= wallMinBounds.z && agentMinBounds.z <= wallMaxBounds.z) {
-        return true; // Collision detected
-    }
-    return false; // No collision
-}
-
-
-
 int debugMode = 1;
 
-const char* vertexShaderSource = R"(
-    #version 330
-
-    layout(location = 0) in vec3 a_position;
-    layout(location = 1) in vec2 a_texture;
-    layout(location = 2) in vec3 a_normal;
-
-    uniform mat4 model;
-    uniform mat4 projection;
-    uniform mat4 view;
-
-    out vec2 v_texture;
-
-    void main()
-    {
-        gl_Position = projection * view * model * vec4(a_position, 1.0);
-        v_texture = a_texture;
-    }
-)";
-
-const char* fragmentShaderSource = R"(
-    #version 330
-
-    in vec2 v_texture;
-
-    out vec4 out_color;
-
-    uniform sampler2D s_texture;
-
-    void main()
-    {
-        out_color = texture(s_texture, v_texture);
-    }
-)";
+// the next frame is drawn even if nothing moved (a key, a resize, the window exposed)
+bool redrawRequested = true;
 
 void checkGLError() {
     GLenum error = glGetError();
@@ -126,6 +73,7 @@ void checkGLError() {
 }
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode) {
+    redrawRequested = true;
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
@@ -193,12 +141,44 @@ void errorCallback(int error, const char* description) {
 
 void windowResizeCallback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    // picked up by the frame uniform buffer at the next frame,
+    // whatever program is bound
+    projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
+    redrawRequested = true;
 }
 
+void windowRefreshCallback(GLFWwindow* window) {
+    redrawRequested = true;
+}
+
+
+int main(int argc, char* argv[]) {
+    // headless benchmarks, offline bake steps and the headless simulation don't need a window
+    if (argc > 1 && std::string(argv[1]) == "--headless") {
+        return runHeadless(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        return runBenchmarks(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bake") {
+        return runAssetBaker(argc, argv);
+    }
+
+    // vertex layout and texture streaming options
+    size_t textureBudgetMB = 64;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--compact-vertices") {
+            VertexFormat::setDefault(VertexFormat::COMPACT);
+        }
+        else if (arg == "--validate-vertices") {
+            VertexFormat::setValidation(true);
+        }
+        else if (arg == "--texture-budget" && i + 1 < argc) {
+            textureBudgetMB = (size_t)std::max(1, std::atoi(argv[++i]));
+        }
+    }
 
-int main() {
     // Set GLFW error callback
     glfwSetErrorCallback(errorCallback);
 
@@ -236,6 +216,7 @@ int main() {
     glfwSetKeyCallback(window, keyCallback);
     glfwSetCursorPosCallback(window, mouseCallback);
     glfwSetWindowSizeCallback(window, windowResizeCallback);
+    glfwSetWindowRefreshCallback(window, windowRefreshCallback);
 
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
@@ -244,43 +225,49 @@ int main() {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 
-    // Compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    // Check compilation status
-    GLint vertexCompiled;
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &vertexCompiled);
-    if (vertexCompiled != GL_TRUE)
-    {
-        GLsizei logLength = 0;
-        GLchar message[1024];
-        glGetShaderInfoLog(vertexShader, 1024, &logLength, message);
-        // Write the error to a log or handle it accordingly
-    }
-    // Compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    // Check compilation status
-    GLint fragmentCompiled;
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &fragmentCompiled);
-    if (fragmentCompiled != GL_TRUE)
-    {
-        GLsizei logLength = 0;
-        GLchar message[1024];
-        glGetShaderInfoLog(fragmentShader, 1024, &logLength, message);
-        // Write the error to a log or handle it accordingly
-    }
-
-    // Create shader program
-    GLuint shaderProgram = glCreateProgram();
-    // Attach shaders to the program
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    // Link the program
-    glLinkProgram(shaderProgram);
-
+    // Shaders are loaded from files, cached as program binaries and
+    // reloaded when the files change
+    ShaderManager shaders;
+    int texturedShader = shaders.LoadProgram("textured", "shaders/textured.vert", "shaders/textured.frag");
+    int arrayShader = shaders.LoadProgram("textured_array", "shaders/textured_array.vert", "shaders/textured_array.frag");
+    if (texturedShader < 0 || arrayShader < 0) {
+        std::cerr << "Error: Failed to build the shaders." << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    double lastShaderCheck = glfwGetTime();
+
+
+    // Decode the textures on worker threads while the meshes load
+    TextureDecodePool texturePool;
+    TextureCache textureCache(&texturePool);
+
+    // The maze and the agent share agent.jpg, both baked from the same scene,
+    // and it is packed in a texture array, so both are drawn with a single
+    // texture bind. The layer is decoded (or read from its DDS file) on the pool
+    const char* texturePaths[3] = { "textures/agent.jpg", "textures/agent.jpg", "textures/ground.jpg" };
+    TextureArray textureArray;
+    textureArray.build({ texturePaths[0], texturePaths[1] }, texturePool);
+    int textureLayers[3];
+
+    // The ground starts with its small mip levels, the finer ones are
+    // streamed in when the camera gets close enough to see them
+    TextureStreamer textureStreamer(textureBudgetMB * 1024 * 1024);
+    textureStreamer.add(texturePaths[2]);
+
+    // Anything else is shared through the cache
+    for (int i = 0; i < 3; ++i) {
+        textureLayers[i] = textureArray.getLayer(texturePaths[i]);
+        if (textureLayers[i] >= 0) {
+            textures[i] = 0;
+        }
+        else if (textureStreamer.getTexture(texturePaths[i])) {
+            textures[i] = textureStreamer.getTexture(texturePaths[i]);
+        }
+        else {
+            textures[i] = textureCache.acquire(texturePaths[i]);
+        }
+    }
 
     // Load 3D meshes
     std::pair<std::vector<uint32_t>, std::vector<float>> mazeModel = ObjLoader::loadModel("models/mazeY.obj", true);
@@ -309,6 +296,9 @@ int main() {
     std::vector<uint32_t> groundIndices = groundModel.first;
     std::vector<float> groundBuffer = groundModel.second;
 
+    // split the maze into spatial chunks so it can be frustum culled
+    std::vector<MeshChunk> mazeChunks = MeshChunker::splitIntoChunks(mazeBuffer, MESH_CHUNK_SIZE);
+
 
     // Generate Vertex Array Objects (VAOs)
     glGenVertexArrays(4, VAO);
@@ -319,67 +309,29 @@ int main() {
 
     // Maze VAO
     glBindVertexArray(VAO[0]);
-    // Bind the maze Vertex Buffer Object (VBO)
     glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-    // Copy mazeBuffer data to the GPU
-    glBufferData(GL_ARRAY_BUFFER, mazeBuffer.size() * sizeof(float), &mazeBuffer[0], GL_STATIC_DRAW);
-    // Set up vertex attribute pointers
-    // maze vertices
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    // maze textures
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    // maze normals
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-
+    // Copy mazeBuffer data to the GPU and set up the vertex attribute pointers
+    VertexFormat::uploadVertexBuffer(mazeBuffer, "models/mazeY.obj");
 
     // Agent VAO
     glBindVertexArray(VAO[1]);
-    // Bind the agent Vertex Buffer Object (VBO)
     glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-    // Copy agentBuffer data to the GPU
-    glBufferData(GL_ARRAY_BUFFER, agentBuffer.size() * sizeof(float), &agentBuffer[0], GL_STATIC_DRAW);
-    // Set up vertex attribute pointers
-    // agent vertices
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), reinterpret_cast<const GLvoid*>(0));
-    // agent textures
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), reinterpret_cast<const GLvoid*>(12));
-    // agent normals
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), reinterpret_cast<const GLvoid*>(20));
+    VertexFormat::uploadVertexBuffer(agentBuffer, "models/agentY.obj");
 
     // Ground VAO
     glBindVertexArray(VAO[2]);
-    // Bind the ground Vertex Buffer Object (VBO)
     glBindBuffer(GL_ARRAY_BUFFER, VBO[2]);
-    // Copy groundBuffer data to the GPU
-    glBufferData(GL_ARRAY_BUFFER, groundBuffer.size() * sizeof(float), &groundBuffer[0], GL_STATIC_DRAW);
-    // Set up vertex attribute pointers
-    // ground vertices
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    // ground textures
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    // ground normals
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
+    VertexFormat::uploadVertexBuffer(groundBuffer, "models/groundY.obj");
 
 
-
-
-    glGenTextures(3, textures);
-    TextureLoader::loadTexture("textures/maze.jpg", textures[0]);
-    TextureLoader::loadTexture("textures/agent.jpg", textures[1]);
-    TextureLoader::loadTexture("textures/ground.jpg", textures[2]);
+    // Upload the textures and the array layers, the decoding ran on the pool while the meshes were loading
+    texturePool.finish();
+    texturePool.printTimings();
+    textureCache.printMemoryReport();
 
 
     // Use the program
-    glUseProgram(shaderProgram);
+    shaders.UseProgram(texturedShader);
     glClearColor(0.0f, 0.1f, 0.1f, 1.0f);
 
     glEnable(GL_DEPTH_TEST);
@@ -387,12 +339,15 @@ int main() {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    projLoc = glGetUniformLocation(shaderProgram, "projection");
-    GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
+    // Camera matrices and model matrices come from uniform buffers,
+    // the shader manager attaches the blocks of every program it links
+    FrameUniformBuffer frameUniforms;
+    frameUniforms.Create();
+    // The maze and the ground never move, they keep a resident slot
+    TransformRingBuffer transforms;
+    transforms.Create(16, 3, 2);
 
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
 
 
 
@@ -413,96 +368,245 @@ int main() {
         agentMaxBounds.z = std::max(agentMaxBounds.z, vertex.z);
     }
 
+    // bounding volume hierarchy over the maze chunks
+    glm::mat4 mazePos = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.0f, -10.0f));
+    std::vector<AABB> mazeChunkBounds;
+    for (const MeshChunk& chunk : mazeChunks) {
+        mazeChunkBounds.push_back(chunk.bounds.Transformed(mazePos));
+    }
+    RenderBvh mazeBvh;
+    mazeBvh.Build(mazeChunkBounds);
+    std::vector<int> visibleChunks;
+
+    // walls hide most of the maze when the camera is inside of it. Without
+    // the baked file everything the frustum lets through is drawn
+    MazeVisibility mazeVisibility;
+    if (mazeVisibility.Load("models/mazeY.pvs")) {
+        mazeVisibility.SetTransform(mazePos);
+    }
+    else {
+        std::cerr << "Maze visibility disabled, bake it with: --bake pvs" << std::endl;
+    }
+
+    // area covered by the ground texture, for the streaming
+    AABB groundBounds;
+    for (size_t i = 0; i < groundBuffer.size(); i += 8) {
+        groundBounds.Extend(glm::vec3(groundBuffer[i], groundBuffer[i + 1], groundBuffer[i + 2]));
+    }
+    groundBounds = groundBounds.Transformed(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.0f, -10.0f)));
+    int reportedStreamChanges = 0;
+    double lastStreamReport = glfwGetTime();
+
+    // the agent walks the maze as a kinematic character, the colliders are its walls
+    PhysicsConfig physicsConfig = PhysicsConfig::FromArgs(argc, argv);
+    PhysicsBackend physics;
+    btDiscreteDynamicsWorld* pWorld = physics.Create(physicsConfig);
+    // from the baked file when there is one (--bake physics) and the colliders
+    // haven't changed since, its BVH is ready
+    MazePhysics mazePhysics;
+    std::ifstream bakedPhysics("models/mazeY.bullet");
+    if (!bakedPhysics || !mazePhysics.Load("models/mazeY.bullet", "models/mazeY_collider_NoTextures.obj")) {
+        if (!mazePhysics.Build(MazeColliders, mazePos)) {
+            return -1;
+        }
+    }
+    mazePhysics.AddToWorld(pWorld);
+
+    // a cylinder around the agent model, the controller moves its center
+    glm::vec3 agentCenter = (agentMinBounds + agentMaxBounds) * 0.5f;
+    glm::vec3 agentExtents = (agentMaxBounds - agentMinBounds) * 0.5f;
+    btCylinderShape agentShape(btVector3(std::max(agentExtents.x, agentExtents.z), agentExtents.y, std::max(agentExtents.x, agentExtents.z)));
+    glm::vec3 agentStart = agentPos + agentCenter;
+    CharacterController agentController(&agentShape, 0.15f, btVector3(agentStart.x, agentStart.y, agentStart.z));
+    agentController.AddToWorld(pWorld);
+    pWorld->addAction(&agentController);
+
+    FixedTimestep physicsStep(physicsConfig.tickRate, physicsConfig.maxCatchUpSteps);
+    double lastFrameTime = glfwGetTime();
 
+    glm::mat4 groundPos = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.0f, -10.0f));
+    int mazeSlot = transforms.SetResident(0, mazePos, std::max(0, textureLayers[0]));
+    int groundSlot = transforms.SetResident(1, groundPos, std::max(0, textureLayers[2]));
+
+    // Frames are only drawn when something changed since the last one
+    glm::mat4 renderedView(0.0f);
+    bool atRest = false;
 
 
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        // At rest, sleep until input arrives. The timeout keeps the shader
+        // reload and the texture loading going
+        if (atRest) {
+            glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+        }
+        else {
+            glfwPollEvents();
+        }
         doMovement();
 
-        // Update the position of the agent
-        glm::vec3 newAgentPos = agentPos;
+        // Pick up edited shaders about once a second
+        if (glfwGetTime() - lastShaderCheck > 1.0) {
+            if (shaders.ReloadModifiedPrograms() > 0) {
+                redrawRequested = true;
+            }
+            shaders.UseProgram(texturedShader);
+            lastShaderCheck = glfwGetTime();
+        }
+
+        // Walk direction of the agent, the controller slides it along the walls it hits
+        glm::vec3 walk(0.0f);
         if (left) {
-            newAgentPos.x -= agentSpeed;
+            walk.x -= agentSpeed;
         }
         if (right) {
-            newAgentPos.x += agentSpeed;
+            walk.x += agentSpeed;
         }
         if (forward) {
-            newAgentPos.z -= agentSpeed;
+            walk.z -= agentSpeed;
         }
         if (backward) {
-            newAgentPos.z += agentSpeed;
+            walk.z += agentSpeed;
+        }
+        agentController.SetWalkVelocity(btVector3(walk.x, 0.0f, walk.z));
+
+        // The time spent waiting at rest moved nothing, there is nothing to catch up
+        double now = glfwGetTime();
+        int steps = physicsStep.Advance(atRest ? 0.0 : now - lastFrameTime);
+        lastFrameTime = now;
+        for (int i = 0; i < steps; ++i) {
+            pWorld->stepSimulation(physicsStep.GetStepSize(), 0, physicsStep.GetStepSize());
         }
 
-        bool collisionDetected = false;
-
-        // Iterate over each wall (sub-object) in MazeColliders
-        for (const Mesh& wall : MazeColliders) {
-            // Calculate bounding box of current wall
-            glm::vec3 wallMinBounds, wallMaxBounds;
-            std::tie(wallMinBounds, wallMaxBounds) = calculateBoundingBox(wall);
+        // drawn between the last two ticks, the model is placed from the shape center
+        btVector3 agentPhysicsPos = lerp(agentController.GetPreviousPosition(), agentController.GetPosition(), physicsStep.GetAlpha());
+        agentPos = glm::vec3(agentPhysicsPos.x(), agentPhysicsPos.y(), agentPhysicsPos.z()) - agentCenter;
 
-            // Check for collision between agent and current wall
-            if (checkCollision(agentMinBounds, agentMaxBounds, wallMinBounds, wallMaxBounds)) {
-                collisionDetected = true;
-                std::cout << "Collision detected with wall: " << wall.name << std::endl;
-            }
-        }
 
+        glm::mat4 view = cam.GetViewMatrix(agentPos);
 
-        // Update the agent's position if no collision detected
-        if (!collisionDetected) {
-            agentPos = newAgentPos;
+        // The agent stands still, every body sleeps, the camera sees what the
+        // last frame showed and the textures are loaded: that frame is still right
+        atRest = !redrawRequested && agentController.IsResting() && PhysicsBackend::CountAwakeBodies(pWorld) == 0
+            && view == renderedView && texturePool.getPendingCount() == 0 && textureStreamer.isSettled();
+        if (atRest) {
+            continue;
         }
+        renderedView = view;
+        redrawRequested = false;
 
+        // Only the matrices that changed are uploaded
+        frameUniforms.SetProjection(projection);
+        frameUniforms.SetView(view);
+        frameUniforms.Upload();
 
-        glm::mat4 view = cam.GetViewMatrix(agentPos);
-
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+        // Model matrix of the agent for this frame, the resident ones go up once
+        glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(agentPos.x, agentPos.y, agentPos.z));
+        transforms.BeginFrame();
+        int agentSlot = transforms.Push(modelMatrix, std::max(0, textureLayers[1]));
+        transforms.Upload();
 
         // Draw the scene
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Draw the maze
-        glBindVertexArray(VAO[0]);
-        glBindTexture(GL_TEXTURE_2D, textures[0]);
-        glm::mat4 mazePos = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.0f, -10.0f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(mazePos));
-        glDrawArrays(GL_TRIANGLES, 0, mazeIndices.size());
-        
-
-        // Draw the agent
-        glBindVertexArray(VAO[1]);
-        glBindTexture(GL_TEXTURE_2D, textures[1]);
-        // Assuming modelLoc is the uniform location for the model matrix
-        // btAgentPos is a vector containing the position of the agent
-        glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(agentPos.x, agentPos.y, agentPos.z));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-        glDrawArrays(GL_TRIANGLES, 0, agentIndices.size());
-        
+        // Cull the maze chunks outside of the view
+        Frustum frustum;
+        frustum.Extract(projection * view);
+        visibleChunks.clear();
+        mazeBvh.Query(frustum, visibleChunks);
+
+        // then the ones the walls hide from the camera's cell
+        int cameraCell = mazeVisibility.IsLoaded() ? mazeVisibility.GetCell(glm::vec3(glm::inverse(view)[3])) : -1;
+        if (cameraCell >= 0) {
+            size_t kept = 0;
+            for (size_t i = 0; i < visibleChunks.size(); ++i) {
+                if (mazeVisibility.IsVisible(cameraCell, mazeChunkBounds[visibleChunks[i]])) {
+                    visibleChunks[kept++] = visibleChunks[i];
+                }
+            }
+            visibleChunks.resize(kept);
+        }
+        std::sort(visibleChunks.begin(), visibleChunks.end());
+
+        // Stream the ground levels this view needs
+        textureStreamer.beginFrame();
+        if (frustum.IsVisible(groundBounds)) {
+            textureStreamer.addDemand(textures[2], groundBounds);
+        }
+        textureStreamer.update(glm::vec3(glm::inverse(view)[3]), projection[1][1] * HEIGHT * 0.5f);
+        int streamChanges = textureStreamer.getUploadCount() + textureStreamer.getEvictionCount();
+        // every few seconds at most, a level streams in or out on most frames while moving
+        if (streamChanges != reportedStreamChanges && glfwGetTime() - lastStreamReport > 5.0) {
+            textureStreamer.printStats();
+            reportedStreamChanges = streamChanges;
+            lastStreamReport = glfwGetTime();
+        }
 
-        // Draw the ground
-        glBindVertexArray(VAO[2]);
-        glBindTexture(GL_TEXTURE_2D, textures[2]);
-        glm::mat4 groundPos = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.0f, -10.0f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(groundPos));
-        glDrawArrays(GL_TRIANGLES, 0, groundIndices.size());
+        // Meshes in the texture array are drawn first, with one program and one bind,
+        // then the ones using their own texture
+        for (int pass = 0; pass < 2; ++pass) {
+            bool arrayPass = pass == 0;
+            if (arrayPass) {
+                if (textureArray.getLayerCount() == 0) continue;
+                shaders.UseProgram(arrayShader);
+                textureArray.bind();
+            }
+            else {
+                shaders.UseProgram(texturedShader);
+            }
+
+            // Draw the visible part of the maze
+            if ((textureLayers[0] >= 0) == arrayPass) {
+                glBindVertexArray(VAO[0]);
+                if (!arrayPass) glBindTexture(GL_TEXTURE_2D, textures[0]);
+                transforms.Bind(mazeSlot);
+                for (int chunk : visibleChunks) {
+                    glDrawArrays(GL_TRIANGLES, mazeChunks[chunk].first, mazeChunks[chunk].count);
+                }
+            }
+
+            // Draw the agent
+            if ((textureLayers[1] >= 0) == arrayPass) {
+                glBindVertexArray(VAO[1]);
+                if (!arrayPass) glBindTexture(GL_TEXTURE_2D, textures[1]);
+                transforms.Bind(agentSlot);
+                glDrawArrays(GL_TRIANGLES, 0, agentIndices.size());
+            }
+
+            // Draw the ground
+            if ((textureLayers[2] >= 0) == arrayPass) {
+                glBindVertexArray(VAO[2]);
+                if (!arrayPass) glBindTexture(GL_TEXTURE_2D, textures[2]);
+                transforms.Bind(groundSlot);
+                glDrawArrays(GL_TRIANGLES, 0, groundIndices.size());
+            }
+        }
 
 
         // Draw the colliders
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(mazePos));
+        transforms.Bind(mazeSlot);
         for (const auto& collider : MazeColliders) {
             objLoaderWGroups.displayMesh(collider, GL_LINE); // wireframe mode
         }
+        transforms.EndFrame();
 
 
 
         glfwSwapBuffers(window);
     }
 
+    pWorld->removeAction(&agentController);
+    agentController.RemoveFromWorld(pWorld);
+    mazePhysics.RemoveFromWorld(pWorld);
+    physics.Destroy();
+
     glDeleteVertexArrays(4, VAO);
     glDeleteBuffers(4, VBO);
+    transforms.Destroy();
+    frameUniforms.Destroy();
+    shaders.Destroy();
+    textureCache.clear();
+    textureArray.destroy();
+    textureStreamer.clear();
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,13 @@
+#version 330
+
+in vec2 v_texture;
+flat in int v_layer;
+
+out vec4 out_color;
+
+uniform sampler2DArray s_textures;
+
+void main()
+{
+    out_color = texture(s_textures, vec3(v_texture, float(v_layer)));
+}
@@ -0,0 +1,24 @@
+#version 330
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec2 a_texture;
+layout(location = 2) in vec3 a_normal;
+
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+};
+layout(std140) uniform ObjectData {
+    mat4 model;
+    int textureLayer;
+};
+
+out vec2 v_texture;
+flat out int v_layer;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(a_position, 1.0);
+    v_texture = a_texture;
+    v_layer = textureLayer;
+}